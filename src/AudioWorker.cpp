@@ -0,0 +1,101 @@
+#include "AudioWorker.h"
+#include "CpuFeatures.h"
+
+#ifdef _WIN32
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
+namespace
+{
+bool RaiseToRealtimePriority(std::thread& thread)
+{
+#ifdef _WIN32
+    return SetThreadPriority((HANDLE)thread.native_handle(), THREAD_PRIORITY_TIME_CRITICAL) != 0;
+#else
+    // Near the top of the real-time range, where hosts put their audio threads. Fails without the rights to it
+    // (e.g. no RLIMIT_RTPRIO on Linux).
+    sched_param param{};
+    param.sched_priority = sched_get_priority_max(SCHED_FIFO) - 1;
+    return pthread_setschedparam(thread.native_handle(), SCHED_FIFO, &param) == 0;
+#endif
+}
+}; // namespace
+
+AudioWorker::AudioWorker()
+{
+    mThread = std::thread([this] { this->Run(); });
+    mRealtime = RaiseToRealtimePriority(mThread);
+}
+
+AudioWorker::~AudioWorker()
+{
+    {
+        const std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mWake.notify_one();
+    mThread.join();
+}
+
+void AudioWorker::Start(Job job, void* context)
+{
+    mJob = job;
+    mContext = context;
+    mState.store(kPending);
+
+    // Only wake the worker if it's asleep, and never wait for the lock to do it: if the worker is holding it,
+    // it's about to check the state anyway, and if it misses the job after all, Finish() runs it here
+    if (mSleeping.load())
+    {
+        std::unique_lock<std::mutex> lock(mMutex, std::try_to_lock);
+        if (lock.owns_lock())
+        {
+            lock.unlock();
+            mWake.notify_one();
+        }
+    }
+}
+
+void AudioWorker::Finish()
+{
+    int expected = kPending;
+    if (mState.compare_exchange_strong(expected, kRunning))
+        mJob(mContext);
+    else
+        while (mState.load(std::memory_order_acquire) != kDone)
+            std::this_thread::yield();
+    mState.store(kIdle);
+}
+
+void AudioWorker::Run()
+{
+#ifdef NAM_X86
+    // Flush denormals to zero, like the audio thread does
+    _mm_setcsr(_mm_getcsr() | 0x8040);
+#endif
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mSleeping = true;
+            mWake.wait(lock, [this] { return mStopping.load() || mState.load() == kPending; });
+            mSleeping = false;
+        }
+        if (mStopping)
+            return;
+
+        int expected = kPending;
+        if (mState.compare_exchange_strong(expected, kRunning))
+        {
+            mJob(mContext);
+            mState.store(kDone, std::memory_order_release);
+        }
+    }
+}
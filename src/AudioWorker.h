@@ -0,0 +1,59 @@
+#ifndef __AUDIO_WORKER_H__
+#define __AUDIO_WORKER_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// A thread that takes one job at a time off the audio thread, within the same callback: the audio thread hands
+// a job over with Start(), does its own share of the work, then calls Finish().
+//
+// The audio thread never blocks on the worker getting going: if the worker hasn't picked the job up by the time
+// Finish() is called (it was asleep and slow to wake, or the wake-up was missed), the audio thread takes the job
+// back and runs it itself. It only ever waits for a job that's already running.
+//
+// That wait is where the priorities matter: if the worker were an ordinary thread, the OS could preempt it in the
+// middle of a job and leave the audio thread spinning until it came back. So the worker asks for real-time
+// priority; if it doesn't get it, IsRealtime() says so, and the owner shouldn't hand it jobs.
+class AudioWorker
+{
+public:
+    using Job = void (*)(void* context);
+
+    AudioWorker ();
+    ~AudioWorker ();
+
+    // Audio thread. Nothing may be pending already.
+    void Start (Job job, void* context);
+    // Audio thread. Returns once the job has run, here or on the worker.
+    void Finish ();
+
+    // Whether the worker thread got real-time priority
+    bool IsRealtime () const { return mRealtime; };
+
+private:
+    enum State
+    {
+        kIdle = 0,
+        kPending,
+        kRunning,
+        kDone
+    };
+
+    void Run ();
+
+    // Written by Start() before it publishes kPending
+    Job mJob = nullptr;
+    void* mContext = nullptr;
+    std::atomic<int> mState{kIdle};
+
+    bool mRealtime = false;
+    std::atomic<bool> mStopping{false};
+    std::atomic<bool> mSleeping{false};
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    std::thread mThread;
+};
+
+#endif
@@ -0,0 +1,180 @@
+#include "BlockLSTM.h"
+#include "VectorActivations.h"
+
+#include <activations.h>
+#include <stdexcept>
+
+BlockLSTM::BlockLSTM(const int numLayers, const int inputSize, const int hiddenSize, const std::vector<float>& weights,
+                     const double expectedSampleRate, const bool hugePages)
+    : nam::DSP(expectedSampleRate), mHiddenSize(hiddenSize)
+{
+    // Like the core, the model sees one sample at a time
+    if (inputSize != 1)
+        throw std::runtime_error("BlockLSTM only supports an input size of 1");
+
+    // Read as the core lays them out, then packed
+    std::vector<Eigen::MatrixXf> inputWeights(numLayers), recurrentWeights(numLayers);
+    std::vector<Eigen::VectorXf> biases(numLayers);
+
+    auto it = weights.begin();
+    for (int l = 0; l < numLayers; l++)
+    {
+        Layer layer;
+        const int layerInputSize = l == 0 ? inputSize : hiddenSize;
+        inputWeights[l].resize(4 * hiddenSize, layerInputSize);
+        recurrentWeights[l].resize(4 * hiddenSize, hiddenSize);
+        biases[l].resize(4 * hiddenSize);
+        layer.hidden.resize(hiddenSize);
+        layer.cell.resize(hiddenSize);
+
+        // The core's [input | hidden] matrix, row-major, split at the column where the hidden state starts
+        for (int i = 0; i < 4 * hiddenSize; i++)
+        {
+            for (int j = 0; j < layerInputSize; j++)
+                inputWeights[l](i, j) = *(it++);
+            for (int j = 0; j < hiddenSize; j++)
+                recurrentWeights[l](i, j) = *(it++);
+        }
+        for (int i = 0; i < 4 * hiddenSize; i++)
+            biases[l](i) = *(it++);
+        // Initial hidden and cell states
+        for (int i = 0; i < hiddenSize; i++)
+            layer.hidden(i) = *(it++);
+        for (int i = 0; i < hiddenSize; i++)
+            layer.cell(i) = *(it++);
+
+        // Halve the input, forget and output gate rows, so that those pre-activations come out as x / 2, which is
+        // what fast_sigmoid() passes to fast_tanh(). Scaling by a power of two is exact.
+        for (const int gate : {0, 1, 3})
+        {
+            inputWeights[l].middleRows(gate * hiddenSize, hiddenSize) *= 0.5f;
+            recurrentWeights[l].middleRows(gate * hiddenSize, hiddenSize) *= 0.5f;
+            biases[l].segment(gate * hiddenSize, hiddenSize) *= 0.5f;
+        }
+
+        mLayers.push_back(std::move(layer));
+    }
+
+    Eigen::MatrixXf headWeight(1, hiddenSize);
+    for (int i = 0; i < hiddenSize; i++)
+        headWeight(0, i) = *(it++);
+    const float headBias = *(it++);
+
+    if (it != weights.end())
+        throw std::runtime_error("Weight mismatch: LSTM didn't use all of the weights");
+
+    mWeights.SetHugePages(hugePages);
+    mWeights.Build(
+        [&](DSPArena& arena)
+        {
+            for (int l = 0; l < numLayers; l++)
+            {
+                mLayers[l].inputWeights = PackedMatrix::Pack(arena, inputWeights[l], biases[l].data());
+                mLayers[l].recurrentWeights = PackedMatrix::Pack(arena, recurrentWeights[l]);
+            }
+            mHead = PackedMatrix::Pack(arena, headWeight, &headBias);
+        });
+
+    mRecurrentGates.resize(4 * hiddenSize);
+}
+
+int BlockLSTM::PrewarmSamples()
+{
+    // Same as the core: half a second, and at least something if the model doesn't know its sample rate
+    const int result = static_cast<int>(0.5 * mExpectedSampleRate);
+    return result <= 0 ? 1 : result;
+}
+
+void BlockLSTM::EnsureCapacity(const int numFrames)
+{
+    if (numFrames <= mCapacity)
+        return;
+
+    mCapacity = numFrames;
+    mInput.resize(1, numFrames);
+    mGates.resize(4 * mHiddenSize, numFrames);
+    mSequence[0].resize(mHiddenSize, numFrames);
+    mSequence[1].resize(mHiddenSize, numFrames);
+    mHeadOutput.resize(numFrames);
+}
+
+void BlockLSTM::ProcessLayer(Layer& layer, const Eigen::Ref<const Eigen::MatrixXf>& layerInput, Eigen::Ref<Eigen::MatrixXf> layerOutput,
+                             const int numFrames)
+{
+    const int hiddenSize = mHiddenSize;
+    const ActivationKernels& kernels = GetActivationKernels();
+
+    // Everything that doesn't depend on the previous sample, for the whole block in one go
+    auto gates = mGates.leftCols(numFrames);
+    layer.inputWeights.Multiply({layerInput.data(), static_cast<int>(layerInput.rows())}, gates.data(), numFrames);
+
+    float* g = mRecurrentGates.data();
+    float* cell = layer.cell.data();
+    float* hidden = layer.hidden.data();
+    const bool fastTanh = nam::activations::Activation::using_fast_tanh;
+
+    for (int t = 0; t < numFrames; t++)
+    {
+        layer.recurrentWeights.Multiply({hidden, hiddenSize}, g, 1, gates.col(t).data());
+
+        // Gates are contiguous, so each nonlinearity is one vector call over all the units. The sigmoid gates hold
+        // x / 2 (see the constructor).
+        if (fastTanh)
+        {
+            // fast_sigmoid(x) is defined as (fast_tanh(x / 2) + 1) / 2
+            kernels.fastTanh(g, 4 * hiddenSize);
+            for (int i = 0; i < hiddenSize; i++)
+            {
+                cell[i] = 0.5f * (g[i + hiddenSize] + 1.0f) * cell[i] + 0.5f * (g[i] + 1.0f) * g[i + 2 * hiddenSize];
+                hidden[i] = cell[i];
+            }
+            kernels.fastTanh(hidden, hiddenSize);
+            for (int i = 0; i < hiddenSize; i++)
+                hidden[i] *= 0.5f * (g[i + 3 * hiddenSize] + 1.0f);
+        }
+        else
+        {
+            for (int i = 0; i < 2 * hiddenSize; i++)
+                g[i] *= 2.0f;
+            for (int i = 3 * hiddenSize; i < 4 * hiddenSize; i++)
+                g[i] *= 2.0f;
+            kernels.sigmoid(g, 2 * hiddenSize);
+            kernels.tanh(g + 2 * hiddenSize, hiddenSize);
+            kernels.sigmoid(g + 3 * hiddenSize, hiddenSize);
+            for (int i = 0; i < hiddenSize; i++)
+            {
+                cell[i] = g[i + hiddenSize] * cell[i] + g[i] * g[i + 2 * hiddenSize];
+                hidden[i] = cell[i];
+            }
+            kernels.tanh(hidden, hiddenSize);
+            for (int i = 0; i < hiddenSize; i++)
+                hidden[i] *= g[i + 3 * hiddenSize];
+        }
+
+        layerOutput.col(t) = layer.hidden;
+    }
+}
+
+void BlockLSTM::process(NAM_SAMPLE* input, NAM_SAMPLE* output, const int num_frames)
+{
+    if (mLayers.empty())
+    {
+        for (int i = 0; i < num_frames; i++)
+            output[i] = input[i];
+        return;
+    }
+
+    this->EnsureCapacity(num_frames);
+
+    for (int i = 0; i < num_frames; i++)
+        mInput(0, i) = static_cast<float>(input[i]);
+
+    this->ProcessLayer(mLayers[0], mInput, mSequence[0], num_frames);
+    for (size_t l = 1; l < mLayers.size(); l++)
+        this->ProcessLayer(mLayers[l], mSequence[(l - 1) % 2], mSequence[l % 2], num_frames);
+
+    const Eigen::MatrixXf& lastSequence = mSequence[(mLayers.size() - 1) % 2];
+    mHead.Multiply({lastSequence.data(), mHiddenSize}, mHeadOutput.data(), num_frames);
+    for (int i = 0; i < num_frames; i++)
+        output[i] = static_cast<NAM_SAMPLE>(mHeadOutput(i));
+}
@@ -0,0 +1,24 @@
+#ifndef __CPU_FEATURES_H__
+#define __CPU_FEATURES_H__
+
+// For kernels that are built for several instruction sets in one binary and picked at runtime.
+// Mark a function NAM_TARGET_AVX2 / NAM_TARGET_AVX512 to let it use those instructions, and only call it if the
+// matching check below passes.
+#if defined(__x86_64__) || defined(_M_X64)
+    #define NAM_X86 1
+    #include <immintrin.h>
+    #if defined(_MSC_VER) && !defined(__clang__)
+        // MSVC lets any function use any instruction set
+        #define NAM_TARGET_AVX2
+        #define NAM_TARGET_AVX512
+    #else
+        #define NAM_TARGET_AVX2 __attribute__((target("avx2,fma")))
+        #define NAM_TARGET_AVX512 __attribute__((target("avx512f")))
+    #endif
+#endif
+
+// Whether the CPU, and the OS, support AVX2 + FMA / AVX-512F. Always false on anything but x86-64.
+bool CpuHasAVX2 ();
+bool CpuHasAVX512 ();
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef __DSP_ARENA_H__
+#define __DSP_ARENA_H__
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+
+#ifdef __linux__
+    #include <sys/mman.h>
+#endif
+
+// One 64-byte aligned block of memory that an instance's per-block buffers are carved out of, in the order the
+// signal goes through them, so that neighbouring stages' buffers are neighbours in memory too.
+//
+// Buffers are laid out by a function that allocates them all from the arena. Build() calls it twice: once to
+// measure, then (after growing the block if it has to) for real. The block only ever grows, so building again
+// with the same sizes doesn't allocate. Everything handed out by the previous Build() is invalid after the next.
+//
+// Arenas of a huge page or more can ask to be backed by huge pages, which saves TLB misses when something (e.g. a
+// big model's weights) is streamed through on every block. Only Linux's transparent huge pages are asked for;
+// elsewhere, or if the kernel says no, it's ordinary memory.
+class DSPArena
+{
+public:
+    static constexpr size_t kAlignment = 64;
+    static constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+
+    // For the next time the block grows
+    void SetHugePages (const bool hugePages) { this->mHugePages = hugePages; };
+
+    template <typename Layout>
+    void Build (Layout&& layout)
+    {
+        this->mMeasuring = true;
+        this->mUsed = 0;
+        layout(*this);
+
+        if (this->mUsed > this->mCapacity)
+        {
+            const bool huge = this->mHugePages && this->mUsed >= kHugePageSize;
+            const size_t alignment = huge ? kHugePageSize : kAlignment;
+            const size_t capacity = huge ? (this->mUsed + kHugePageSize - 1) / kHugePageSize * kHugePageSize : this->mUsed;
+            this->mData = std::unique_ptr<std::byte, AlignedDelete>(
+                static_cast<std::byte*>(::operator new(capacity, std::align_val_t(alignment))), AlignedDelete{alignment});
+#ifdef __linux__
+            if (huge)
+                madvise(this->mData.get(), capacity, MADV_HUGEPAGE);
+#endif
+            this->mCapacity = capacity;
+        }
+
+        this->mMeasuring = false;
+        this->mUsed = 0;
+        layout(*this);
+    };
+
+    // count zeroed Ts, starting on a cache line. Returns nullptr while Build() is measuring.
+    template <typename T>
+    T* Allocate (const size_t count)
+    {
+        const size_t offset = this->mUsed;
+        this->mUsed += (count * sizeof(T) + kAlignment - 1) / kAlignment * kAlignment;
+        if (this->mMeasuring)
+            return nullptr;
+        T* items = reinterpret_cast<T*>(this->mData.get() + offset);
+        std::fill_n(items, count, T());
+        return items;
+    };
+
+    // What the last Build() laid out
+    size_t GetUsedBytes () const { return this->mUsed; };
+    size_t GetCapacityBytes () const { return this->mCapacity; };
+
+private:
+    struct AlignedDelete
+    {
+        AlignedDelete () : alignment(kAlignment) {}
+        explicit AlignedDelete (const size_t alignment) : alignment(alignment) {}
+        void operator()(std::byte* data) const { ::operator delete(data, std::align_val_t(alignment)); }
+        size_t alignment;
+    };
+
+    std::unique_ptr<std::byte, AlignedDelete> mData;
+    size_t mCapacity = 0;
+    size_t mUsed = 0;
+    bool mMeasuring = false;
+    bool mHugePages = false;
+};
+
+#endif
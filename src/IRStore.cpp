@@ -0,0 +1,264 @@
+#include "IRStore.h"
+#include "RealFFT.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <tuple>
+
+namespace
+{
+// Windowed-sinc resampling, at load time only. Lowpasses at the lower of the two Nyquists.
+std::vector<float> Resample(const float* samples, const size_t numSamples, const double fromRate, const double toRate)
+{
+    const double pi = 3.14159265358979323846;
+    const double ratio = toRate / fromRate;
+    const double cutoff = std::min(1.0, ratio);
+    // Taps on either side, in input samples
+    const double halfWidth = 16.0 / cutoff;
+
+    std::vector<float> result(static_cast<size_t>(std::ceil(numSamples * ratio)));
+    for (size_t i = 0; i < result.size(); i++)
+    {
+        const double position = i / ratio;
+        const long first = std::max(0L, static_cast<long>(std::ceil(position - halfWidth)));
+        const long last = std::min(static_cast<long>(numSamples) - 1, static_cast<long>(std::floor(position + halfWidth)));
+        double sum = 0.0;
+        for (long j = first; j <= last; j++)
+        {
+            const double x = position - j;
+            const double sinc = x == 0.0 ? 1.0 : std::sin(pi * cutoff * x) / (pi * cutoff * x);
+            // Blackman
+            const double w = 0.42 + 0.5 * std::cos(pi * x / halfWidth) + 0.08 * std::cos(2.0 * pi * x / halfWidth);
+            sum += samples[j] * cutoff * sinc * w;
+        }
+        result[i] = static_cast<float>(sum);
+    }
+    return result;
+}
+
+// Floor for the tail cut after a minimum-phase conversion, if the user didn't set one: below what a float FFT
+// resolves anyway
+constexpr double kMinimumPhaseFloorDB = -100.0;
+// Longest fade-out at the cut
+constexpr double kTailFadeSeconds = 0.01;
+
+// Minimum phase by the real cepstrum: fold the cepstrum of log|H| onto positive quefrencies and take it back to a
+// spectrum. Padded well past the IR's length so that the cepstrum barely aliases; the result is cut back to the
+// IR's length, which holds nearly all of its energy.
+std::vector<float> MinimumPhase(const std::vector<float>& ir)
+{
+    int size = 4;
+    while ((size_t)size < 4 * ir.size())
+        size *= 2;
+
+    RealFFT fft(size);
+    const int numBins = fft.GetNumBins();
+    std::vector<float> signal(size, 0.0f);
+    std::vector<float> real(numBins), imag(numBins);
+    std::copy(ir.begin(), ir.end(), signal.begin());
+    fft.Forward(signal.data(), real.data(), imag.data());
+
+    // log|H|, floored 200 dB below the peak so that nulls don't go to -infinity
+    std::vector<float> magnitude(numBins);
+    float peak = 0.0f;
+    for (int k = 0; k < numBins; k++)
+    {
+        magnitude[k] = std::hypot(real[k], imag[k]);
+        peak = std::max(peak, magnitude[k]);
+    }
+    if (peak == 0.0f)
+        return ir;
+    for (int k = 0; k < numBins; k++)
+    {
+        real[k] = std::log(std::max(magnitude[k], peak * 1e-10f));
+        imag[k] = 0.0f;
+    }
+    fft.Inverse(real.data(), imag.data(), signal.data());
+
+    for (int n = 1; n < size / 2; n++)
+        signal[n] *= 2.0f;
+    std::fill(signal.begin() + size / 2 + 1, signal.end(), 0.0f);
+
+    fft.Forward(signal.data(), real.data(), imag.data());
+    for (int k = 0; k < numBins; k++)
+    {
+        const float m = std::exp(real[k]);
+        const float phase = imag[k];
+        real[k] = m * std::cos(phase);
+        imag[k] = m * std::sin(phase);
+    }
+    fft.Inverse(real.data(), imag.data(), signal.data());
+
+    return std::vector<float>(signal.begin(), signal.begin() + ir.size());
+}
+
+// Cuts the IR where the energy left after the cut first rises above floorDB relative to the whole, and fades out
+// the end of what's kept
+void TruncateTail(std::vector<float>& ir, const double floorDB, const double sampleRate)
+{
+    double total = 0.0;
+    for (const float sample : ir)
+        total += (double)sample * sample;
+    if (total <= 0.0)
+        return;
+
+    const double limit = total * std::pow(10.0, floorDB / 10.0);
+    size_t length = ir.size();
+    double tail = 0.0;
+    while (length > 1 && tail + (double)ir[length - 1] * ir[length - 1] <= limit)
+    {
+        tail += (double)ir[length - 1] * ir[length - 1];
+        length--;
+    }
+    if (length == ir.size())
+        return;
+    ir.resize(length);
+
+    // Half a cosine, over at most a quarter of what's left
+    const double pi = 3.14159265358979323846;
+    const size_t fadeLength = std::min(length / 4, static_cast<size_t>(kTailFadeSeconds * sampleRate));
+    for (size_t i = 0; i < fadeLength; i++)
+        ir[length - fadeLength + i] *= static_cast<float>(0.5 + 0.5 * std::cos(pi * (i + 1) / (fadeLength + 1)));
+}
+
+// Relative cost of a block of convolution: a complex multiply-accumulate over the spectrum per partition, plus a
+// forward and an inverse FFT, which cost about 0.625 log2(N) of those each
+double ConvolutionCost(const int numPartitions, const int partitionSize)
+{
+    return numPartitions + 2.0 * 0.625 * std::log2(2.0 * partitionSize);
+}
+}; // namespace
+
+bool IRProcessing::operator<(const IRProcessing& other) const
+{
+    return std::tie(this->tailFloorDB, this->minimumPhase) < std::tie(other.tailFloorDB, other.minimumPhase);
+}
+
+std::string IRProcessingReport::ToString() const
+{
+    std::stringstream ss;
+    ss << "IR processed: " << this->originalLength << " -> " << this->processedLength << " samples (about "
+       << 100.0 * this->cpuSaving << "% less convolution CPU)";
+    return ss.str();
+}
+
+std::shared_ptr<IRSpectra> MakeIRSpectra(const float* samples, const size_t numSamples, const double irSampleRate, const double sampleRate,
+                                         const int partitionSize, const IRProcessing& processing)
+{
+    std::vector<float> ir = irSampleRate != sampleRate && irSampleRate > 0.0 ? Resample(samples, numSamples, irSampleRate, sampleRate)
+                                                                              : std::vector<float>(samples, samples + numSamples);
+    if (ir.empty())
+        ir.push_back(0.0f);
+    const int originalLength = static_cast<int>(ir.size());
+
+    if (processing.minimumPhase)
+        ir = MinimumPhase(ir);
+    if (processing.tailFloorDB < 0.0)
+        TruncateTail(ir, processing.tailFloorDB, sampleRate);
+    else if (processing.minimumPhase)
+        TruncateTail(ir, kMinimumPhaseFloorDB, sampleRate);
+
+    // What JUCE's Convolution::Normalise::yes does
+    double energy = 0.0;
+    for (const float sample : ir)
+        energy += (double)sample * sample;
+    const float gain = energy > 0.0 ? static_cast<float>(0.125 / std::sqrt(energy)) : 1.0f;
+
+    auto spectra = std::make_shared<IRSpectra>();
+    spectra->sampleRate = sampleRate;
+    spectra->partitionSize = partitionSize;
+    spectra->length = static_cast<int>(ir.size());
+    spectra->numPartitions = (spectra->length + partitionSize - 1) / partitionSize;
+    spectra->numBins = partitionSize + 1;
+    spectra->real.resize((size_t)spectra->numPartitions * spectra->numBins);
+    spectra->imag.resize(spectra->real.size());
+
+    const int originalPartitions = (originalLength + partitionSize - 1) / partitionSize;
+    spectra->report.originalLength = originalLength;
+    spectra->report.processedLength = spectra->length;
+    spectra->report.cpuSaving =
+        1.0 - ConvolutionCost(spectra->numPartitions, partitionSize) / ConvolutionCost(originalPartitions, partitionSize);
+
+    RealFFT fft(2 * partitionSize);
+    std::vector<float> padded(2 * partitionSize);
+    for (int p = 0; p < spectra->numPartitions; p++)
+    {
+        std::fill(padded.begin(), padded.end(), 0.0f);
+        const int start = p * partitionSize;
+        const int count = std::min(partitionSize, spectra->length - start);
+        for (int i = 0; i < count; i++)
+            padded[i] = ir[start + i] * gain;
+        fft.Forward(padded.data(), &spectra->real[(size_t)p * spectra->numBins], &spectra->imag[(size_t)p * spectra->numBins]);
+    }
+    return spectra;
+}
+
+bool IRStore::Key::operator<(const Key& other) const
+{
+    return std::tie(this->hash, this->sampleRate, this->partitionSize, this->processing)
+           < std::tie(other.hash, other.sampleRate, other.partitionSize, other.processing);
+}
+
+std::shared_ptr<IRStore> IRStore::GetInstance()
+{
+    static std::mutex instanceMutex;
+    static std::weak_ptr<IRStore> instance;
+
+    const std::lock_guard<std::mutex> lock(instanceMutex);
+    std::shared_ptr<IRStore> store = instance.lock();
+    if (store == nullptr)
+    {
+        store.reset(new IRStore());
+        instance = store;
+    }
+    return store;
+}
+
+std::shared_ptr<const IRSpectra> IRStore::Find(const std::string& hash, const double sampleRate, const int partitionSize,
+                                               const IRProcessing& processing)
+{
+    const std::lock_guard<std::mutex> lock(this->mMutex);
+    const auto it = this->mEntries.find({hash, sampleRate, partitionSize, processing});
+    return it != this->mEntries.end() ? it->second.lock() : nullptr;
+}
+
+std::shared_ptr<const IRSpectra> IRStore::Acquire(const std::string& hash, const float* samples, const size_t numSamples,
+                                                  const double irSampleRate, const double sampleRate, const int partitionSize,
+                                                  const IRProcessing& processing)
+{
+    if (auto existing = this->Find(hash, sampleRate, partitionSize, processing))
+        return existing;
+
+    // Made outside the lock; if someone else got there first in the meantime, theirs wins
+    std::shared_ptr<const IRSpectra> made = MakeIRSpectra(samples, numSamples, irSampleRate, sampleRate, partitionSize, processing);
+
+    const std::lock_guard<std::mutex> lock(this->mMutex);
+    for (auto it = this->mEntries.begin(); it != this->mEntries.end();)
+        it = it->second.expired() ? this->mEntries.erase(it) : std::next(it);
+
+    std::weak_ptr<const IRSpectra>& entry = this->mEntries[{hash, sampleRate, partitionSize, processing}];
+    if (auto existing = entry.lock())
+        return existing;
+    entry = made;
+    return made;
+}
+
+size_t IRStore::GetNumResident()
+{
+    const std::lock_guard<std::mutex> lock(this->mMutex);
+    size_t count = 0;
+    for (const auto& [key, entry] : this->mEntries)
+        count += entry.expired() ? 0 : 1;
+    return count;
+}
+
+size_t IRStore::GetResidentBytes()
+{
+    const std::lock_guard<std::mutex> lock(this->mMutex);
+    size_t bytes = 0;
+    for (const auto& [key, entry] : this->mEntries)
+        if (auto spectra = entry.lock())
+            bytes += spectra->GetBytes();
+    return bytes;
+}
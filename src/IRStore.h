@@ -0,0 +1,98 @@
+#ifndef __IR_STORE_H__
+#define __IR_STORE_H__
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Optional processing of an IR when it's loaded, before it's partitioned. Long IRs are mostly room tail that's
+// far below anything audible, and the convolution costs in proportion to the length.
+struct IRProcessing
+{
+    // Cuts off the tail from where the energy left after it is this many dB below the whole IR's, with a short
+    // fade. 0 or above keeps the whole IR.
+    double tailFloorDB = 0.0;
+    // Converts the IR to minimum phase: the same magnitude response, with its energy as early as it can be, which
+    // also takes out any silence at the start. The tail is then cut (at -100 dB if tailFloorDB doesn't).
+    bool minimumPhase = false;
+
+    bool operator< (const IRProcessing& other) const;
+};
+
+// What processing did to an IR
+struct IRProcessingReport
+{
+    // In samples at the rate the IR runs at
+    int originalLength = 0;
+    int processedLength = 0;
+    // Estimated fraction of the convolution's CPU time saved
+    double cpuSaving = 0.0;
+
+    std::string ToString () const;
+};
+
+// An IR made ready for PartitionedConvolver: resampled to the sample rate it'll run at, normalised, cut into
+// equal partitions and transformed. Read-only once made, and shared by every instance that uses the same IR.
+struct IRSpectra
+{
+    double sampleRate = 0.0;
+    int partitionSize = 0;
+    int numPartitions = 0;
+    // Of each partition's spectrum (FFT size 2 * partitionSize)
+    int numBins = 0;
+    // Samples of IR after resampling and processing
+    int length = 0;
+    IRProcessingReport report;
+
+    // numPartitions spectra, numBins each, back to back
+    std::vector<float> real;
+    std::vector<float> imag;
+
+    size_t GetBytes () const { return (real.size() + imag.size()) * sizeof(float); };
+};
+
+// Resamples (if the rates differ), processes, and normalises an IR the same way the JUCE convolution did, so that
+// cabs sound the same level as before, then partitions and transforms it
+std::shared_ptr<IRSpectra> MakeIRSpectra (const float* samples, const size_t numSamples, const double irSampleRate, const double sampleRate,
+                                          const int partitionSize, const IRProcessing& processing = {});
+
+// Process-wide store of IR spectra, by content hash, sample rate, partition size and processing, so that an IR loaded into
+// any number of instances is only processed and held once. Entries live as long as some instance uses them.
+// Shared by every instance in the process, like LoaderService.
+class IRStore
+{
+public:
+    static std::shared_ptr<IRStore> GetInstance ();
+
+    // Spectra that some instance already has, or null
+    std::shared_ptr<const IRSpectra> Find (const std::string& hash, const double sampleRate, const int partitionSize,
+                                           const IRProcessing& processing = {});
+    // Find(), or makes them from the samples and keeps them for the next caller
+    std::shared_ptr<const IRSpectra> Acquire (const std::string& hash, const float* samples, const size_t numSamples, const double irSampleRate,
+                                              const double sampleRate, const int partitionSize, const IRProcessing& processing = {});
+
+    // Distinct IRs in memory right now, and their size
+    size_t GetNumResident ();
+    size_t GetResidentBytes ();
+
+private:
+    IRStore () = default;
+
+    struct Key
+    {
+        std::string hash;
+        double sampleRate;
+        int partitionSize;
+        IRProcessing processing;
+
+        bool operator< (const Key& other) const;
+    };
+
+    std::mutex mMutex;
+    std::map<Key, std::weak_ptr<const IRSpectra>> mEntries;
+};
+
+#endif
@@ -0,0 +1,224 @@
+#include "LoaderService.h"
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+
+LoaderService::Priority LoaderService::Job::GetPriority() const
+{
+    Priority priority = Priority::kBackground;
+    for (const auto& waiter : this->waiters)
+        priority = std::max(priority, waiter.priority);
+    return priority;
+}
+
+LoaderService::LoaderService(const int numThreads)
+{
+    for (int i = 0; i < numThreads; i++)
+        this->mThreads.emplace_back([this] { this->WorkerLoop(); });
+}
+
+LoaderService::~LoaderService()
+{
+    {
+        const std::lock_guard<std::mutex> lock(this->mMutex);
+        this->mStopping = true;
+    }
+    this->mWorkAvailable.notify_all();
+
+    for (auto& thread : this->mThreads)
+        thread.join();
+}
+
+std::shared_ptr<LoaderService> LoaderService::GetInstance()
+{
+    static std::mutex instanceMutex;
+    static std::weak_ptr<LoaderService> instance;
+
+    const std::lock_guard<std::mutex> lock(instanceMutex);
+    std::shared_ptr<LoaderService> service = instance.lock();
+    if (service == nullptr)
+    {
+        // Parsing is mostly memory-bound; a few threads are plenty, and we don't want to starve the host.
+        const int numThreads = std::clamp((int)std::thread::hardware_concurrency() / 2, 1, 4);
+        service.reset(new LoaderService(numThreads));
+        instance = service;
+    }
+    return service;
+}
+
+int64_t LoaderService::RegisterClient()
+{
+    const std::lock_guard<std::mutex> lock(this->mMutex);
+    const int64_t clientId = this->mNextClientId++;
+    this->mClientPriorities[clientId] = Priority::kNormal;
+    return clientId;
+}
+
+void LoaderService::Request(const std::string& key, const Priority priority, const int64_t clientId, ParseFunction parse, Callback callback)
+{
+    {
+        const std::lock_guard<std::mutex> lock(this->mMutex);
+        const Priority clientPriority = std::max(priority, this->mClientPriorities[clientId]);
+
+        auto it = this->mJobs.find(key);
+        if (it == this->mJobs.end())
+        {
+            Job& job = this->mJobs[key];
+            job.parse = std::move(parse);
+            job.sequence = this->mNextSequence++;
+            job.waiters.push_back({clientId, clientPriority, std::move(callback)});
+        }
+        else
+        {
+            // Coalesce with the job that's queued or already parsing; waiters are collected when it finishes
+            it->second.waiters.push_back({clientId, clientPriority, std::move(callback)});
+        }
+    }
+    this->mWorkAvailable.notify_one();
+}
+
+void LoaderService::SetPriority(const int64_t clientId, const Priority priority)
+{
+    const std::lock_guard<std::mutex> lock(this->mMutex);
+    this->mClientPriorities[clientId] = priority;
+    for (auto& [key, job] : this->mJobs)
+        for (auto& waiter : job.waiters)
+            if (waiter.clientId == clientId)
+                waiter.priority = priority;
+    for (auto& delivery : this->mDeliveries)
+        if (delivery.waiter.clientId == clientId)
+            delivery.waiter.priority = priority;
+}
+
+void LoaderService::CancelClient(const int64_t clientId)
+{
+    std::unique_lock<std::mutex> lock(this->mMutex);
+    this->mClientPriorities.erase(clientId);
+
+    for (auto it = this->mJobs.begin(); it != this->mJobs.end();)
+    {
+        auto& waiters = it->second.waiters;
+        waiters.erase(std::remove_if(waiters.begin(), waiters.end(), [clientId](const Waiter& waiter) { return waiter.clientId == clientId; }),
+                      waiters.end());
+
+        // Nobody wants this any more
+        if (waiters.empty() && !it->second.running)
+            it = this->mJobs.erase(it);
+        else
+            ++it;
+    }
+    this->mDeliveries.erase(std::remove_if(this->mDeliveries.begin(), this->mDeliveries.end(),
+                                           [clientId](const Delivery& delivery) { return delivery.waiter.clientId == clientId; }),
+                            this->mDeliveries.end());
+
+    this->mCallbacksFinished.wait(lock, [this, clientId] { return this->mRunningClients.count(clientId) == 0; });
+}
+
+std::map<std::string, LoaderService::Job>::iterator LoaderService::NextJob()
+{
+    auto best = this->mJobs.end();
+    for (auto it = this->mJobs.begin(); it != this->mJobs.end(); ++it)
+    {
+        if (it->second.running)
+            continue;
+        if (best == this->mJobs.end() || it->second.GetPriority() > best->second.GetPriority()
+            || (it->second.GetPriority() == best->second.GetPriority() && it->second.sequence < best->second.sequence))
+            best = it;
+    }
+    return best;
+}
+
+std::vector<LoaderService::Delivery>::iterator LoaderService::NextDelivery()
+{
+    auto best = this->mDeliveries.end();
+    for (auto it = this->mDeliveries.begin(); it != this->mDeliveries.end(); ++it)
+        if (best == this->mDeliveries.end() || it->waiter.priority > best->waiter.priority
+            || (it->waiter.priority == best->waiter.priority && it->sequence < best->sequence))
+            best = it;
+    return best;
+}
+
+void LoaderService::Deliver(Delivery& delivery)
+{
+    // An exception that got out would take the loader thread, and so the host, down with it
+    try
+    {
+        delivery.waiter.callback(delivery.result, delivery.error);
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "Loader callback failed: " << e.what() << std::endl;
+    }
+    catch (...)
+    {
+        std::cerr << "Loader callback failed" << std::endl;
+    }
+}
+
+void LoaderService::WorkerLoop()
+{
+    std::unique_lock<std::mutex> lock(this->mMutex);
+    while (true)
+    {
+        auto jobIt = this->mJobs.end();
+        this->mWorkAvailable.wait(lock, [this, &jobIt] {
+            if (!this->mDeliveries.empty())
+                return true;
+            jobIt = this->NextJob();
+            return this->mStopping || jobIt != this->mJobs.end();
+        });
+        if (this->mStopping)
+            return;
+
+        // Finish loads whose parse is done before starting new ones
+        if (!this->mDeliveries.empty())
+        {
+            auto deliveryIt = this->NextDelivery();
+            Delivery delivery = std::move(*deliveryIt);
+            this->mDeliveries.erase(deliveryIt);
+            const int64_t clientId = delivery.waiter.clientId;
+            this->mRunningClients.insert(clientId);
+
+            lock.unlock();
+            this->Deliver(delivery);
+            // Whatever the callback holds goes before the client can be told that its callbacks are done
+            delivery = Delivery();
+            lock.lock();
+
+            this->mRunningClients.erase(this->mRunningClients.find(clientId));
+            this->mCallbacksFinished.notify_all();
+            continue;
+        }
+
+        const std::string key = jobIt->first;
+        jobIt->second.running = true;
+        ParseFunction parse = jobIt->second.parse;
+
+        // The expensive part happens without the lock
+        lock.unlock();
+        std::shared_ptr<const void> result;
+        std::string error;
+        try
+        {
+            result = parse();
+        }
+        catch (std::exception& e)
+        {
+            error = e.what();
+        }
+        catch (...)
+        {
+            error = "Unknown error";
+        }
+        lock.lock();
+
+        // Waiters may have been cancelled while we were parsing. The rest are handed out to the pool, each on its own.
+        auto node = this->mJobs.extract(key);
+        if (result == nullptr && error.empty())
+            error = "Loader returned nothing";
+        for (Waiter& waiter : node.mapped().waiters)
+            this->mDeliveries.push_back({std::move(waiter), result, error, this->mNextSequence++});
+        this->mWorkAvailable.notify_all();
+    }
+}
@@ -0,0 +1,121 @@
+#ifndef __LOADER_SERVICE_H__
+#define __LOADER_SERVICE_H__
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Process-wide background loader shared by every plugin instance in the host.
+// Requests are keyed (e.g. by file path): if a request comes in for a key that's already queued or being parsed,
+// it's attached to that job instead of starting another parse, and every waiter gets the same result.
+// Callbacks run on the loader threads, each as a task of its own, so that the waiters on one parse (each of which
+// usually builds a model from it) are spread over the pool rather than run one after another.
+// Jobs are run by a small fixed pool of threads, highest priority first; callbacks whose parse is done go first.
+class LoaderService
+{
+public:
+    enum class Priority
+    {
+        kBackground = 0,
+        kNormal,
+        // The instance's editor is open
+        kVisible
+    };
+
+    // Returns the shared result, or throws on failure
+    using ParseFunction = std::function<std::shared_ptr<const void>()>;
+    // Called on a loader thread. On failure the result is null and the error is set.
+    using Callback = std::function<void(std::shared_ptr<const void> result, const std::string& error)>;
+
+    ~LoaderService();
+
+    // The service lives as long as somebody holds on to it
+    static std::shared_ptr<LoaderService> GetInstance();
+
+    // Every client gets an ID that its requests are filed under
+    int64_t RegisterClient();
+
+    void Request(const std::string& key, const Priority priority, const int64_t clientId, ParseFunction parse, Callback callback);
+
+    // Typed convenience wrapper around Request()
+    template <typename T>
+    void Request(const std::string& key, const Priority priority, const int64_t clientId, std::function<std::shared_ptr<const T>()> parse,
+                 std::function<void(std::shared_ptr<const T>, const std::string&)> callback)
+    {
+        Request(
+            key, priority, clientId, [parse = std::move(parse)]() -> std::shared_ptr<const void> { return parse(); },
+            [callback = std::move(callback)](std::shared_ptr<const void> result, const std::string& error)
+            { callback(std::static_pointer_cast<const T>(result), error); });
+    }
+
+    // Moves the client's queued requests (and any that it makes later) to a new priority
+    void SetPriority (const int64_t clientId, const Priority priority);
+
+    // Drops the client's queued callbacks and waits for any of its callbacks that are running right now.
+    // Call this before destroying anything the callbacks touch.
+    void CancelClient (const int64_t clientId);
+
+    int GetNumThreads() const { return (int)mThreads.size(); };
+
+private:
+    LoaderService (const int numThreads);
+
+    struct Waiter
+    {
+        int64_t clientId;
+        Priority priority;
+        Callback callback;
+    };
+
+    // A waiter whose parse is done
+    struct Delivery
+    {
+        Waiter waiter;
+        std::shared_ptr<const void> result;
+        std::string error;
+        uint64_t sequence = 0;
+    };
+
+    struct Job
+    {
+        ParseFunction parse;
+        std::vector<Waiter> waiters;
+        // FIFO order within a priority
+        uint64_t sequence = 0;
+        bool running = false;
+
+        Priority GetPriority() const;
+    };
+
+    void WorkerLoop ();
+    // Highest-priority job that isn't running yet, or end()
+    std::map<std::string, Job>::iterator NextJob ();
+    // Highest-priority delivery, or end()
+    std::vector<Delivery>::iterator NextDelivery ();
+    void Deliver (Delivery& delivery);
+
+    std::mutex mMutex;
+    std::condition_variable mWorkAvailable;
+    std::condition_variable mCallbacksFinished;
+
+    std::map<std::string, Job> mJobs;
+    std::vector<Delivery> mDeliveries;
+    std::map<int64_t, Priority> mClientPriorities;
+    // Clients whose callbacks are running, one entry per running callback
+    std::multiset<int64_t> mRunningClients;
+
+    int64_t mNextClientId = 1;
+    uint64_t mNextSequence = 0;
+    bool mStopping = false;
+
+    std::vector<std::thread> mThreads;
+};
+
+#endif
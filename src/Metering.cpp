@@ -0,0 +1,56 @@
+#include "Metering.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// Peak of the block, and adds its squares onto sumOfSquares
+float Measure(const float* samples, const int numFrames, double& sumOfSquares)
+{
+    float peak = 0.0f;
+    float squares = 0.0f;
+    for (int i = 0; i < numFrames; i++)
+    {
+        peak = std::max(peak, std::fabs(samples[i]));
+        squares += samples[i] * samples[i];
+    }
+    sumOfSquares += squares;
+    return peak;
+}
+}; // namespace
+
+void Metering::Reset(const double sampleRate)
+{
+    this->mSamplesPerFrame = std::max(1, static_cast<int>(sampleRate / kFramesPerSecond));
+    this->mSamples = 0;
+    this->mCurrent = MeterFrame();
+    this->mInputSquares = 0.0;
+    this->mOutputSquares = 0.0;
+}
+
+void Metering::AddInput(const float* samples, const int numFrames)
+{
+    this->mCurrent.inputPeak = std::max(this->mCurrent.inputPeak, Measure(samples, numFrames, this->mInputSquares));
+}
+
+void Metering::AddOutput(const float* samples, const int numFrames, const float gainReductionDB, const bool gating)
+{
+    this->mCurrent.outputPeak = std::max(this->mCurrent.outputPeak, Measure(samples, numFrames, this->mOutputSquares));
+    this->mCurrent.gainReductionDB = std::min(this->mCurrent.gainReductionDB, gainReductionDB);
+    this->mCurrent.gating = this->mCurrent.gating || gating;
+
+    // Whole blocks only, so a frame covers at least mSamplesPerFrame samples
+    this->mSamples += numFrames;
+    if (this->mSamples < this->mSamplesPerFrame)
+        return;
+
+    this->mCurrent.inputRms = static_cast<float>(std::sqrt(this->mInputSquares / this->mSamples));
+    this->mCurrent.outputRms = static_cast<float>(std::sqrt(this->mOutputSquares / this->mSamples));
+    this->mFifo.Push(this->mCurrent);
+
+    this->mSamples = 0;
+    this->mCurrent = MeterFrame();
+    this->mInputSquares = 0.0;
+    this->mOutputSquares = 0.0;
+}
@@ -0,0 +1,48 @@
+#ifndef __METERING_H__
+#define __METERING_H__
+
+#include "SpscFifo.h"
+
+// What the editor gets to see about one stretch of audio. Levels are linear.
+struct MeterFrame
+{
+    float inputPeak = 0.0f;
+    float inputRms = 0.0f;
+    float outputPeak = 0.0f;
+    float outputRms = 0.0f;
+    // Deepest noise gate gain reduction over the stretch, in dB (<= 0)
+    float gainReductionDB = 0.0f;
+    bool gating = false;
+};
+
+// Meters from the audio thread to the editor. The audio thread adds each block's input and output as it goes,
+// and about kFramesPerSecond times a second a MeterFrame summing up the blocks since the last one is pushed
+// into a SpscFifo. The editor pops them on its timer. No locks, copies of audio or allocations on the audio
+// thread; if the editor isn't open, frames are simply dropped once the queue is full.
+class Metering
+{
+public:
+    static constexpr int kFramesPerSecond = 60;
+
+    // Audio side. Call when the audio thread isn't running (e.g. prepareToPlay()).
+    void Reset (const double sampleRate);
+    // Call with the block's input before it's processed...
+    void AddInput (const float* samples, const int numFrames);
+    // ...and with its output, plus the gate's state over the block, afterwards
+    void AddOutput (const float* samples, const int numFrames, const float gainReductionDB, const bool gating);
+
+    // Editor side. Returns false once there are no more frames waiting.
+    bool Pop (MeterFrame& frame) { return this->mFifo.Pop(frame); };
+
+private:
+    // A few seconds' worth, so that a stalled editor doesn't lose anything recent
+    SpscFifo<MeterFrame, 256> mFifo;
+
+    int mSamplesPerFrame = 800;
+    int mSamples = 0;
+    MeterFrame mCurrent;
+    double mInputSquares = 0.0;
+    double mOutputSquares = 0.0;
+};
+
+#endif
@@ -0,0 +1,146 @@
+#include "ModelBrowser.h"
+
+#include <iterator>
+
+namespace
+{
+const char* kArchitectures[] = {"WaveNet", "LSTM", "ConvNet", "Linear"};
+
+juce::File getIndexFile()
+{
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+        .getChildFile("NeuralAmpModeler")
+        .getChildFile("ModelLibrary.json");
+}
+}; // namespace
+
+ModelBrowser::ModelBrowser()
+{
+    library = ModelLibrary::GetInstance(std::filesystem::u8path(getIndexFile().getFullPathName().toStdString()));
+
+    addAndMakeVisible(searchBox);
+    searchBox.setTextToShowWhenEmpty("Search models", juce::Colours::grey);
+    searchBox.onTextChange = [this] { updateResults(); };
+    searchBox.onReturnKey = [this] { chooseRow(resultList.getSelectedRow() >= 0 ? resultList.getSelectedRow() : 0); };
+
+    addAndMakeVisible(architectureBox);
+    architectureBox.addItem("All", 1);
+    for (int i = 0; i < (int)std::size(kArchitectures); i++)
+        architectureBox.addItem(kArchitectures[i], i + 2);
+    architectureBox.setSelectedId(1, juce::dontSendNotification);
+    architectureBox.onChange = [this] { updateResults(); };
+
+    addAndMakeVisible(addFolderButton);
+    addFolderButton.onClick = [this] { addFolder(); };
+
+    addAndMakeVisible(rescanButton);
+    rescanButton.onClick = [this] { library->Rescan(); };
+
+    addAndMakeVisible(statusLabel);
+    statusLabel.setJustificationType(juce::Justification::centredLeft);
+
+    addAndMakeVisible(resultList);
+    resultList.setRowHeight(20);
+
+    // Whatever was indexed last time shows up straight away; the scan only reads what's changed since
+    updateResults();
+    library->Rescan();
+    startTimerHz(2);
+}
+
+ModelBrowser::~ModelBrowser()
+{
+    stopTimer();
+}
+
+void ModelBrowser::resized()
+{
+    auto area = getLocalBounds();
+    auto top = area.removeFromTop(25);
+    architectureBox.setBounds(top.removeFromRight(100));
+    searchBox.setBounds(top.withTrimmedRight(5));
+
+    auto bottom = area.removeFromBottom(25);
+    addFolderButton.setBounds(bottom.removeFromLeft(100));
+    rescanButton.setBounds(bottom.removeFromLeft(70).withTrimmedLeft(5));
+    statusLabel.setBounds(bottom.withTrimmedLeft(5));
+
+    resultList.setBounds(area.reduced(0, 5));
+}
+
+int ModelBrowser::getNumRows()
+{
+    return (int)results.size();
+}
+
+void ModelBrowser::paintListBoxItem(int rowNumber, juce::Graphics& g, int width, int height, bool rowIsSelected)
+{
+    if (rowNumber < 0 || rowNumber >= (int)results.size())
+        return;
+    const ModelLibrary::Entry& entry = results[(size_t)rowNumber];
+
+    if (rowIsSelected)
+        g.fillAll(juce::Colours::darkblue);
+
+    juce::String details = juce::String(entry.gearMake + " " + entry.gearModel).trim();
+    details << (details.isEmpty() ? "" : ", ") << entry.architecture;
+    if (entry.sampleRate > 0.0)
+        details << ", " << juce::String(entry.sampleRate / 1000.0, 1) << " kHz";
+
+    g.setColour(juce::Colours::white);
+    g.setFont(14.0f);
+    g.drawText(juce::String(entry.name), 5, 0, width * 3 / 5 - 5, height, juce::Justification::centredLeft, true);
+    g.setColour(juce::Colours::lightgrey);
+    g.setFont(12.0f);
+    g.drawText(details, width * 3 / 5, 0, width * 2 / 5 - 5, height, juce::Justification::centredRight, true);
+}
+
+void ModelBrowser::listBoxItemDoubleClicked(int row, const juce::MouseEvent&)
+{
+    chooseRow(row);
+}
+
+void ModelBrowser::returnKeyPressed(int lastRowSelected)
+{
+    chooseRow(lastRowSelected);
+}
+
+void ModelBrowser::timerCallback()
+{
+    if (library->GetGeneration() != shownGeneration)
+        updateResults();
+    else
+        updateStatus();
+}
+
+void ModelBrowser::updateResults()
+{
+    shownGeneration = library->GetGeneration();
+    const int architectureId = architectureBox.getSelectedId();
+    const std::string architecture = architectureId >= 2 ? kArchitectures[architectureId - 2] : "";
+    results = library->Search(searchBox.getText().toStdString(), architecture);
+    resultList.updateContent();
+    resultList.repaint();
+    updateStatus();
+}
+
+void ModelBrowser::updateStatus()
+{
+    statusLabel.setText(juce::String((int)library->GetNumModels()) + " models" + (library->IsScanning() ? ", scanning..." : ""),
+                        juce::dontSendNotification);
+}
+
+void ModelBrowser::chooseRow(int row)
+{
+    if (row < 0 || row >= (int)results.size() || onModelChosen == nullptr)
+        return;
+    // The full parse happens here, in the processor's loader, and nowhere before
+    onModelChosen(juce::File(juce::String::fromUTF8(results[(size_t)row].path.c_str())));
+}
+
+void ModelBrowser::addFolder()
+{
+    juce::FileChooser chooser("Add a folder of models to the library", juce::File::getSpecialLocation(juce::File::userHomeDirectory));
+    if (chooser.browseForDirectory())
+        library->AddFolder(std::filesystem::u8path(chooser.getResult().getFullPathName().toStdString()));
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "ModelLibrary.h"
+
+#include <functional>
+#include <juce_gui_basics/juce_gui_basics.h>
+
+// Search box and list over the shared ModelLibrary. Typing filters the in-memory index straight away; nothing is
+// read from disk until a model is picked, which is handed to onModelChosen.
+class ModelBrowser final : public juce::Component, private juce::ListBoxModel, private juce::Timer
+{
+public:
+    ModelBrowser();
+    ~ModelBrowser() override;
+
+    std::function<void(const juce::File&)> onModelChosen;
+
+    void resized () override;
+
+private:
+    // ListBoxModel
+    int getNumRows () override;
+    void paintListBoxItem (int rowNumber, juce::Graphics& g, int width, int height, bool rowIsSelected) override;
+    void listBoxItemDoubleClicked (int row, const juce::MouseEvent&) override;
+    void returnKeyPressed (int lastRowSelected) override;
+
+    // Picks up new results while a scan is running
+    void timerCallback () override;
+
+    void updateResults ();
+    void updateStatus ();
+    void chooseRow (int row);
+    void addFolder ();
+
+    std::shared_ptr<ModelLibrary> library;
+    uint64_t shownGeneration{0};
+    std::vector<ModelLibrary::Entry> results;
+
+    juce::TextEditor searchBox;
+    juce::ComboBox architectureBox;
+    juce::TextButton addFolderButton{"Add Folder..."};
+    juce::TextButton rescanButton{"Rescan"};
+    juce::Label statusLabel;
+    juce::ListBox resultList{"Models", this};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ModelBrowser)
+};
@@ -0,0 +1,119 @@
+#include "ModelFactory.h"
+#include "BlockLSTM.h"
+#include "RingWaveNet.h"
+
+#include <get_dsp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+namespace
+{
+// The WaveNets that RingWaveNet can run: no post-head (the core refuses those anyway), no gated layers,
+// and the input as the only condition
+bool CanUseRingWaveNet(const nlohmann::json& config)
+{
+    if (config.find("head") != config.end() && !config["head"].is_null())
+        return false;
+    for (const auto& layerConfig : config["layers"])
+        if (layerConfig["gated"].get<bool>() || layerConfig["condition_size"].get<int>() != 1)
+            return false;
+    return !config["layers"].empty();
+}
+
+// Runs a second of plucks through the model both ways, from the same prewarmed start
+NamPruneReport MeasurePruning(const std::vector<RingWaveNet::LayerArrayParams>& params, const std::vector<float>& weights,
+                              const double expectedSampleRate, const float threshold)
+{
+    RingWaveNet full(params, weights, expectedSampleRate);
+    RingWaveNet pruned(params, weights, expectedSampleRate, threshold);
+    full.prewarm();
+    pruned.prewarm();
+
+    const double sampleRate = expectedSampleRate > 0.0 ? expectedSampleRate : 48000.0;
+    std::vector<NAM_SAMPLE> input(static_cast<size_t>(sampleRate)), fullOutput(input.size()), prunedOutput(input.size());
+    const double pi = 3.14159265358979;
+    for (size_t i = 0; i < input.size(); i++)
+    {
+        const double t = std::fmod(i / sampleRate, 0.25);
+        const double frequency = 82.41 * (1.0 + (i / (size_t)(0.25 * sampleRate)));
+        input[i] = (NAM_SAMPLE)(0.5 * std::exp(-6.0 * t) * std::sin(2.0 * pi * frequency * t));
+    }
+
+    const int blockSize = 256;
+    for (size_t offset = 0; offset < input.size(); offset += blockSize)
+    {
+        const int numFrames = (int)std::min<size_t>(blockSize, input.size() - offset);
+        full.process(input.data() + offset, fullOutput.data() + offset, numFrames);
+        pruned.process(input.data() + offset, prunedOutput.data() + offset, numFrames);
+    }
+
+    NamPruneReport report;
+    const RingWaveNet::PruneStats& stats = pruned.GetPruneStats();
+    report.pruned = true;
+    report.flopsBefore = stats.flopsBefore;
+    report.flopsAfter = stats.flopsAfter;
+    report.residualChannelsRemoved = stats.residualChannelsRemoved;
+    report.layerChannelsRemoved = stats.layerChannelsRemoved;
+    double sumSquares = 0.0;
+    for (size_t i = 0; i < input.size(); i++)
+    {
+        const double difference = std::fabs((double)fullOutput[i] - (double)prunedOutput[i]);
+        report.maxDifference = std::max(report.maxDifference, difference);
+        sumSquares += difference * difference;
+    }
+    report.rmsDifference = std::sqrt(sumSquares / input.size());
+    return report;
+}
+}; // namespace
+
+std::string NamPruneReport::ToString() const
+{
+    std::stringstream ss;
+    ss << "Pruned " << this->residualChannelsRemoved << " residual and " << this->layerChannelsRemoved << " layer channel(s): "
+       << this->flopsBefore << " -> " << this->flopsAfter << " FLOPs/sample";
+    if (this->flopsBefore > 0)
+        ss << " (" << 100.0 * (this->flopsBefore - this->flopsAfter) / this->flopsBefore << "% saved)";
+    ss << "; output difference on the test signal: max " << this->maxDifference << ", RMS " << this->rmsDifference;
+    return ss.str();
+}
+
+std::unique_ptr<nam::DSP> BuildNamDSP(nam::dspData& modelData, const NamBuildOptions& options, NamPruneReport* pruneReport)
+{
+    const nlohmann::json& config = modelData.config;
+    std::unique_ptr<nam::DSP> model;
+
+    if (options.blockLSTM && modelData.architecture == "LSTM" && config["input_size"].get<int>() == 1)
+    {
+        model = std::make_unique<BlockLSTM>(config["num_layers"].get<int>(), config["input_size"].get<int>(),
+                                            config["hidden_size"].get<int>(), modelData.weights, modelData.expected_sample_rate,
+                                            options.hugePages);
+    }
+    else if (options.ringWaveNet && modelData.architecture == "WaveNet" && CanUseRingWaveNet(config))
+    {
+        std::vector<RingWaveNet::LayerArrayParams> params;
+        for (const auto& layerConfig : config["layers"])
+        {
+            params.push_back({layerConfig["input_size"].get<int>(), layerConfig["condition_size"].get<int>(),
+                              layerConfig["head_size"].get<int>(), layerConfig["channels"].get<int>(),
+                              layerConfig["kernel_size"].get<int>(), layerConfig["dilations"].get<std::vector<int>>(),
+                              layerConfig["activation"].get<std::string>(), layerConfig["head_bias"].get<bool>()});
+        }
+        model = std::make_unique<RingWaveNet>(params, modelData.weights, modelData.expected_sample_rate, options.pruneThreshold,
+                                              options.hugePages);
+        if (pruneReport != nullptr && options.pruneThreshold >= 0.0f)
+            *pruneReport = MeasurePruning(params, modelData.weights, modelData.expected_sample_rate, options.pruneThreshold);
+    }
+    else
+    {
+        return nam::get_dsp(modelData);
+    }
+
+    const nlohmann::json& metadata = modelData.metadata;
+    if (!metadata.is_null() && metadata.find("loudness") != metadata.end() && !metadata["loudness"].is_null())
+        model->SetLoudness(metadata["loudness"].get<double>());
+
+    model->prewarm();
+    return model;
+}
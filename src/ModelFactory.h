@@ -0,0 +1,48 @@
+#ifndef __MODEL_FACTORY_H__
+#define __MODEL_FACTORY_H__
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <dsp.h>
+
+// Which of our own execution paths to use in place of the core's. Anything switched off (or not covered, like
+// architectures without a path of their own) is built by nam::get_dsp().
+struct NamBuildOptions
+{
+    // Block-batched LSTM (see BlockLSTM.h)
+    bool blockLSTM = true;
+    // WaveNet with ring-buffer histories (see RingWaveNet.h)
+    bool ringWaveNet = true;
+    // Take dead channels out of WaveNets run by RingWaveNet: weights no bigger than this count as zero. Below 0
+    // is off; 0 only takes out channels that can't make any difference.
+    float pruneThreshold = -1.0f;
+    // Put BlockLSTM's and RingWaveNet's packed weights on huge pages, for models big enough to fill one (see
+    // DSPArena)
+    bool hugePages = false;
+};
+
+// What pruning did to a model: what it costs per sample before and after, and how far its output moved on a
+// test signal
+struct NamPruneReport
+{
+    bool pruned = false;
+    int64_t flopsBefore = 0;
+    int64_t flopsAfter = 0;
+    int residualChannelsRemoved = 0;
+    int layerChannelsRemoved = 0;
+    double maxDifference = 0.0;
+    double rmsDifference = 0.0;
+
+    std::string ToString () const;
+};
+
+// Builds a model from parsed .nam data, like nam::get_dsp(): the model has its loudness set from the metadata
+// and is prewarmed. The data may be modified, so pass a copy if it's shared. Throws if the data is bad.
+// If the model gets pruned and a report is asked for, it's filled in; measuring the difference means building
+// and running the model twice more.
+std::unique_ptr<nam::DSP> BuildNamDSP (nam::dspData& modelData, const NamBuildOptions& options = NamBuildOptions(),
+                                       NamPruneReport* pruneReport = nullptr);
+
+#endif
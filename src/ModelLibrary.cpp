@@ -0,0 +1,364 @@
+#include "ModelLibrary.h"
+#include "NamModelFile.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+namespace
+{
+const int kIndexVersion = 1;
+// Let browsers know about new models every so often during a long scan
+const int kFilesPerUpdate = 50;
+
+std::string ToLower(std::string text)
+{
+    std::transform(text.begin(), text.end(), text.begin(), [](const unsigned char c) { return (char)std::tolower(c); });
+    return text;
+}
+
+std::string GetMetadataString(const nlohmann::json& metadata, const char* key)
+{
+    if (!metadata.is_object())
+        return "";
+    const auto it = metadata.find(key);
+    return it != metadata.end() && it->is_string() ? it->get<std::string>() : "";
+}
+
+void UpdateSearchText(ModelLibrary::Entry& entry)
+{
+    entry.searchText = ToLower(entry.name + "\n" + entry.path + "\n" + entry.architecture + "\n" + entry.modeledBy + "\n" + entry.gearMake
+                               + "\n" + entry.gearModel + "\n" + entry.gearType + "\n" + entry.toneType);
+}
+
+ModelLibrary::Entry ReadEntry(const std::filesystem::path& path, const int64_t modifiedTime, const uint64_t fileSize)
+{
+    ModelLibrary::Entry entry;
+    entry.path = path.u8string();
+    entry.modifiedTime = modifiedTime;
+    entry.fileSize = fileSize;
+    try
+    {
+        const NamModelInfo info = ReadNamModelInfo(path);
+        entry.architecture = info.architecture;
+        entry.sampleRate = info.expectedSampleRate;
+        entry.name = GetMetadataString(info.metadata, "name");
+        entry.modeledBy = GetMetadataString(info.metadata, "modeled_by");
+        entry.gearMake = GetMetadataString(info.metadata, "gear_make");
+        entry.gearModel = GetMetadataString(info.metadata, "gear_model");
+        entry.gearType = GetMetadataString(info.metadata, "gear_type");
+        entry.toneType = GetMetadataString(info.metadata, "tone_type");
+        if (info.metadata.is_object() && info.metadata.find("loudness") != info.metadata.end() && info.metadata["loudness"].is_number())
+        {
+            entry.hasLoudness = true;
+            entry.loudness = info.metadata["loudness"].get<double>();
+        }
+    }
+    catch (std::exception&)
+    {
+        entry.broken = true;
+    }
+    if (entry.name.empty())
+        entry.name = path.stem().u8string();
+    UpdateSearchText(entry);
+    return entry;
+}
+
+bool IsInFolder(const std::string& path, const std::filesystem::path& folder)
+{
+    const std::string prefix = folder.u8string();
+    return path.size() > prefix.size() && path.compare(0, prefix.size(), prefix) == 0
+           && (path[prefix.size()] == '/' || path[prefix.size()] == '\\');
+}
+}; // namespace
+
+ModelLibrary::ModelLibrary(const std::filesystem::path& indexFile) : mIndexFile(indexFile)
+{
+    this->LoadIndex();
+}
+
+ModelLibrary::~ModelLibrary()
+{
+    this->StopScan();
+}
+
+std::shared_ptr<ModelLibrary> ModelLibrary::GetInstance(const std::filesystem::path& indexFile)
+{
+    static std::mutex instanceMutex;
+    static std::weak_ptr<ModelLibrary> instance;
+
+    const std::lock_guard<std::mutex> lock(instanceMutex);
+    std::shared_ptr<ModelLibrary> library = instance.lock();
+    if (library == nullptr)
+    {
+        library.reset(new ModelLibrary(indexFile));
+        instance = library;
+    }
+    return library;
+}
+
+std::vector<std::filesystem::path> ModelLibrary::GetFolders() const
+{
+    const std::lock_guard<std::mutex> lock(this->mMutex);
+    return this->mFolders;
+}
+
+void ModelLibrary::AddFolder(const std::filesystem::path& folder)
+{
+    {
+        const std::lock_guard<std::mutex> lock(this->mMutex);
+        const std::filesystem::path normalized = folder.lexically_normal();
+        if (std::find(this->mFolders.begin(), this->mFolders.end(), normalized) == this->mFolders.end())
+            this->mFolders.push_back(normalized);
+    }
+    this->Rescan();
+}
+
+void ModelLibrary::RemoveFolder(const std::filesystem::path& folder)
+{
+    {
+        const std::lock_guard<std::mutex> lock(this->mMutex);
+        const std::filesystem::path normalized = folder.lexically_normal();
+        this->mFolders.erase(std::remove(this->mFolders.begin(), this->mFolders.end(), normalized), this->mFolders.end());
+        for (auto it = this->mEntries.begin(); it != this->mEntries.end();)
+            it = IsInFolder(it->first, normalized) ? this->mEntries.erase(it) : std::next(it);
+    }
+    this->mGeneration++;
+    this->SaveIndex();
+}
+
+void ModelLibrary::Rescan()
+{
+    const std::lock_guard<std::mutex> lock(this->mMutex);
+    if (this->mStopping)
+        return;
+    // The running scan may have gone past what changed; it goes round again when it's done
+    if (this->mScanning)
+    {
+        this->mRescanRequested = true;
+        return;
+    }
+    // A finished scan clears mScanning under the last lock it takes, so this doesn't wait on us
+    if (this->mScanThread.joinable())
+        this->mScanThread.join();
+    this->mScanning = true;
+    this->mScanThread = std::thread([this] { this->ScanLoop(); });
+}
+
+void ModelLibrary::StopScan()
+{
+    std::thread scanThread;
+    {
+        const std::lock_guard<std::mutex> lock(this->mMutex);
+        this->mStopping = true;
+        scanThread = std::move(this->mScanThread);
+    }
+    if (scanThread.joinable())
+        scanThread.join();
+}
+
+void ModelLibrary::ScanLoop()
+{
+    while (true)
+    {
+        this->ScanFolders();
+
+        const std::lock_guard<std::mutex> lock(this->mMutex);
+        if (!this->mRescanRequested || this->mStopping)
+        {
+            this->mScanning = false;
+            return;
+        }
+        this->mRescanRequested = false;
+    }
+}
+
+void ModelLibrary::ScanFolders()
+{
+    const std::vector<std::filesystem::path> folders = this->GetFolders();
+    std::set<std::string> found;
+    int sinceUpdate = 0;
+
+    for (const auto& folder : folders)
+    {
+        std::error_code error;
+        auto it = std::filesystem::recursive_directory_iterator(folder, std::filesystem::directory_options::skip_permission_denied, error);
+        for (; !error && it != std::filesystem::recursive_directory_iterator() && !this->mStopping; it.increment(error))
+        {
+            std::error_code fileError;
+            if (!it->is_regular_file(fileError) || ToLower(it->path().extension().u8string()) != ".nam")
+                continue;
+
+            const std::filesystem::path& path = it->path();
+            const std::string key = path.u8string();
+            const uint64_t fileSize = it->file_size(fileError);
+            const int64_t modifiedTime = static_cast<int64_t>(it->last_write_time(fileError).time_since_epoch().count());
+            if (fileError)
+                continue;
+            found.insert(key);
+
+            {
+                const std::lock_guard<std::mutex> lock(this->mMutex);
+                const auto existing = this->mEntries.find(key);
+                if (existing != this->mEntries.end() && existing->second.modifiedTime == modifiedTime && existing->second.fileSize == fileSize)
+                    continue;
+            }
+
+            // New or changed: read its header, without holding the lock
+            Entry entry = ReadEntry(path, modifiedTime, fileSize);
+            {
+                const std::lock_guard<std::mutex> lock(this->mMutex);
+                this->mEntries[key] = std::move(entry);
+            }
+            if (++sinceUpdate == kFilesPerUpdate)
+            {
+                sinceUpdate = 0;
+                this->mGeneration++;
+            }
+        }
+    }
+
+    // Files that have gone away. Only after a complete scan, or we'd forget what we didn't get to.
+    if (!this->mStopping)
+    {
+        const std::lock_guard<std::mutex> lock(this->mMutex);
+        for (auto it = this->mEntries.begin(); it != this->mEntries.end();)
+            it = found.count(it->first) == 0 ? this->mEntries.erase(it) : std::next(it);
+    }
+
+    this->mGeneration++;
+    this->SaveIndex();
+}
+
+std::vector<ModelLibrary::Entry> ModelLibrary::Search(const std::string& query, const std::string& architecture, const size_t maxResults) const
+{
+    std::vector<std::string> words;
+    std::istringstream stream(ToLower(query));
+    for (std::string word; stream >> word;)
+        words.push_back(word);
+
+    std::vector<Entry> results;
+    {
+        const std::lock_guard<std::mutex> lock(this->mMutex);
+        for (const auto& item : this->mEntries)
+        {
+            const Entry& entry = item.second;
+            if (entry.broken || (!architecture.empty() && entry.architecture != architecture))
+                continue;
+            const bool matches = std::all_of(words.begin(), words.end(),
+                                             [&entry](const std::string& word) { return entry.searchText.find(word) != std::string::npos; });
+            if (matches)
+                results.push_back(entry);
+        }
+    }
+
+    std::sort(results.begin(), results.end(),
+              [](const Entry& a, const Entry& b) { return a.name != b.name ? ToLower(a.name) < ToLower(b.name) : a.path < b.path; });
+    if (results.size() > maxResults)
+        results.resize(maxResults);
+    return results;
+}
+
+size_t ModelLibrary::GetNumModels() const
+{
+    const std::lock_guard<std::mutex> lock(this->mMutex);
+    return (size_t)std::count_if(this->mEntries.begin(), this->mEntries.end(), [](const auto& item) { return !item.second.broken; });
+}
+
+void ModelLibrary::LoadIndex()
+{
+    std::ifstream file(this->mIndexFile, std::ios::binary);
+    if (!file.is_open())
+        return;
+
+    // A missing or unreadable index just means a full scan
+    const nlohmann::json index = nlohmann::json::parse(file, nullptr, false);
+    if (index.is_discarded() || !index.is_object() || index.value("version", 0) != kIndexVersion)
+        return;
+
+    try
+    {
+        for (const auto& folder : index["folders"])
+            this->mFolders.push_back(std::filesystem::u8path(folder.get<std::string>()));
+
+        for (const auto& model : index["models"])
+        {
+            Entry entry;
+            entry.path = model["path"].get<std::string>();
+            entry.modifiedTime = model["modified"].get<int64_t>();
+            entry.fileSize = model["size"].get<uint64_t>();
+            entry.broken = model.value("broken", false);
+            entry.architecture = model.value("architecture", "");
+            entry.sampleRate = model.value("sample_rate", -1.0);
+            entry.hasLoudness = model.find("loudness") != model.end();
+            entry.loudness = model.value("loudness", 0.0);
+            entry.name = model.value("name", "");
+            entry.modeledBy = model.value("modeled_by", "");
+            entry.gearMake = model.value("gear_make", "");
+            entry.gearModel = model.value("gear_model", "");
+            entry.gearType = model.value("gear_type", "");
+            entry.toneType = model.value("tone_type", "");
+            UpdateSearchText(entry);
+            this->mEntries[entry.path] = std::move(entry);
+        }
+    }
+    catch (std::exception&)
+    {
+        this->mFolders.clear();
+        this->mEntries.clear();
+    }
+}
+
+void ModelLibrary::SaveIndex() const
+{
+    // The scan thread and RemoveFolder() both save, through the same temporary file. Taking the snapshot under
+    // this lock too means that the last save to finish is also the newest.
+    const std::lock_guard<std::mutex> saveLock(this->mSaveMutex);
+
+    nlohmann::json index;
+    index["version"] = kIndexVersion;
+    index["folders"] = nlohmann::json::array();
+    index["models"] = nlohmann::json::array();
+    {
+        const std::lock_guard<std::mutex> lock(this->mMutex);
+        for (const auto& folder : this->mFolders)
+            index["folders"].push_back(folder.u8string());
+        for (const auto& item : this->mEntries)
+        {
+            const Entry& entry = item.second;
+            nlohmann::json model = {{"path", entry.path}, {"modified", entry.modifiedTime}, {"size", entry.fileSize}};
+            if (entry.broken)
+                model["broken"] = true;
+            else
+            {
+                model["architecture"] = entry.architecture;
+                model["sample_rate"] = entry.sampleRate;
+                if (entry.hasLoudness)
+                    model["loudness"] = entry.loudness;
+                model["name"] = entry.name;
+                model["modeled_by"] = entry.modeledBy;
+                model["gear_make"] = entry.gearMake;
+                model["gear_model"] = entry.gearModel;
+                model["gear_type"] = entry.gearType;
+                model["tone_type"] = entry.toneType;
+            }
+            index["models"].push_back(std::move(model));
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(this->mIndexFile.parent_path(), error);
+    std::filesystem::path temporary = this->mIndexFile;
+    temporary += ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+            return;
+        file << index.dump();
+        if (!file.good())
+            return;
+    }
+    std::filesystem::rename(temporary, this->mIndexFile, error);
+}
@@ -0,0 +1,99 @@
+#ifndef __MODEL_LIBRARY_H__
+#define __MODEL_LIBRARY_H__
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Searchable index of the .nam files under a set of folders.
+//
+// A background thread walks the folders and reads only the header of each model (see ReadNamModelInfo()), never
+// its weights. The index is saved to disk, with each file's modification time and size, so that the next scan
+// only has to read files that are new or have changed. Searching is done on the in-memory index and doesn't
+// touch the disk; the full parse only happens when a model is actually loaded.
+//
+// Shared by every instance in the process, like LoaderService.
+class ModelLibrary
+{
+public:
+    struct Entry
+    {
+        std::string path;
+        int64_t modifiedTime = 0;
+        uint64_t fileSize = 0;
+
+        std::string architecture;
+        double sampleRate = -1.0;
+        bool hasLoudness = false;
+        double loudness = 0.0;
+        // From the metadata, empty if it isn't there, apart from the name, which falls back to the file's
+        std::string name;
+        std::string modeledBy;
+        std::string gearMake;
+        std::string gearModel;
+        std::string gearType;
+        std::string toneType;
+
+        // Couldn't be read as a model; kept so that it isn't retried until it changes
+        bool broken = false;
+
+        // Lowercase name, path and metadata, for Search(). Not saved.
+        std::string searchText;
+    };
+
+    ~ModelLibrary();
+
+    // The index is kept in indexFile. The first caller picks where that is.
+    static std::shared_ptr<ModelLibrary> GetInstance (const std::filesystem::path& indexFile);
+
+    std::vector<std::filesystem::path> GetFolders () const;
+    // Adds a folder to the library and rescans
+    void AddFolder (const std::filesystem::path& folder);
+    void RemoveFolder (const std::filesystem::path& folder);
+
+    // Starts a scan in the background. If one is running already, it scans again once it's done.
+    void Rescan ();
+    bool IsScanning () const { return this->mScanning; };
+
+    // Goes up whenever the index changes, so that a browser knows to search again
+    uint64_t GetGeneration () const { return this->mGeneration; };
+
+    // Models whose name, path or metadata contain every word of the query (case-insensitive), optionally only of
+    // one architecture, sorted by name. Broken files are left out.
+    std::vector<Entry> Search (const std::string& query, const std::string& architecture = "", const size_t maxResults = 1000) const;
+    size_t GetNumModels () const;
+
+private:
+    ModelLibrary (const std::filesystem::path& indexFile);
+
+    void LoadIndex ();
+    // Writes to a temporary file first, so that a crash can't leave a half-written index behind
+    void SaveIndex () const;
+    // Scans until nobody's asked for another scan
+    void ScanLoop ();
+    void ScanFolders ();
+    void StopScan ();
+
+    std::filesystem::path mIndexFile;
+    // Serialises SaveIndex(); taken before mMutex
+    mutable std::mutex mSaveMutex;
+
+    // Guards everything below it, apart from the atomics
+    mutable std::mutex mMutex;
+    std::vector<std::filesystem::path> mFolders;
+    std::map<std::string, Entry> mEntries;
+    bool mRescanRequested = false;
+
+    std::thread mScanThread;
+    std::atomic<bool> mScanning{false};
+    std::atomic<bool> mStopping{false};
+    std::atomic<uint64_t> mGeneration{0};
+};
+
+#endif
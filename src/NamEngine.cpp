@@ -0,0 +1,268 @@
+#include "NamEngine.h"
+#include "CpuFeatures.h"
+#include "NamModelFile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+#include <wav.h>
+
+namespace
+{
+// Same as the plugin's parameters
+const float kDefaultValues[NamEngine::kNumParameters] = {0.0f, -80.0f, 5.0f, 5.0f, 5.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f};
+
+// The 6 dB of makeup that has always followed the cab
+const float kCabGain = 1.99526231f;
+
+int NextPowerOfTwo(const int n)
+{
+    int result = 1;
+    while (result < n)
+        result *= 2;
+    return result;
+}
+
+// Of the file's contents, for IRStore. The plugin keys its IRs by SHA-256 instead, so the two don't share spectra.
+std::string HashBytes(const std::vector<char>& bytes)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (const char byte : bytes)
+    {
+        hash ^= static_cast<unsigned char>(byte);
+        hash *= 1099511628211ull;
+    }
+    char text[32];
+    std::snprintf(text, sizeof(text), "fnv1a-%016llx", (unsigned long long)hash);
+    return text;
+}
+
+std::shared_ptr<const IRSpectra> ReadIR(const std::string& path, const double sampleRate, const int partitionSize)
+{
+    std::ifstream file(std::filesystem::u8path(path), std::ios::binary);
+    if (!file)
+        throw std::runtime_error("Couldn't read the file");
+    const std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    const std::string hash = HashBytes(bytes);
+
+    // Another engine may have this IR already; then there's nothing to decode
+    const std::shared_ptr<IRStore> store = IRStore::GetInstance();
+    if (auto spectra = store->Find(hash, sampleRate, partitionSize))
+        return spectra;
+
+    std::vector<float> audio;
+    double irSampleRate = 0.0;
+    const dsp::wav::LoadReturnCode result = dsp::wav::Load(path.c_str(), audio, irSampleRate);
+    if (result != dsp::wav::LoadReturnCode::SUCCESS)
+        throw std::runtime_error(dsp::wav::GetMsgForLoadReturnCode(result));
+    return store->Acquire(hash, audio.data(), audio.size(), irSampleRate, sampleRate, partitionSize);
+}
+}; // namespace
+
+NamEngine::NamEngine()
+{
+    for (int i = 0; i < kNumParameters; i++)
+    {
+        mValues[i] = kDefaultValues[i];
+        this->HookParameter(i, &mValues[i]);
+    }
+    mLoaderClientId = mLoader->RegisterClient();
+}
+
+NamEngine::~NamEngine()
+{
+    // Make sure no load finishes into a half-destroyed engine
+    mLoader->CancelClient(mLoaderClientId);
+}
+
+void NamEngine::Prepare(const double sampleRate, const int maxBlockSize)
+{
+    mAmp.prepare(sampleRate, maxBlockSize);
+
+    // Partitions the size of the host's blocks, so that a block is usually one partition
+    const int partitionSize = std::clamp(NextPowerOfTwo(maxBlockSize), 64, 1024);
+    std::array<std::string, kNumIRs> reload;
+    {
+        const std::lock_guard<std::mutex> lock(mMutex);
+        if (sampleRate != mSampleRate || partitionSize != mPartitionSize)
+            reload = mIRPaths;
+        mSampleRate = sampleRate;
+        mPartitionSize = partitionSize;
+    }
+    mCab.Reset();
+    mPrepared = true;
+
+    for (int slot = 0; slot < kNumIRs; slot++)
+        if (!reload[slot].empty())
+            this->LoadIR(reload[slot], slot);
+}
+
+void NamEngine::Process(float* data, const int numFrames)
+{
+    // Nothing to run the chain in yet
+    if (!mPrepared)
+        return;
+
+#ifdef NAM_X86
+    // Flush denormals to zero, and give the caller its own mode back after
+    const unsigned int mxcsr = _mm_getcsr();
+    _mm_setcsr(mxcsr | 0x8040);
+#endif
+
+    mAmp.process(data, numFrames);
+
+    if (mParameters[kCabActive]->load() >= 0.5f)
+    {
+        mCab.SetBlend(std::clamp(mParameters[kCabBlend]->load(), 0.0f, 1.0f));
+        mCab.Process(data, numFrames);
+        if (mCab.IsActive())
+            for (int i = 0; i < numFrames; i++)
+                data[i] *= kCabGain;
+    }
+
+#ifdef NAM_X86
+    _mm_setcsr(mxcsr);
+#endif
+}
+
+void NamEngine::SetParameter(const int parameter, const float value)
+{
+    mParameters[parameter]->store(value);
+}
+
+float NamEngine::GetParameter(const int parameter) const
+{
+    return mParameters[parameter]->load();
+}
+
+void NamEngine::HookParameter(const int parameter, std::atomic<float>* value)
+{
+    mParameters[parameter] = value;
+    if (parameter < NeuralAmpModeler::kNumParameters)
+        mAmp.hookParameter(static_cast<NeuralAmpModeler::Parameters>(parameter), value);
+}
+
+void NamEngine::LoadModel(const std::string& path, const int slot, LoadCallback callback)
+{
+    const int generation = ++mModelGeneration[slot];
+    // Keyed apart from the plugin's loads of the same file, which hand out something else
+    mLoader->Request<nam::dspData>(
+        "engine-model:" + path, LoaderService::Priority::kNormal, mLoaderClientId,
+        [path] { return std::make_shared<const nam::dspData>(ReadNamModel(std::filesystem::u8path(path))); },
+        [this, slot, generation, callback](std::shared_ptr<const nam::dspData> data, const std::string& error)
+        {
+            if (generation != mModelGeneration[slot].load())
+                return;
+            // Checked again when the model is staged, since a load or clear can come in while it's being built
+            const auto isCurrent = [this, slot, generation] { return generation == mModelGeneration[slot].load(); };
+            const bool loaded = data != nullptr && mAmp.loadModel(*data, slot, isCurrent);
+            if (!isCurrent())
+                return;
+            if (callback)
+                callback(loaded, data == nullptr ? error : loaded ? std::string() : "Failed to build the model");
+        });
+}
+
+bool NamEngine::LoadModel(const nam::dspData& modelData, const int slot, const std::function<bool()>& isCurrent)
+{
+    const int generation = ++mModelGeneration[slot];
+    return mAmp.loadModel(modelData, slot,
+                          [this, slot, generation, &isCurrent]
+                          { return generation == mModelGeneration[slot].load() && (isCurrent == nullptr || isCurrent()); });
+}
+
+void NamEngine::LoadIR(const std::string& path, const int slot, LoadCallback callback)
+{
+    int generation;
+    double sampleRate;
+    int partitionSize;
+    {
+        const std::lock_guard<std::mutex> lock(mMutex);
+        generation = ++mIRGeneration[slot];
+        sampleRate = mSampleRate;
+        partitionSize = mPartitionSize;
+    }
+
+    const std::string key = "engine-ir:" + path + "@" + std::to_string(sampleRate) + "/" + std::to_string(partitionSize);
+    mLoader->Request<IRSpectra>(
+        key, LoaderService::Priority::kNormal, mLoaderClientId, [path, sampleRate, partitionSize] { return ReadIR(path, sampleRate, partitionSize); },
+        [this, path, slot, generation, callback](std::shared_ptr<const IRSpectra> spectra, const std::string& error)
+        {
+            {
+                const std::lock_guard<std::mutex> lock(mMutex);
+                if (generation != mIRGeneration[slot])
+                    return;
+                if (spectra != nullptr)
+                {
+                    mIRs[slot] = spectra;
+                    mIRPaths[slot] = path;
+                    mCab.Stage(mIRs[0], mIRs[1]);
+                }
+            }
+            if (callback)
+                callback(spectra != nullptr, error);
+        });
+}
+
+void NamEngine::SetIRs(std::shared_ptr<const IRSpectra> first, std::shared_ptr<const IRSpectra> second)
+{
+    const std::lock_guard<std::mutex> lock(mMutex);
+    mIRs = {std::move(first), std::move(second)};
+    for (int slot = 0; slot < kNumIRs; slot++)
+    {
+        ++mIRGeneration[slot];
+        mIRPaths[slot].clear();
+    }
+    // Under the lock, so that two callers can't stage an older pair over a newer one
+    mCab.Stage(mIRs[0], mIRs[1]);
+}
+
+void NamEngine::ClearModel(const int slot)
+{
+    ++mModelGeneration[slot];
+    mAmp.clearModel(slot);
+}
+
+void NamEngine::ClearIR(const int slot)
+{
+    const std::lock_guard<std::mutex> lock(mMutex);
+    ++mIRGeneration[slot];
+    mIRs[slot] = nullptr;
+    mIRPaths[slot].clear();
+    mCab.Stage(mIRs[0], mIRs[1]);
+}
+
+bool NamEngine::IsIRLoaded(const int slot)
+{
+    const std::lock_guard<std::mutex> lock(mMutex);
+    return mIRs[slot] != nullptr;
+}
+
+double NamEngine::GetTailSeconds()
+{
+    const bool cabActive = mParameters[kCabActive]->load() >= 0.5f && mCab.IsActive();
+    return mAmp.getTailSeconds() + (cabActive ? mCab.GetIRLength() / mSampleRate.load() : 0.0);
+}
+
+size_t NamEngine::Release()
+{
+    for (std::atomic<int>& generation : mModelGeneration)
+        ++generation;
+    size_t bytes = mAmp.releaseModel();
+    {
+        const std::lock_guard<std::mutex> lock(mMutex);
+        for (int slot = 0; slot < kNumIRs; slot++)
+        {
+            ++mIRGeneration[slot];
+            mIRs[slot] = nullptr;
+            mIRPaths[slot].clear();
+        }
+    }
+    bytes += mCab.Release();
+    return bytes;
+}
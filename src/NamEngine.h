@@ -0,0 +1,110 @@
+#ifndef __NAM_ENGINE_H__
+#define __NAM_ENGINE_H__
+
+#include "IRStore.h"
+#include "LoaderService.h"
+#include "NeuralAmpModeler.h"
+#include "PartitionedConvolver.h"
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// The whole real-time chain, without JUCE: the amp (noise gate, up to two blended models, tone stack, output
+// gain), then the cab (up to two blended IRs). The plugin is a wrapper around it; NamEngineApi.h is a C interface
+// to it, for hosts of our own.
+//
+// Prepare() and Process() belong to the audio thread and never run at the same time. Process() doesn't allocate or
+// wait: models and IRs are built on other threads and handed over, and it only ever try-locks to pick them up. Everything else may be called from any
+// thread.
+class NamEngine
+{
+public:
+    static constexpr int kNumModels = NeuralAmpModeler::kNumModels;
+    static constexpr int kNumIRs = 2;
+
+    // The amp's parameters (NeuralAmpModeler::Parameters), then the cab's
+    enum Parameters
+    {
+        kCabActive = NeuralAmpModeler::kNumParameters,
+        // 0 is only the first IR, 1 only the second
+        kCabBlend,
+        kNumParameters
+    };
+
+    // Called on a loader thread when a load finishes; on failure, success is false and error says why
+    using LoadCallback = std::function<void(const bool success, const std::string& error)>;
+
+    NamEngine ();
+    ~NamEngine ();
+
+    // IRs that LoadIR() loaded are made again in the background if the sample rate or the partition size changed;
+    // until then, the old ones keep playing
+    void Prepare (const double sampleRate, const int maxBlockSize);
+    // Mono, in place, blocks of any size. Flushes denormals to zero while it runs. Passes the audio through until
+    // the first Prepare().
+    void Process (float* data, const int numFrames);
+
+    // Parameters are held by the engine, unless a host that keeps its own (e.g. a plugin's parameter tree) points
+    // the engine at those with HookParameter()
+    void SetParameter (const int parameter, const float value);
+    float GetParameter (const int parameter) const;
+    void HookParameter (const int parameter, std::atomic<float>* value);
+
+    // Reads and builds the model, or reads, processes and transforms the IR, on the shared loader's threads, and
+    // swaps it in. A later load or clear of the same slot supersedes one that's still going, whose callback is then
+    // not called.
+    void LoadModel (const std::string& path, const int slot, LoadCallback callback = nullptr);
+    void LoadIR (const std::string& path, const int slot, LoadCallback callback = nullptr);
+    // From a model that's been read already; on the calling thread. isCurrent is passed on to
+    // NeuralAmpModeler::loadModel(), for callers that keep their own load generations.
+    bool LoadModel (const nam::dspData& modelData, const int slot, const std::function<bool()>& isCurrent = nullptr);
+    // Spectra made elsewhere (see IRStore), for the prepared sample rate and GetPartitionSize(). Null clears a slot.
+    void SetIRs (std::shared_ptr<const IRSpectra> first, std::shared_ptr<const IRSpectra> second);
+    void ClearModel (const int slot);
+    void ClearIR (const int slot);
+
+    bool IsModelLoaded (const int slot) { return mAmp.isModelLoaded(slot); };
+    bool IsIRLoaded (const int slot);
+    double GetSampleRate () const { return mSampleRate; };
+    // Of the cab's partitions at the last Prepare(): the block size that IR spectra are made for
+    int GetPartitionSize () const { return mPartitionSize; };
+
+    // Audio thread: of the chain as it is now
+    int GetLatencySamples () const { return mAmp.getLatencySamples(); };
+    double GetTailSeconds ();
+
+    // For the amp's own settings and state (gate, levels, pruning)
+    NeuralAmpModeler& GetAmp () { return mAmp; };
+
+    // Frees the models and IRs now, while Process() is held off. Returns roughly how much that gave back.
+    size_t Release ();
+
+private:
+    NeuralAmpModeler mAmp;
+    StagedConvolver mCab;
+
+    std::array<std::atomic<float>, kNumParameters> mValues;
+    std::array<std::atomic<float>*, kNumParameters> mParameters;
+
+    std::atomic<double> mSampleRate{48000.0};
+    std::atomic<int> mPartitionSize{512};
+    // Audio thread: Process() passes the audio through untouched until the first Prepare()
+    bool mPrepared = false;
+
+    // Guards the IRs, and the load generations, which go up with every load or clear of a slot
+    std::mutex mMutex;
+    std::array<std::shared_ptr<const IRSpectra>, kNumIRs> mIRs;
+    // Of the IRs that LoadIR() loaded, for Prepare() to load again
+    std::array<std::string, kNumIRs> mIRPaths;
+    std::array<int, kNumIRs> mIRGeneration{};
+    std::array<std::atomic<int>, kNumModels> mModelGeneration{};
+
+    std::shared_ptr<LoaderService> mLoader{LoaderService::GetInstance()};
+    int64_t mLoaderClientId{0};
+};
+
+#endif
@@ -0,0 +1,156 @@
+#include "NamEngineApi.h"
+#include "NamEngine.h"
+
+#include <new>
+
+static_assert(NAM_PARAMETER_INPUT_LEVEL == NeuralAmpModeler::kInputLevel && NAM_PARAMETER_NOISE_GATE_THRESHOLD == NeuralAmpModeler::kNoiseGateThreshold
+                  && NAM_PARAMETER_BASS == NeuralAmpModeler::kToneBass && NAM_PARAMETER_MIDDLE == NeuralAmpModeler::kToneMid
+                  && NAM_PARAMETER_TREBLE == NeuralAmpModeler::kToneTreble && NAM_PARAMETER_OUTPUT_LEVEL == NeuralAmpModeler::kOutputLevel
+                  && NAM_PARAMETER_TONE_STACK == NeuralAmpModeler::kEQActive && NAM_PARAMETER_NORMALIZE == NeuralAmpModeler::kOutNorm
+                  && NAM_PARAMETER_MODEL_BLEND == NeuralAmpModeler::kModelBlend && NAM_PARAMETER_CAB == NamEngine::kCabActive
+                  && NAM_PARAMETER_CAB_BLEND == NamEngine::kCabBlend && NAM_NUM_PARAMETERS == NamEngine::kNumParameters,
+              "nam_parameter has to match NamEngine::Parameters");
+
+struct nam_engine
+{
+    NamEngine engine;
+};
+
+namespace
+{
+bool IsModelSlot(const int slot)
+{
+    return slot >= 0 && slot < NamEngine::kNumModels;
+}
+
+bool IsIRSlot(const int slot)
+{
+    return slot >= 0 && slot < NamEngine::kNumIRs;
+}
+
+NamEngine::LoadCallback MakeCallback(const int slot, nam_load_callback callback, void* userData)
+{
+    if (callback == nullptr)
+        return nullptr;
+    return [slot, callback, userData](const bool success, const std::string& error) { callback(userData, slot, success ? 1 : 0, error.c_str()); };
+}
+}; // namespace
+
+nam_engine* nam_engine_create(void)
+{
+    try
+    {
+        return new nam_engine();
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+void nam_engine_destroy(nam_engine* engine)
+{
+    delete engine;
+}
+
+void nam_engine_prepare(nam_engine* engine, double sample_rate, int max_block_size)
+{
+    if (engine == nullptr || sample_rate <= 0.0 || max_block_size <= 0)
+        return;
+    try
+    {
+        engine->engine.Prepare(sample_rate, max_block_size);
+    }
+    catch (...)
+    {
+    }
+}
+
+void nam_engine_process(nam_engine* engine, float* samples, int num_frames)
+{
+    if (engine == nullptr || samples == nullptr || num_frames <= 0)
+        return;
+    engine->engine.Process(samples, num_frames);
+}
+
+int nam_engine_set_parameter(nam_engine* engine, nam_parameter parameter, float value)
+{
+    if (engine == nullptr || parameter < 0 || parameter >= NAM_NUM_PARAMETERS)
+        return 0;
+    engine->engine.SetParameter(parameter, value);
+    return 1;
+}
+
+float nam_engine_get_parameter(const nam_engine* engine, nam_parameter parameter)
+{
+    if (engine == nullptr || parameter < 0 || parameter >= NAM_NUM_PARAMETERS)
+        return 0.0f;
+    return engine->engine.GetParameter(parameter);
+}
+
+int nam_engine_load_model(nam_engine* engine, const char* path, int slot, nam_load_callback callback, void* user_data)
+{
+    if (engine == nullptr || path == nullptr || !IsModelSlot(slot))
+        return 0;
+    try
+    {
+        engine->engine.LoadModel(path, slot, MakeCallback(slot, callback, user_data));
+        return 1;
+    }
+    catch (...)
+    {
+        return 0;
+    }
+}
+
+int nam_engine_load_ir(nam_engine* engine, const char* path, int slot, nam_load_callback callback, void* user_data)
+{
+    if (engine == nullptr || path == nullptr || !IsIRSlot(slot))
+        return 0;
+    try
+    {
+        engine->engine.LoadIR(path, slot, MakeCallback(slot, callback, user_data));
+        return 1;
+    }
+    catch (...)
+    {
+        return 0;
+    }
+}
+
+void nam_engine_clear_model(nam_engine* engine, int slot)
+{
+    if (engine != nullptr && IsModelSlot(slot))
+        engine->engine.ClearModel(slot);
+}
+
+void nam_engine_clear_ir(nam_engine* engine, int slot)
+{
+    if (engine != nullptr && IsIRSlot(slot))
+    {
+        try
+        {
+            engine->engine.ClearIR(slot);
+        }
+        catch (...)
+        {
+        }
+    }
+}
+
+int nam_engine_is_model_loaded(nam_engine* engine, int slot)
+{
+    return engine != nullptr && IsModelSlot(slot) && engine->engine.IsModelLoaded(slot) ? 1 : 0;
+}
+
+int nam_engine_is_ir_loaded(nam_engine* engine, int slot)
+{
+    return engine != nullptr && IsIRSlot(slot) && engine->engine.IsIRLoaded(slot) ? 1 : 0;
+}
+
+int nam_engine_get_latency(nam_engine* engine)
+{
+    if (engine == nullptr)
+        return 0;
+    return engine->engine.GetLatencySamples();
+}
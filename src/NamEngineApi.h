@@ -0,0 +1,72 @@
+#ifndef __NAM_ENGINE_API_H__
+#define __NAM_ENGINE_API_H__
+
+// C interface to NamEngine: the whole amp and cab chain, for hosts that embed it without C++ or JUCE.
+//
+// nam_engine_prepare() and nam_engine_process() belong to the audio thread and never run at the same time.
+// nam_engine_process() doesn't allocate, lock or wait. Loads run on background threads and report back on them;
+// everything else may be called from any thread. Nothing here throws.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct nam_engine nam_engine;
+
+typedef enum nam_parameter
+{
+    // dB
+    NAM_PARAMETER_INPUT_LEVEL = 0,
+    // dB; below -100 turns the gate off
+    NAM_PARAMETER_NOISE_GATE_THRESHOLD,
+    // 0 to 10
+    NAM_PARAMETER_BASS,
+    NAM_PARAMETER_MIDDLE,
+    NAM_PARAMETER_TREBLE,
+    // dB
+    NAM_PARAMETER_OUTPUT_LEVEL,
+    // 0 or 1
+    NAM_PARAMETER_TONE_STACK,
+    NAM_PARAMETER_NORMALIZE,
+    // 0 is only the model in slot 0, 1 only the one in slot 1
+    NAM_PARAMETER_MODEL_BLEND,
+    // 0 or 1
+    NAM_PARAMETER_CAB,
+    // 0 is only the IR in slot 0, 1 only the one in slot 1
+    NAM_PARAMETER_CAB_BLEND,
+    NAM_NUM_PARAMETERS
+} nam_parameter;
+
+// On a loader thread. success is 1 if the model or IR is in; otherwise 0, and error says why.
+typedef void (*nam_load_callback) (void* user_data, int slot, int success, const char* error);
+
+// Null if it couldn't be made. The functions below do nothing (and return 0) when handed a null engine.
+nam_engine* nam_engine_create (void);
+// Waits for any callback that's running right now; none are called after it returns
+void nam_engine_destroy (nam_engine* engine);
+
+void nam_engine_prepare (nam_engine* engine, double sample_rate, int max_block_size);
+// Mono, in place, any number of frames. Until the first nam_engine_prepare() the samples are left as they are.
+void nam_engine_process (nam_engine* engine, float* samples, int num_frames);
+
+// Both return 0 / 0.0f if parameter isn't one
+int nam_engine_set_parameter (nam_engine* engine, nam_parameter parameter, float value);
+float nam_engine_get_parameter (const nam_engine* engine, nam_parameter parameter);
+
+// slot is 0 or 1; path is UTF-8 (IRs are WAV files). callback may be null. A later load or clear of the same slot
+// supersedes one that's still going, and its callback isn't called. Return 0 if the arguments are bad.
+int nam_engine_load_model (nam_engine* engine, const char* path, int slot, nam_load_callback callback, void* user_data);
+int nam_engine_load_ir (nam_engine* engine, const char* path, int slot, nam_load_callback callback, void* user_data);
+void nam_engine_clear_model (nam_engine* engine, int slot);
+void nam_engine_clear_ir (nam_engine* engine, int slot);
+int nam_engine_is_model_loaded (nam_engine* engine, int slot);
+int nam_engine_is_ir_loaded (nam_engine* engine, int slot);
+
+// Audio thread: of the chain as it is now
+int nam_engine_get_latency (nam_engine* engine);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,641 @@
+#include "NamModelFile.h"
+#include "CpuFeatures.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+// Files up to this size are read whole; past it, the weights are streamed
+const size_t kWholeFileBytes = 256 * 1024;
+const size_t kHeadBytes = 64 * 1024;
+const size_t kTailBytes = 16 * 1024;
+// How much of the weights array is read at a time
+const size_t kChunkBytes = 1024 * 1024;
+
+// Thrown when the scanner gets to the end of what's been read before it's done
+struct NeedMoreData
+{
+};
+
+// Just enough of a JSON reader to walk the top-level object of a .nam file, handing back where each value is
+// without parsing the ones we don't want.
+class HeaderScanner
+{
+public:
+    HeaderScanner(const char* data, const size_t size) : mData(data), mSize(size) {}
+
+    size_t GetPosition() const { return this->mPos; }
+    void SetPosition(const size_t position) { this->mPos = position; }
+
+    char Peek()
+    {
+        this->SkipWhitespace();
+        if (this->mPos >= this->mSize)
+            throw NeedMoreData();
+        return this->mData[this->mPos];
+    }
+
+    void Expect(const char c)
+    {
+        if (this->Peek() != c)
+            throw std::runtime_error(std::string("Malformed model file: expected '") + c + "'");
+        this->mPos++;
+    }
+
+    // Returns a key or string value. Escapes are left as they are, which is fine for the keys we look for.
+    std::string ReadString()
+    {
+        this->Expect('"');
+        const size_t start = this->mPos;
+        for (; this->mPos < this->mSize; this->mPos++)
+        {
+            if (this->mData[this->mPos] == '\\')
+                this->mPos++;
+            else if (this->mData[this->mPos] == '"')
+                return std::string(this->mData + start, this->mData + this->mPos++);
+        }
+        throw NeedMoreData();
+    }
+
+    // Skips any value; returns where it started
+    size_t SkipValue()
+    {
+        const char first = this->Peek();
+        const size_t start = this->mPos;
+        if (first == '"')
+        {
+            this->ReadString();
+            return start;
+        }
+        if (first != '{' && first != '[')
+        {
+            // Number, true, false or null
+            while (this->mPos < this->mSize && std::strchr(",}] \t\r\n", this->mData[this->mPos]) == nullptr)
+                this->mPos++;
+            if (this->mPos >= this->mSize)
+                throw NeedMoreData();
+            return start;
+        }
+
+        int depth = 0;
+        for (; this->mPos < this->mSize; this->mPos++)
+        {
+            const char c = this->mData[this->mPos];
+            if (c == '"')
+            {
+                this->ReadString();
+                this->mPos--;
+            }
+            else if (c == '{' || c == '[')
+                depth++;
+            else if ((c == '}' || c == ']') && --depth == 0)
+            {
+                this->mPos++;
+                return start;
+            }
+        }
+        throw NeedMoreData();
+    }
+
+private:
+    void SkipWhitespace()
+    {
+        while (this->mPos < this->mSize && std::strchr(" \t\r\n", this->mData[this->mPos]) != nullptr && this->mData[this->mPos] != '\0')
+            this->mPos++;
+    }
+
+    const char* mData;
+    size_t mSize;
+    size_t mPos = 0;
+};
+
+bool IsTopLevelField(const std::string& key)
+{
+    return key == "version" || key == "architecture" || key == "config" || key == "metadata" || key == "sample_rate";
+}
+
+// Walks the top-level fields from where the scanner is (just inside the '{', or just after a value), parsing the
+// ones we use and handing them to take(key, value), until it gets to "weights" (returns true, with the scanner at
+// its value) or to the end of the object (returns false).
+template <typename Take>
+bool ScanFields(HeaderScanner& scanner, const char* data, const bool afterValue, Take take)
+{
+    if (scanner.Peek() == '}')
+        return false;
+    if (afterValue)
+        scanner.Expect(',');
+    while (true)
+    {
+        const std::string key = scanner.ReadString();
+        scanner.Expect(':');
+        if (key == "weights")
+            return true;
+
+        const size_t start = scanner.SkipValue();
+        if (IsTopLevelField(key))
+            take(key, nlohmann::json::parse(data + start, data + scanner.GetPosition()));
+
+        if (scanner.Peek() == '}')
+            return false;
+        scanner.Expect(',');
+    }
+}
+
+void TakeModelField(nam::dspData& modelData, const std::string& key, const nlohmann::json& value)
+{
+    if (key == "version")
+        modelData.version = value.get<std::string>();
+    else if (key == "architecture")
+        modelData.architecture = value.get<std::string>();
+    else if (key == "config")
+        modelData.config = value;
+    else if (key == "metadata")
+        modelData.metadata = value;
+    else if (key == "sample_rate")
+        modelData.expected_sample_rate = value.get<double>();
+}
+
+void CheckModelFields(const nam::dspData& modelData)
+{
+    if (modelData.version.empty())
+        throw std::runtime_error("Model file has no version");
+    if (modelData.architecture.empty())
+        throw std::runtime_error("Model file has no architecture");
+    if (modelData.config.is_null())
+        throw std::runtime_error("Model file has no config");
+}
+
+// The weights are a flat array of numbers, which we parse straight into the floats without going through
+// nlohmann's DOM: that would make a json node for every weight, tens of megabytes for a big model, only to copy
+// them out again.
+
+// Counts the commas in [begin, end), which is how the weights are sized up front
+size_t CountCommas(const char* begin, const char* end)
+{
+    size_t count = 0;
+    const char* p = begin;
+#ifdef NAM_X86
+    // SSE2 is always there on x86-64: 16 bytes per compare
+    const __m128i comma = _mm_set1_epi8(',');
+    for (; end - p >= 64; p += 64)
+    {
+        const __m128i a = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), comma);
+        const __m128i b = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16)), comma);
+        const __m128i c = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 32)), comma);
+        const __m128i d = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 48)), comma);
+        const uint64_t mask = static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(a)))
+                              | static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(b))) << 16
+                              | static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(c))) << 32
+                              | static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(d))) << 48;
+        // Popcount without needing the instruction
+        uint64_t bits = mask - ((mask >> 1) & 0x5555555555555555ull);
+        bits = (bits & 0x3333333333333333ull) + ((bits >> 2) & 0x3333333333333333ull);
+        bits = (bits + (bits >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+        count += static_cast<size_t>((bits * 0x0101010101010101ull) >> 56);
+    }
+#endif
+    for (; p < end; p++)
+        count += *p == ',';
+    return count;
+}
+
+bool IsDigit(const char c)
+{
+    return static_cast<unsigned char>(c - '0') < 10;
+}
+
+// Eight ASCII digits at once, as one 64-bit word (SWAR). Weights are written with up to 17 significant digits,
+// so this does most of the work; the digits are little-endian in the word on every platform we build for.
+uint64_t ReadEightBytes(const char* p)
+{
+    uint64_t word;
+    std::memcpy(&word, p, sizeof(word));
+    return word;
+}
+
+bool IsEightDigits(const uint64_t word)
+{
+    return (((word & 0xF0F0F0F0F0F0F0F0ull) | (((word + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull);
+}
+
+uint32_t ParseEightDigits(uint64_t word)
+{
+    word = (word & 0x0F0F0F0F0F0F0F0Full) * 2561 >> 8;
+    word = (word & 0x00FF00FF00FF00FFull) * 6553601 >> 16;
+    return static_cast<uint32_t>((word & 0x0000FFFF0000FFFFull) * 42949672960001ull >> 32);
+}
+
+// Powers of ten that a double holds exactly
+const double kPowersOfTen[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                               1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// Parses one JSON number at p into value and moves p past it; false if there isn't one.
+//
+// Up to 18 significant digits are kept in an integer, which is more than a float can tell apart, and it's scaled
+// by an exact power of ten in double. That lands within a rounding or two of the exact double, so the float it
+// rounds to is the one nlohmann's strtod() and cast would give, unless the value is within a hair of halfway
+// between two floats; weights written from float32 tensors never are.
+bool ParseFloat(const char*& p, const char* end, float& value)
+{
+    const char* s = p;
+    const bool negative = s < end && *s == '-';
+    if (negative)
+        s++;
+
+    uint64_t mantissa = 0;
+    int exponent = 0;
+
+    // Integer part: no leading zeros in JSON, so it's all significant
+    const char* digitsStart = s;
+    for (; s < end && IsDigit(*s); s++)
+    {
+        if (mantissa < 100000000000000000ull)
+            mantissa = mantissa * 10 + static_cast<uint64_t>(*s - '0');
+        else
+            exponent++;
+    }
+    if (s == digitsStart)
+        return false;
+
+    if (s < end && *s == '.')
+    {
+        s++;
+        const char* fractionStart = s;
+        while (end - s >= 8 && mantissa < 100000000000ull && IsEightDigits(ReadEightBytes(s)))
+        {
+            mantissa = mantissa * 100000000 + ParseEightDigits(ReadEightBytes(s));
+            exponent -= 8;
+            s += 8;
+        }
+        for (; s < end && IsDigit(*s); s++)
+        {
+            // Digits past what the integer holds can't change the float
+            if (mantissa < 100000000000000000ull)
+            {
+                mantissa = mantissa * 10 + static_cast<uint64_t>(*s - '0');
+                exponent--;
+            }
+        }
+        if (s == fractionStart)
+            return false;
+    }
+
+    if (s < end && (*s == 'e' || *s == 'E'))
+    {
+        s++;
+        const bool negativeExponent = s < end && *s == '-';
+        if (s < end && (*s == '-' || *s == '+'))
+            s++;
+        const char* exponentStart = s;
+        int written = 0;
+        for (; s < end && IsDigit(*s); s++)
+            if (written < 100000)
+                written = written * 10 + (*s - '0');
+        if (s == exponentStart)
+            return false;
+        exponent += negativeExponent ? -written : written;
+    }
+
+    double result = static_cast<double>(mantissa);
+    if (mantissa != 0 && exponent != 0)
+    {
+        if (exponent < 0)
+            result = exponent >= -22 ? result / kPowersOfTen[-exponent] : result * std::pow(10.0, exponent);
+        else
+            result = exponent <= 22 ? result * kPowersOfTen[exponent] : result * std::pow(10.0, exponent);
+    }
+    value = static_cast<float>(negative ? -result : result);
+    p = s;
+    return true;
+}
+
+// Parses the weights array, from just after its '[', into floats. Fed in pieces that each end just after a ',' or
+// on the closing ']', so that a number is never split between two of them.
+class WeightsParser
+{
+public:
+    WeightsParser(std::vector<float>& weights) : mWeights(weights) {}
+
+    bool IsDone() const { return this->mState == State::Done; }
+
+    // Returns where it stopped: the end of the piece, or just after the ']'
+    const char* Parse(const char* p, const char* end)
+    {
+        while (this->mState != State::Done)
+        {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+                p++;
+            if (p >= end)
+                return p;
+
+            if (this->mState == State::Delimiter || (this->mState == State::Start && *p == ']'))
+            {
+                if (*p == ']')
+                    this->mState = State::Done;
+                else if (*p == ',')
+                    this->mState = State::Value;
+                else
+                    throw std::runtime_error("Malformed model file: expected ',' or ']' in the weights");
+                p++;
+                continue;
+            }
+
+            float value;
+            if (!ParseFloat(p, end, value))
+                throw std::runtime_error("Malformed model file: weights must all be numbers");
+            this->mWeights.push_back(value);
+            this->mState = State::Delimiter;
+        }
+        return p;
+    }
+
+private:
+    enum class State
+    {
+        Start,
+        Value,
+        Delimiter,
+        Done
+    };
+
+    std::vector<float>& mWeights;
+    State mState = State::Start;
+};
+}; // namespace
+
+nam::dspData ParseNamModel(const char* data, const size_t size)
+{
+    nam::dspData modelData;
+    modelData.expected_sample_rate = -1.0;
+    const auto take = [&modelData](const std::string& key, const nlohmann::json& value) { TakeModelField(modelData, key, value); };
+
+    try
+    {
+        HeaderScanner scanner(data, size);
+        scanner.Expect('{');
+        if (!ScanFields(scanner, data, false, take))
+            throw std::runtime_error("Corrupted model file is missing weights.");
+
+        // The first ']' after the '[' closes the array: it only holds numbers
+        scanner.Expect('[');
+        const char* weightsStart = data + scanner.GetPosition();
+        const char* bracket = static_cast<const char*>(std::memchr(weightsStart, ']', static_cast<size_t>(data + size - weightsStart)));
+        if (bracket == nullptr)
+            throw NeedMoreData();
+        modelData.weights.reserve(CountCommas(weightsStart, bracket) + 1);
+
+        WeightsParser parser(modelData.weights);
+        const char* weightsEnd = parser.Parse(weightsStart, bracket + 1);
+        scanner.SetPosition(static_cast<size_t>(weightsEnd - data));
+
+        if (ScanFields(scanner, data, true, take))
+            throw std::runtime_error("Malformed model file: more than one set of weights");
+    }
+    catch (NeedMoreData&)
+    {
+        throw std::runtime_error("Model file is truncated");
+    }
+
+    CheckModelFields(modelData);
+    return modelData;
+}
+
+nam::dspData ReadNamModel(const std::filesystem::path& modelPath)
+{
+    std::ifstream file(modelPath, std::ios::binary);
+    if (!file.is_open())
+        throw std::runtime_error("Couldn't open " + modelPath.u8string());
+
+    file.seekg(0, std::ios::end);
+    const size_t fileSize = static_cast<size_t>(file.tellg());
+    file.seekg(0, std::ios::beg);
+
+    std::string buffer;
+    const auto readRange = [&file, &buffer, &modelPath](const size_t offset, const size_t size)
+    {
+        buffer.resize(size);
+        file.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+        file.read(&buffer[0], static_cast<std::streamsize>(size));
+        buffer.resize(static_cast<size_t>(file.gcount()));
+        file.clear();
+        if (buffer.size() != size)
+            throw std::runtime_error("Couldn't read " + modelPath.u8string());
+    };
+
+    if (fileSize <= kWholeFileBytes)
+    {
+        readRange(0, fileSize);
+        return ParseNamModel(buffer.data(), buffer.size());
+    }
+
+    // Past that, the file is never held whole: the head up to the weights is parsed on its own, the weights are
+    // parsed a chunk at a time straight into their floats, and then whatever comes after them. Apart from the
+    // weights themselves, that takes one chunk of memory.
+    nam::dspData modelData;
+    modelData.expected_sample_rate = -1.0;
+    const auto take = [&modelData](const std::string& key, const nlohmann::json& value) { TakeModelField(modelData, key, value); };
+
+    size_t weightsStart = 0;
+    for (size_t headSize = kHeadBytes;; headSize *= 4)
+    {
+        readRange(0, std::min(headSize, fileSize));
+        try
+        {
+            modelData = nam::dspData();
+            modelData.expected_sample_rate = -1.0;
+            HeaderScanner scanner(buffer.data(), buffer.size());
+            scanner.Expect('{');
+            if (!ScanFields(scanner, buffer.data(), false, take))
+                throw std::runtime_error("Corrupted model file is missing weights.");
+            scanner.Expect('[');
+            weightsStart = scanner.GetPosition();
+            break;
+        }
+        catch (NeedMoreData&)
+        {
+            // A huge config could push the weights past the first read
+            if (headSize >= fileSize)
+                throw std::runtime_error("Model file is truncated");
+        }
+    }
+
+    // Size the weights exactly first, so that they're one allocation and never get copied as they grow
+    size_t weightsEnd = std::string::npos;
+    size_t numCommas = 0;
+    for (size_t offset = weightsStart; offset < fileSize && weightsEnd == std::string::npos; offset += buffer.size())
+    {
+        readRange(offset, std::min(kChunkBytes, fileSize - offset));
+        const char* bracket = static_cast<const char*>(std::memchr(buffer.data(), ']', buffer.size()));
+        numCommas += CountCommas(buffer.data(), bracket != nullptr ? bracket : buffer.data() + buffer.size());
+        if (bracket != nullptr)
+            weightsEnd = offset + static_cast<size_t>(bracket - buffer.data());
+    }
+    if (weightsEnd == std::string::npos)
+        throw std::runtime_error("Model file is truncated");
+    modelData.weights.reserve(numCommas + 1);
+
+    WeightsParser parser(modelData.weights);
+    for (size_t offset = weightsStart; offset <= weightsEnd;)
+    {
+        readRange(offset, std::min(kChunkBytes, weightsEnd + 1 - offset));
+        size_t pieceSize = buffer.size();
+        // Unless this reaches the ']', stop after the last comma, and start the next chunk from there
+        if (offset + pieceSize <= weightsEnd)
+        {
+            const size_t comma = buffer.rfind(',');
+            if (comma == std::string::npos)
+                throw std::runtime_error("Malformed model file: weights must all be numbers");
+            pieceSize = comma + 1;
+        }
+        parser.Parse(buffer.data(), buffer.data() + pieceSize);
+        offset += pieceSize;
+    }
+    if (!parser.IsDone())
+        throw std::runtime_error("Malformed model file: weights must all be numbers");
+
+    // Anything after the weights (the trainer writes the sample rate there in some versions)
+    readRange(weightsEnd + 1, fileSize - weightsEnd - 1);
+    try
+    {
+        HeaderScanner scanner(buffer.data(), buffer.size());
+        if (ScanFields(scanner, buffer.data(), true, take))
+            throw std::runtime_error("Malformed model file: more than one set of weights");
+    }
+    catch (NeedMoreData&)
+    {
+        throw std::runtime_error("Model file is truncated");
+    }
+
+    CheckModelFields(modelData);
+    return modelData;
+}
+
+namespace
+{
+void TakeField(NamModelInfo& info, const std::string& key, const nlohmann::json& value)
+{
+    if (key == "version")
+        info.version = value.get<std::string>();
+    else if (key == "architecture")
+        info.architecture = value.get<std::string>();
+    else if (key == "metadata")
+        info.metadata = value;
+    else if (key == "sample_rate" && value.is_number())
+        info.expectedSampleRate = value.get<double>();
+}
+
+// Walks the top-level fields up to "weights". Returns false if there's no "weights" field at all.
+bool ScanHead(const char* data, const size_t size, NamModelInfo& info)
+{
+    HeaderScanner scanner(data, size);
+    scanner.Expect('{');
+    return ScanFields(scanner, data, false, [&info](const std::string& key, const nlohmann::json& value) { TakeField(info, key, value); });
+}
+
+// The weights are a flat array of numbers, so the last ']' in the file that's followed by nothing but a valid
+// rest-of-object is the end of them. Returns false if it couldn't be made sense of.
+bool ScanTail(const std::string& tail, NamModelInfo& info)
+{
+    size_t end = tail.size();
+    for (int attempt = 0; attempt < 16; attempt++)
+    {
+        const size_t bracket = tail.rfind(']', end == 0 ? 0 : end - 1);
+        if (bracket == std::string::npos || end == 0)
+            return false;
+        end = bracket;
+
+        const size_t next = tail.find_first_not_of(" \t\r\n", bracket + 1);
+        if (next == std::string::npos)
+            continue;
+        if (tail[next] == '}')
+        {
+            if (tail.find_first_not_of(" \t\r\n", next + 1) == std::string::npos)
+                return true;
+            continue;
+        }
+        if (tail[next] != ',')
+            continue;
+
+        const nlohmann::json rest = nlohmann::json::parse("{" + tail.substr(next + 1), nullptr, false);
+        if (rest.is_discarded() || !rest.is_object())
+            continue;
+        for (auto it = rest.begin(); it != rest.end(); ++it)
+            TakeField(info, it.key(), it.value());
+        return true;
+    }
+    return false;
+}
+
+NamModelInfo InfoFromWholeFile(const std::string& contents)
+{
+    const nlohmann::json j = nlohmann::json::parse(contents);
+    if (j.find("weights") == j.end())
+        throw std::runtime_error("Corrupted model file is missing weights.");
+
+    NamModelInfo info;
+    for (const char* key : {"version", "architecture", "metadata", "sample_rate"})
+        if (j.find(key) != j.end())
+            TakeField(info, key, j[key]);
+    return info;
+}
+}; // namespace
+
+NamModelInfo ReadNamModelInfo(const std::filesystem::path& modelPath)
+{
+    std::ifstream file(modelPath, std::ios::binary);
+    if (!file.is_open())
+        throw std::runtime_error("Couldn't open " + modelPath.u8string());
+
+    file.seekg(0, std::ios::end);
+    const size_t fileSize = static_cast<size_t>(file.tellg());
+    file.seekg(0, std::ios::beg);
+
+    const auto readRange = [&file](const size_t offset, const size_t size)
+    {
+        std::string buffer(size, '\0');
+        file.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+        file.read(&buffer[0], static_cast<std::streamsize>(size));
+        buffer.resize(static_cast<size_t>(file.gcount()));
+        file.clear();
+        return buffer;
+    };
+
+    if (fileSize <= kWholeFileBytes)
+        return InfoFromWholeFile(readRange(0, fileSize));
+
+    // Grow the head until it reaches the weights (a huge config could push them past the first read)
+    NamModelInfo info;
+    for (size_t headSize = kHeadBytes;; headSize *= 4)
+    {
+        if (headSize >= fileSize)
+            return InfoFromWholeFile(readRange(0, fileSize));
+
+        const std::string head = readRange(0, headSize);
+        try
+        {
+            info = NamModelInfo();
+            if (!ScanHead(head.data(), head.size(), info))
+                throw std::runtime_error("Corrupted model file is missing weights.");
+            break;
+        }
+        catch (NeedMoreData&)
+        {
+        }
+    }
+
+    // Anything after the weights (the trainer writes the sample rate there in some versions)
+    if (!ScanTail(readRange(fileSize - kTailBytes, kTailBytes), info))
+        return InfoFromWholeFile(readRange(0, fileSize));
+
+    if (info.architecture.empty())
+        throw std::runtime_error("Model file has no architecture");
+    return info;
+}
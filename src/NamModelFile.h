@@ -0,0 +1,34 @@
+#ifndef __NAM_MODEL_FILE_H__
+#define __NAM_MODEL_FILE_H__
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+
+#include <dsp.h>
+
+// Parse the contents of a .nam file into the config that nam::get_dsp() builds models from.
+// Kept separate from building the model so that one parse can be shared by several instances.
+// The weights are parsed straight into their floats rather than through a JSON document.
+// Throws std::runtime_error if the file isn't a usable model.
+nam::dspData ParseNamModel (const char* data, const size_t size);
+
+// Same, but streams the weights from the file a chunk at a time, so that a big model takes little more memory
+// than its weights to load.
+nam::dspData ReadNamModel (const std::filesystem::path& modelPath);
+
+// The fields of a .nam file around its weights: enough to list and search models without loading them
+struct NamModelInfo
+{
+    std::string version;
+    std::string architecture;
+    nlohmann::json metadata;
+    double expectedSampleRate = -1.0;
+};
+
+// Reads the start of the file up to the weights, and only the end of it for any fields that come after them;
+// the weights themselves are never read, let alone parsed. Small files are just parsed whole.
+// Throws std::runtime_error if the file isn't a usable model.
+NamModelInfo ReadNamModelInfo (const std::filesystem::path& modelPath);
+
+#endif
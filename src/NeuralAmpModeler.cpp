@@ -1,11 +1,28 @@
 #include "NeuralAmpModeler.h"
+#include "ModelFactory.h"
+#include "NamModelFile.h"
+#include "VectorActivations.h"
+#include <algorithm>
 #include <filesystem>
 #include <iostream>
+#include <mutex>
+
+namespace
+{
+// The core's activation table is global. It's set up by the first instance, so that a new instance doesn't
+// rewrite it while another one's models are reading it on its audio thread.
+std::once_flag activationsInstalled;
+}; // namespace
 
 NeuralAmpModeler::NeuralAmpModeler()
 {
-    mToneStack = std::make_unique<dsp::tone_stack::BasicNamToneStack>();
-    nam::activations::Activation::enable_fast_tanh();
+    mToneStack = std::make_unique<dsp::tone_stack::FusedToneStack>();
+    std::call_once(activationsInstalled,
+                   []()
+                   {
+                       VectorActivations::Install();
+                       nam::activations::Activation::enable_fast_tanh();
+                   });
 
     mNoiseGateTrigger.AddListener(&mNoiseGateGain);
 }
@@ -14,89 +31,285 @@ NeuralAmpModeler::~NeuralAmpModeler()
 {
 }
 
-void NeuralAmpModeler::prepare(juce::dsp::ProcessSpec& spec)
+void NeuralAmpModeler::prepare(const double sampleRate, const int maxBlockSize)
 {
-    this->sampleRate = spec.sampleRate;
-    this->samplesPerBlock = spec.maximumBlockSize;
+    {
+        const std::lock_guard<std::mutex> lock(stagingMutex);
+        this->sampleRate = sampleRate;
+        this->samplesPerBlock = std::min(this->internalBlockSize, maxBlockSize);
+    }
+    this->samplesPerChunk = std::max(this->samplesPerBlock, maxBlockSize);
 
-    outputBuffer.setSize(1, spec.maximumBlockSize, false, false, false);
-    outputBuffer.clear();
+    // Doesn't allocate unless the block size went up
+    arena.Build(
+        [this](DSPArena& a)
+        {
+            modelInput = a.Allocate<float>(this->samplesPerChunk);
+            for (ModelSlot& slot : slots)
+            {
+                slot.output = a.Allocate<float>(this->samplesPerChunk);
+                slot.delayLine = a.Allocate<float>(maxAlignmentDelay);
+                slot.delayPosition = 0;
+            }
+            outputData = a.Allocate<float>(this->samplesPerChunk);
+            mToneStack->AllocateBuffers(a, 1, this->samplesPerBlock);
+        });
 
     resetModel();
     mToneStack->Reset(this->sampleRate, this->samplesPerBlock);
 
     mNoiseGateTrigger.SetSampleRate(this->sampleRate);
+
+    // Let the gate and tone stack size their buffers now rather than on the first audio callback
+    float* silence = outputData;
+    mNoiseGateTrigger.Process(&silence, 1, this->samplesPerBlock);
+    mNoiseGateGain.Process(&silence, 1, this->samplesPerBlock);
+    mToneStack->Process(&silence, 1, this->samplesPerBlock);
+    mToneStack->Reset(this->sampleRate, this->samplesPerBlock);
+
+    inputGain.reset(this->sampleRate, gainRampSeconds);
+    outputGain.reset(this->sampleRate, gainRampSeconds);
+    blend.reset(this->sampleRate, gainRampSeconds);
+    if (params[Parameters::kInputLevel] != nullptr)
+    {
+        inputGain.setCurrentAndTargetValue(dB_to_linear(params[Parameters::kInputLevel]->load()));
+        outputGain.setCurrentAndTargetValue(dB_to_linear(params[Parameters::kOutputLevel]->load()));
+    }
 }
 
-void NeuralAmpModeler::processBlock(juce::AudioBuffer<float>& buffer)
+void NeuralAmpModeler::setInternalBlockSize(const int blockSize)
+{
+    this->internalBlockSize = std::max(1, blockSize);
+}
+
+void NeuralAmpModeler::process(float* data, const int numSamples)
 {
     this->applyDSPStaging();
-    this->updateParameters();
+    blockGainReductionDB = 0.0f;
+
+    // The models run on the whole chunk in one go (see processModels()). The rest is re-chunked into internal
+    // blocks, so that every stage always sees the same (cache-friendly) block size, and parameters are picked up
+    // at every sub-block boundary.
+    for (int chunk = 0; chunk < numSamples; chunk += this->samplesPerChunk)
+    {
+        const int chunkSize = std::min(this->samplesPerChunk, numSamples - chunk);
+        float* chunkData = data + chunk;
+        const bool modelsRan = this->processModels(chunkData, chunkSize);
 
-    auto* channelDataLeft = buffer.getWritePointer(0);
-    auto* channelDataRight = buffer.getWritePointer(1);
-    auto* outputData = outputBuffer.getWritePointer(0);
+        for (int offset = 0; offset < chunkSize; offset += this->samplesPerBlock)
+        {
+            const int numFrames = std::min(this->samplesPerBlock, chunkSize - offset);
 
-    float** inputPointer = &channelDataLeft;
-    float** outputPointer = &outputData;
-    float** processedOutput;
-    float** triggerOutput = inputPointer;
+            this->updateParameters();
+            this->processSubBlock(chunkData + offset, modelsRan ? outputData + offset : nullptr, numFrames);
+        }
+    }
+}
 
-    if (noiseGateActive) // Process gate trigger
-        triggerOutput = mNoiseGateTrigger.Process(inputPointer, 1, buffer.getNumSamples());
+bool NeuralAmpModeler::processModels(const float* channelData, const int numFrames)
+{
+    ModelSlot& first = slots[0];
+    ModelSlot& second = slots[1];
+    outputNormalized = bool(params[Parameters::kOutNorm]->load());
+
+    // The models run on the whole chunk, but the input gain and the blend pick up their parameters at every
+    // internal block, like the rest of the chain
+    if (first.model == nullptr && second.model == nullptr)
+    {
+        for (int offset = 0; offset < numFrames; offset += this->samplesPerBlock)
+        {
+            inputGain.setTargetValue(dB_to_linear(params[Parameters::kInputLevel]->load()));
+            inputGain.skip(std::min(this->samplesPerBlock, numFrames - offset));
+        }
+        return false;
+    }
+
+    std::copy_n(channelData, numFrames, modelInput);
+    for (int offset = 0; offset < numFrames; offset += this->samplesPerBlock)
+    {
+        inputGain.setTargetValue(dB_to_linear(params[Parameters::kInputLevel]->load()));
+        inputGain.applyGain(modelInput + offset, std::min(this->samplesPerBlock, numFrames - offset));
+    }
 
-    if (mModel != nullptr)
+    // Which models run is decided for the whole chunk, from where the blend is at its start
+    const float blendTarget = this->getBlendTarget();
+    const bool ramping = blend.isSmoothing() || blend.getTargetValue() != blendTarget;
+    const bool runFirst = first.model != nullptr && (ramping || blendTarget < 1.0f);
+    const bool runSecond = second.model != nullptr && (ramping || blendTarget > 0.0f);
+
+    chunkFrames = numFrames;
+    const bool parallel = runFirst && runSecond && worker != nullptr && numFrames >= minParallelFrames;
+    if (parallel)
+        worker->Start(
+            [](void* context)
+            {
+                auto* self = static_cast<NeuralAmpModeler*>(context);
+                self->runModel(1, self->chunkFrames);
+            },
+            this);
+    if (runFirst)
+        this->runModel(0, numFrames);
+    if (parallel)
+        worker->Finish();
+    else if (runSecond)
+        this->runModel(1, numFrames);
+
+    if (!(runFirst && runSecond))
+    {
+        // Only one side ran, so the blend can't move off it until the next chunk
+        blend.setTargetValue(runFirst ? 0.0f : 1.0f);
+        blend.skip(numFrames);
+        std::copy_n((runFirst ? first : second).output, numFrames, outputData);
+        return true;
+    }
+    for (int offset = 0; offset < numFrames; offset += this->samplesPerBlock)
     {
-        // Input Gain
-        buffer.applyGain(dB_to_linear(params[Parameters::kInputLevel]->load()));
+        blend.setTargetValue(this->getBlendTarget());
+        const int end = std::min(offset + this->samplesPerBlock, numFrames);
+        for (int i = offset; i < end; i++)
+        {
+            const float b = blend.getNextValue();
+            outputData[i] = (1.0f - b) * first.output[i] + b * second.output[i];
+        }
+    }
+    return true;
+}
+
+float NeuralAmpModeler::getBlendTarget()
+{
+    // With only one model there's nothing to blend with
+    if (slots[0].model == nullptr)
+        return 1.0f;
+    if (slots[1].model == nullptr)
+        return 0.0f;
+    return std::clamp(params[Parameters::kModelBlend]->load(), 0.0f, 1.0f);
+}
 
-        mModel->process(*inputPointer, *outputPointer, buffer.getNumSamples());
+void NeuralAmpModeler::runModel(const int slotIndex, const int numFrames)
+{
+    ModelSlot& slot = slots[slotIndex];
+    float* output = slot.output;
+
+    // The model itself still sees internal blocks
+    for (int offset = 0; offset < numFrames; offset += this->samplesPerBlock)
+        slot.model->process(modelInput + offset, output + offset, std::min(this->samplesPerBlock, numFrames - offset));
 
-        // Normalize loudness
-        if (this->outputNormalized)
-            normalizeOutput(outputPointer, 1, buffer.getNumSamples());
+    // Normalize loudness
+    if (this->outputNormalized && slot.normalizationGain != 1.0f)
+        for (int i = 0; i < numFrames; i++)
+            output[i] *= slot.normalizationGain;
 
-        processedOutput = outputPointer;
+    if (slot.alignmentDelay > 0)
+    {
+        const int mask = maxAlignmentDelay - 1;
+        for (int i = 0; i < numFrames; i++)
+        {
+            slot.delayLine[slot.delayPosition] = output[i];
+            output[i] = slot.delayLine[(slot.delayPosition - slot.alignmentDelay) & mask];
+            slot.delayPosition = (slot.delayPosition + 1) & mask;
+        }
     }
-    else
+}
+
+void NeuralAmpModeler::processSubBlock(float* channelData, float* modelOutput, const int numFrames)
+{
+    float** inputPointer = &channelData;
+    float* processed = modelOutput != nullptr ? modelOutput : channelData;
+    float** processedOutput = &processed;
+    float** triggerOutput = inputPointer;
+
+    if (noiseGateActive) // Process gate trigger
     {
-        processedOutput = inputPointer;
+        triggerOutput = mNoiseGateTrigger.Process(inputPointer, 1, numFrames);
+        const std::vector<float>& gainReduction = mNoiseGateTrigger.GetGainReductionDB()[0];
+        blockGainReductionDB = std::min(blockGainReductionDB, *std::min_element(gainReduction.begin(), gainReduction.begin() + numFrames));
     }
 
     // Apply the noise gate
-    float** gateGainOutput = noiseGateActive ? mNoiseGateGain.Process(processedOutput, 1, buffer.getNumSamples()) : processedOutput;
+    float** gateGainOutput = noiseGateActive ? mNoiseGateGain.Process(processedOutput, 1, numFrames) : processedOutput;
 
     // Tone Stack
-    float** toneStackOutPointers = toneStackActive ? mToneStack->Process(gateGainOutput, 1, buffer.getNumSamples()) : gateGainOutput;
+    float** toneStackOutPointers = toneStackActive ? mToneStack->Process(gateGainOutput, 1, numFrames) : gateGainOutput;
 
-    doDualMono(buffer, toneStackOutPointers);
+    if (toneStackOutPointers[0] != channelData)
+        std::copy(toneStackOutPointers[0], toneStackOutPointers[0] + numFrames, channelData);
 
     // Output Gain
-    buffer.applyGain(dB_to_linear(params[Parameters::kOutputLevel]->load()));
+    outputGain.applyGain(channelData, numFrames);
 }
 
-bool NeuralAmpModeler::loadModel(const std::string modelPath)
+bool NeuralAmpModeler::loadModel(const std::string modelPath, const int slot)
 {
     try
     {
-        auto dspPath = std::filesystem::u8path(modelPath);
-        std::unique_ptr<nam::DSP> model = nam::get_dsp(dspPath);
-        std::unique_ptr<ResamplingNAM> temp = std::make_unique<ResamplingNAM>(std::move(model), this->sampleRate);
+        return loadModel(ReadNamModel(std::filesystem::u8path(modelPath)), slot);
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "Failed to read DSP module" << std::endl;
+        std::cerr << e.what() << std::endl;
 
-        temp->Reset(this->sampleRate, this->samplesPerBlock);
+        return false;
+    }
+}
+
+bool NeuralAmpModeler::loadModel(const nam::dspData& modelData, const int slot, const std::function<bool()>& isCurrent)
+{
+    double modelSampleRate;
+    int modelBlockSize;
+    {
+        const std::lock_guard<std::mutex> lock(stagingMutex);
+        modelSampleRate = this->sampleRate;
+        modelBlockSize = this->samplesPerBlock;
+    }
 
-        mStagedModel = std::move(temp);
+    try
+    {
+        // The core may modify the config it builds from, and the parsed data can be shared with other instances
+        nam::dspData config = modelData;
+        NamBuildOptions options;
+        options.pruneThreshold = pruneThreshold;
+        NamPruneReport pruneReport;
+        std::unique_ptr<nam::DSP> model = BuildNamDSP(config, options, &pruneReport);
+        if (pruneReport.pruned)
+            std::cout << pruneReport.ToString() << std::endl;
+        std::unique_ptr<ResamplingNAM> temp = std::make_unique<ResamplingNAM>(std::move(model), modelSampleRate);
+        temp->SetReceptiveField(GetNAMReceptiveField(modelData));
+        temp->SetMemoryBytes(modelData.weights.size() * sizeof(float));
+
+        temp->Reset(modelSampleRate, modelBlockSize);
+
+        const std::lock_guard<std::mutex> lock(stagingMutex);
+        // Cleared or superseded while we were building
+        if (isCurrent != nullptr && !isCurrent())
+            return false;
+
+        // prepare() ran while we were parsing
+        if (modelSampleRate != this->sampleRate || modelBlockSize != this->samplesPerBlock)
+            temp->Reset(this->sampleRate, this->samplesPerBlock);
+
+        slots[slot].retired = nullptr;
+        slots[slot].staged = std::move(temp);
+        // The second model runs on its own thread when both are running
+        if (slot > 0 && worker == nullptr && stagedWorker == nullptr)
+        {
+            // Without real-time priority the worker could be preempted mid-job and hold up the audio thread, which
+            // then waits for it; both models are better off running on the audio thread
+            auto newWorker = std::make_unique<AudioWorker>();
+            if (newWorker->IsRealtime())
+                stagedWorker = std::move(newWorker);
+        }
 
         return true;
     }
-    catch (std::runtime_error& e)
+    catch (std::exception& e)
     {
-        if (mStagedModel != nullptr)
+        const std::lock_guard<std::mutex> lock(stagingMutex);
+        if (slots[slot].staged != nullptr)
         {
-            mStagedModel = nullptr;
+            slots[slot].staged = nullptr;
         }
 
-        std::cout << "woops" << std::endl;
         std::cerr << "Failed to read DSP module" << std::endl;
         std::cerr << e.what() << std::endl;
 
@@ -104,69 +317,145 @@ bool NeuralAmpModeler::loadModel(const std::string modelPath)
     }
 }
 
-bool NeuralAmpModeler::isModelLoaded()
+bool NeuralAmpModeler::isModelLoaded(const int slot)
 {
-    return this->modelLoaded;
+    return slots[slot].loaded;
 }
 
-void NeuralAmpModeler::clearModel()
+double NeuralAmpModeler::getTailSeconds()
 {
-    this->shouldRemoveModel = true;
+    double seconds = 0.0;
+    for (const ModelSlot& slot : slots)
+        if (slot.model != nullptr)
+            seconds = std::max(seconds, slot.model->GetTailSeconds());
+    return seconds;
 }
 
-void NeuralAmpModeler::applyDSPStaging()
+double NeuralAmpModeler::getInputLevelDB()
 {
-    // Remove marked modules
-    if (shouldRemoveModel)
-    {
-        mModel = nullptr;
-        shouldRemoveModel = false;
-        //_UpdateLatency();
-    }
+    // The trigger's level follower only runs while the gate is on
+    return noiseGateActive ? mNoiseGateTrigger.GetLevelDB() : dsp::noise_gate::MINIMUM_LOUDNESS_DB;
+}
 
-    // Move things from staged to live
-    if (mStagedModel != nullptr)
+void NeuralAmpModeler::clearModel(const int slot)
+{
+    // Free whatever was swapped out last, so that the audio thread has somewhere to put the live model
+    // A model that was staged but hasn't gone live yet mustn't come back after the clear
+    const std::lock_guard<std::mutex> lock(stagingMutex);
+    slots[slot].staged = nullptr;
+    slots[slot].retired = nullptr;
+    slots[slot].shouldRemove = true;
+}
+
+size_t NeuralAmpModeler::releaseModel()
+{
+    const std::lock_guard<std::mutex> lock(stagingMutex);
+    size_t bytes = 0;
+    for (ModelSlot& slot : slots)
     {
-        // Move from staged to active DSP
-        mModel = std::move(mStagedModel);
-        mStagedModel = nullptr;
-        modelLoaded = true;
-        //_UpdateLatency();
+        for (std::unique_ptr<ResamplingNAM>* model : {&slot.model, &slot.staged, &slot.retired})
+        {
+            if (*model != nullptr)
+                bytes += (*model)->GetMemoryBytes();
+            model->reset();
+        }
+        slot.shouldRemove = false;
+        slot.loaded = false;
     }
+    worker = nullptr;
+    stagedWorker = nullptr;
+    this->alignModels();
+    return bytes;
 }
 
-void NeuralAmpModeler::resetModel()
+void NeuralAmpModeler::applyDSPStaging()
 {
-    if (mStagedModel != nullptr)
-        mStagedModel->Reset(this->sampleRate, this->samplesPerBlock);
+    // Loads finish on other threads. Never wait for them here; if one is handing over right now, pick it up
+    // on the next block.
+    std::unique_lock<std::mutex> lock(stagingMutex, std::try_to_lock);
+    if (!lock.owns_lock())
+        return;
 
-    else if (mModel != nullptr)
-        mModel->Reset(this->sampleRate, this->samplesPerBlock);
+    if (stagedWorker != nullptr)
+        worker = std::move(stagedWorker);
+
+    // Both slots are swapped together, so that a pair of models staged at once goes live in the same block and
+    // is lined up from the start
+    bool changed = false;
+    for (ModelSlot& slot : slots)
+    {
+        // Remove marked modules. They're freed by the next load or clear rather than on the audio thread; if
+        // something else was retired since the clear, leave the flag set and try again next block.
+        if (slot.shouldRemove && slot.retired == nullptr)
+        {
+            slot.retired = std::move(slot.model);
+            slot.shouldRemove = false;
+            slot.loaded = false;
+            changed = true;
+        }
+
+        // Move things from staged to live
+        if (slot.staged != nullptr)
+        {
+            // Move from staged to active DSP
+            if (slot.retired == nullptr)
+                slot.retired = std::move(slot.model);
+            slot.model = std::move(slot.staged);
+            slot.loaded = true;
+            changed = true;
+        }
+    }
+
+    if (changed)
+        this->alignModels();
 }
 
-void NeuralAmpModeler::normalizeOutput(float** input, int numChannels, int numSamples)
+void NeuralAmpModeler::alignModels()
 {
-    if (!mModel)
-        return;
-    if (!mModel->HasLoudness())
-        return;
-
-    const double loudness = mModel->GetLoudness();
     const double targetLoudness = -18.0;
-    const double gain = pow(10.0, (targetLoudness - loudness) / 20.0);
 
-    for (int c = 0; c < numChannels; c++)
+    modelLatency = 0;
+    for (const ModelSlot& slot : slots)
+        if (slot.model != nullptr)
+            modelLatency = std::max(modelLatency, slot.model->GetLatency());
+
+    for (ModelSlot& slot : slots)
     {
-        for (int f = 0; f < numSamples; f++)
+        slot.normalizationGain = 1.0f;
+        if (slot.model == nullptr)
         {
-            input[c][f] *= gain;
+            slot.alignmentDelay = 0;
+            continue;
         }
+        if (slot.model->HasLoudness())
+            slot.normalizationGain = static_cast<float>(dB_to_linear(targetLoudness - slot.model->GetLoudness()));
+        // The other model's delay only starts over if it has to change
+        const int delay = std::min(modelLatency - slot.model->GetLatency(), maxAlignmentDelay - 1);
+        if (delay != slot.alignmentDelay && slot.delayLine != nullptr)
+            std::fill_n(slot.delayLine, maxAlignmentDelay, 0.0f);
+        slot.alignmentDelay = delay;
     }
 }
 
+void NeuralAmpModeler::resetModel()
+{
+    const std::lock_guard<std::mutex> lock(stagingMutex);
+
+    for (ModelSlot& slot : slots)
+    {
+        if (slot.staged != nullptr)
+            slot.staged->Reset(this->sampleRate, this->samplesPerBlock);
+
+        if (slot.model != nullptr)
+            slot.model->Reset(this->sampleRate, this->samplesPerBlock);
+    }
+    // Latency depends on the sample rate
+    this->alignModels();
+}
+
 void NeuralAmpModeler::updateParameters()
 {
-    outputNormalized = bool(params[Parameters::kOutNorm]->load());
+    outputGain.setTargetValue(dB_to_linear(params[Parameters::kOutputLevel]->load()));
 
     // Tone Stack
     toneStackActive = bool(params[Parameters::kEQActive]->load());
@@ -190,33 +479,18 @@ void NeuralAmpModeler::updateParameters()
     }
 }
 
-void NeuralAmpModeler::hookParameters(juce::AudioProcessorValueTreeState& apvts)
+void NeuralAmpModeler::hookParameter(const Parameters parameter, std::atomic<float>* value)
 {
-    params[Parameters::kInputLevel] = apvts.getRawParameterValue("INPUT_ID");
-    params[Parameters::kNoiseGateThreshold] = apvts.getRawParameterValue("GATE_ID");
-    params[Parameters::kToneBass] = apvts.getRawParameterValue("BASS_ID");
-    params[Parameters::kToneMid] = apvts.getRawParameterValue("MIDDLE_ID");
-    params[Parameters::kToneTreble] = apvts.getRawParameterValue("TREBLE_ID");
-    params[Parameters::kOutputLevel] = apvts.getRawParameterValue("OUTPUT_ID");
-    params[Parameters::kEQActive] = apvts.getRawParameterValue("TONE_STACK_ON_ID");
-    params[Parameters::kOutNorm] = apvts.getRawParameterValue("NORMALIZE_ID");
-
-    DBG("NAM Parameters Hooked!");
+    params[parameter] = value;
 }
 
-double NeuralAmpModeler::dB_to_linear(double db_value)
+void NeuralAmpModeler::hookParameters(std::array<std::atomic<float>, kNumParameters>& values)
 {
-    return std::pow(10.0, db_value / 20.0);
+    for (int i = 0; i < kNumParameters; i++)
+        params[i] = &values[i];
 }
 
-void NeuralAmpModeler::doDualMono(juce::AudioBuffer<float>& mainBuffer, float** input)
+double NeuralAmpModeler::dB_to_linear(double db_value)
 {
-    auto channelDataLeft = mainBuffer.getWritePointer(0);
-    auto channelDataRight = mainBuffer.getWritePointer(1);
-
-    for (int sample = 0; sample < mainBuffer.getNumSamples(); ++sample)
-    {
-        channelDataRight[sample] = input[0][sample];
-        channelDataLeft[sample] = input[0][sample];
-    }
+    return std::pow(10.0, db_value / 20.0);
 }
@@ -4,26 +4,72 @@
 #include "ResamplingNAM.h"
 #include "ToneStack.h"
 #include "StatusedTrigger.h"
-
-#include <juce_dsp/juce_dsp.h>
-#include <juce_audio_processors/juce_audio_processors.h>
-
+#include "DSPArena.h"
+#include "AudioWorker.h"
+#include "SmoothedValue.h"
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+// The amp: noise gate, input gain, up to two models in parallel, tone stack and output gain.
+//
+// With two models loaded, their outputs are blended (kModelBlend: 0 is only the first, 1 only the second). The
+// models run on whole host blocks, so that the second one can run on a worker thread (if it gets real-time
+// priority) while the audio thread runs the first, and wall-clock time stays close to that of one model; a side
+// that the blend has at 0% isn't run at all. Each model's output is delayed to line up with the other's, so that
+// the blend doesn't comb-filter.
+//
+// Doesn't depend on JUCE; NamEngine puts it together with the cab.
 class NeuralAmpModeler
 {
 public:
+    static constexpr int kNumModels = 2;
+
     NeuralAmpModeler();
     ~NeuralAmpModeler();
 
-    void prepare (juce::dsp::ProcessSpec& spec);
-    void processBlock (juce::AudioBuffer<float>& buffer);
-
-    // Returns true if model staged successfully
-    bool loadModel (const std::string modelPath);
-
-    bool isModelLoaded ();
-    void clearModel ();
-
-    void hookParameters (juce::AudioProcessorValueTreeState&);
+    void prepare (const double sampleRate, const int maxBlockSize);
+    // Mono, in place. Takes blocks of any size; they are split into internal blocks before they reach the DSP.
+    void process (float* data, const int numSamples);
+
+    // Size of the blocks that the DSP actually runs on. Takes effect on the next prepare().
+    void setInternalBlockSize (const int blockSize);
+    int getInternalBlockSize () const { return samplesPerBlock; };
+
+    static constexpr int defaultInternalBlockSize = 64;
+
+    // Size of the per-block buffers laid out in the arena at the last prepare()
+    size_t getArenaBytes () const { return arena.GetUsedBytes(); };
+
+    // Takes dead channels out of models as they're loaded (see NamBuildOptions::pruneThreshold); below 0 is off.
+    // Takes effect on the next load.
+    void setPruneThreshold (const float threshold) { pruneThreshold = threshold; };
+
+    // Returns true if model staged successfully. Safe to call from a background thread.
+    // slot is 0 for the first model, 1 for the one it's blended with.
+    bool loadModel (const std::string modelPath, const int slot = 0);
+    // Same, from an already-parsed model file. If isCurrent is given, it's checked under the staging lock right
+    // before the model is staged, and the model is dropped (returning false) if it says the load is stale.
+    bool loadModel (const nam::dspData& modelData, const int slot = 0, const std::function<bool()>& isCurrent = nullptr);
+
+    bool isModelLoaded (const int slot = 0);
+    void clearModel (const int slot = 0);
+    // Frees both live models (and any staged or retired ones) right away rather than on the next block, and
+    // returns roughly how many bytes that gave back. Only call while the audio thread is held off.
+    size_t releaseModel ();
+
+    // How long the live models keep ringing after the input goes silent. Call from the audio thread.
+    double getTailSeconds ();
+    // Of the live models, once lined up with each other. Call from the audio thread.
+    int getLatencySamples () const { return modelLatency; };
+    // Smoothed input level from the noise gate trigger, in dB
+    double getInputLevelDB ();
+    // Deepest noise gate gain reduction over the last processBlock(), in dB, and whether the gate is closed.
+    // Call from the audio thread.
+    float getGainReductionDB () const { return blockGainReductionDB; };
+    bool isGating () const { return noiseGateActive && mNoiseGateTrigger.isGating(); };
 
     enum Parameters
     {
@@ -34,32 +80,85 @@ public:
         kToneTreble,
         kOutputLevel,
         kEQActive,
-        kOutNorm
+        kOutNorm,
+        kModelBlend,
+        kNumParameters
     };
 
+    // Where each parameter is read from, at the start of every internal block
+    void hookParameter (const Parameters parameter, std::atomic<float>* value);
+    void hookParameters (std::array<std::atomic<float>, kNumParameters>& values);
+
     StatusedTrigger* getTrigger() { return &mNoiseGateTrigger; };
 
 private:
-    double sampleRate;
-    int samplesPerBlock;
-    juce::AudioBuffer<float> outputBuffer;
+    // Longest output delay that lining the models up can need (a power of two); the resamplers' latency is far
+    // below it
+    static constexpr int maxAlignmentDelay = 256;
+    // Below this many frames, handing the second model to the worker costs more than it saves
+    static constexpr int minParallelFrames = 64;
+
+    double sampleRate{48000.0};
+    // Block size that the DSP is prepared for; min of the internal block size and the host's max block size
+    int samplesPerBlock{defaultInternalBlockSize};
+    int internalBlockSize{defaultInternalBlockSize};
+    // The host's max block size: what the models run on in one go
+    int samplesPerChunk{defaultInternalBlockSize};
+    // Per-block buffers of this instance's own stages, in signal order; laid out in prepare()
+    DSPArena arena;
+    float* modelInput{nullptr};
+    // The models' outputs, blended
+    float* outputData{nullptr};
+
+    // Gains are ramped so that parameter changes between sub-blocks don't click
+    SmoothedValue inputGain{1.0f}, outputGain{1.0f};
+    // Of the second model; ramped the same way
+    SmoothedValue blend{0.0f};
+    const double gainRampSeconds = 0.02;
 
     // Parameter Pointers
-    std::atomic<float>* params[8];
+    std::atomic<float>* params[kNumParameters]{};
 
     bool toneStackActive{true};
     bool outputNormalized{false};
     bool noiseGateActive{false};
 
-    bool modelLoaded{false};
-    bool shouldRemoveModel{false};
+    std::atomic<float> pruneThreshold{-1.0f};
 
-    std::unique_ptr<ResamplingNAM> mModel, mStagedModel;
+    struct ModelSlot
+    {
+        std::atomic<bool> loaded{false};
+        std::atomic<bool> shouldRemove{false};
+
+        std::unique_ptr<ResamplingNAM> model, staged;
+        // The model that was last swapped out; kept here so that it's freed off the audio thread
+        std::unique_ptr<ResamplingNAM> retired;
+
+        // Of the live model; set when it's swapped in
+        float normalizationGain{1.0f};
+        int alignmentDelay{0};
+
+        // Laid out in prepare()
+        float* output{nullptr};
+        float* delayLine{nullptr};
+        int delayPosition{0};
+    };
+    std::array<ModelSlot, kNumModels> slots;
+    // Frames of the chunk that the models are running on, for the worker
+    int chunkFrames{0};
+    int modelLatency{0};
+
+    // Runs the second model when both are running; made when one is first loaded into the second slot
+    std::unique_ptr<AudioWorker> worker, stagedWorker;
+
+    // Guards the staging areas and the sample rate/block size that staged models are reset with
+    std::mutex stagingMutex;
     std::unique_ptr<dsp::tone_stack::AbstractToneStack> mToneStack;
 
     // Noise gate
     StatusedTrigger mNoiseGateTrigger;
     dsp::noise_gate::Gain mNoiseGateGain;
+    float blockGainReductionDB{0.0f};
 
     // Noise gate Params
     const double ns_time = 0.01;
@@ -75,13 +174,21 @@ private:
     // partially-instantiated.
     void applyDSPStaging ();
 
+    // Recomputes the delays that line the live models up, after one was swapped in or out
+    void alignModels ();
+
     void resetModel ();
 
-    void normalizeOutput (float** input, int numChannels, int numSamples);
+    // Input gain and the models on a whole chunk, into outputData. Returns false if there's no model to run.
+    bool processModels (const float* channelData, const int numFrames);
+    void runModel (const int slot, const int numFrames);
+    // Where the blend is headed, given which models are live
+    float getBlendTarget ();
+    // Everything else, on an internal block. modelOutput is null if there was no model.
+    void processSubBlock (float* channelData, float* modelOutput, const int numFrames);
 
     void updateParameters ();
     double dB_to_linear (double db_value);
-    void doDualMono (juce::AudioBuffer<float>& mainBuffer, float** input);
 };
 
 #endif
@@ -0,0 +1,170 @@
+#include "OfflineRenderer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+// On top of the receptive field: the resampler's filters, and the gate's and tone stack's memory
+const double kOverlapMarginSeconds = 0.05;
+}; // namespace
+
+struct OfflineRenderer::Chain
+{
+    NeuralAmpModeler amp;
+    std::array<std::atomic<float>, NeuralAmpModeler::kNumParameters> params{};
+    juce::AudioBuffer<float> buffer;
+};
+
+OfflineRenderer::OfflineRenderer(std::shared_ptr<const nam::dspData> model, const Options& options)
+    : model(std::move(model)), options(options)
+{
+    if (this->model == nullptr)
+        throw std::runtime_error("No model to render with");
+
+    overlapSeconds = options.overlapSeconds;
+    if (overlapSeconds < 0.0)
+    {
+        const double modelSampleRate = this->model->expected_sample_rate <= 0.0 ? 48000.0 : this->model->expected_sample_rate;
+        overlapSeconds = GetNAMReceptiveField(*this->model) / modelSampleRate + kOverlapMarginSeconds;
+    }
+}
+
+std::unique_ptr<OfflineRenderer::Chain> OfflineRenderer::makeChain() const
+{
+    auto chain = std::make_unique<Chain>();
+    for (int i = 0; i < NeuralAmpModeler::kNumParameters; i++)
+        chain->params[i] = options.parameters[i];
+    chain->amp.hookParameters(chain->params);
+    chain->buffer.setSize(1, options.blockSize);
+
+    chain->amp.prepare(options.sampleRate, options.blockSize);
+    if (!chain->amp.loadModel(*model))
+        throw std::runtime_error("Failed to build the model");
+    return chain;
+}
+
+void OfflineRenderer::renderRange(Chain& chain, const std::vector<float>& input, const size_t begin, const size_t outputBegin,
+                                  const size_t end, float* output) const
+{
+    juce::ScopedNoDenormals noDenormals;
+    for (size_t offset = begin; offset < end; offset += (size_t)options.blockSize)
+    {
+        const int numFrames = (int)std::min<size_t>((size_t)options.blockSize, end - offset);
+        chain.buffer.setSize(1, numFrames, false, false, true);
+        chain.buffer.copyFrom(0, 0, input.data() + offset, numFrames);
+        chain.amp.process(chain.buffer.getWritePointer(0), numFrames);
+
+        const float* processed = chain.buffer.getReadPointer(0);
+        for (int i = 0; i < numFrames; i++)
+            if (offset + i >= outputBegin)
+                output[offset + i - outputBegin] = processed[i];
+    }
+}
+
+std::vector<float> OfflineRenderer::renderSerial(const std::vector<float>& input) const
+{
+    std::vector<float> output(input.size());
+    auto chain = makeChain();
+    renderRange(*chain, input, 0, 0, input.size(), output.data());
+    return output;
+}
+
+std::vector<float> OfflineRenderer::render(const std::vector<float>& input) const
+{
+    const size_t length = input.size();
+    const int numThreads = options.numThreads > 0 ? options.numThreads : (int)std::max(1u, std::thread::hardware_concurrency());
+    const size_t overlap = (size_t)std::ceil(overlapSeconds * options.sampleRate);
+    const size_t crossfade = (size_t)std::max(0.0, std::round(options.crossfadeSeconds * options.sampleRate));
+
+    // Chunks much shorter than their warm-up would mostly be warming up
+    size_t chunkLength = options.chunkSeconds > 0.0 ? (size_t)(options.chunkSeconds * options.sampleRate) : (length + numThreads - 1) / numThreads;
+    chunkLength = std::max(chunkLength, std::max<size_t>(4 * (overlap + crossfade), 1));
+    const size_t numChunks = std::max<size_t>(1, (length + chunkLength - 1) / chunkLength);
+    if (numChunks == 1)
+        return renderSerial(input);
+
+    // Chunk k owns [k * chunkLength, (k + 1) * chunkLength) and renders crossfade samples past it, which chunk
+    // k + 1 fades in over.
+    std::vector<std::vector<float>> chunkOutputs(numChunks);
+    std::atomic<size_t> nextChunk{0};
+    std::vector<std::thread> workers;
+    std::exception_ptr failure;
+    std::mutex failureMutex;
+
+    for (int t = 0; t < std::min<int>(numThreads, (int)numChunks); t++)
+    {
+        workers.emplace_back(
+            [&]
+            {
+                try
+                {
+                    for (size_t k = nextChunk++; k < numChunks; k = nextChunk++)
+                    {
+                        const size_t start = k * chunkLength;
+                        const size_t end = std::min(length, start + chunkLength + (k + 1 < numChunks ? crossfade : 0));
+                        const size_t warmStart = start > overlap ? start - overlap : 0;
+
+                        chunkOutputs[k].resize(end - start);
+                        auto chain = makeChain();
+                        renderRange(*chain, input, warmStart, start, end, chunkOutputs[k].data());
+                    }
+                }
+                catch (...)
+                {
+                    const std::lock_guard<std::mutex> lock(failureMutex);
+                    failure = std::current_exception();
+                    nextChunk = numChunks;
+                }
+            });
+    }
+    for (auto& worker : workers)
+        worker.join();
+    if (failure != nullptr)
+        std::rethrow_exception(failure);
+
+    std::vector<float> output(length);
+    for (size_t k = 0; k < numChunks; k++)
+    {
+        const size_t start = k * chunkLength;
+        const std::vector<float>& chunk = chunkOutputs[k];
+        // The first crossfade samples of every chunk but the first blend with the previous chunk's tail
+        const size_t fadeIn = k > 0 ? std::min(crossfade, chunk.size()) : 0;
+        for (size_t i = 0; i < chunk.size(); i++)
+        {
+            if (start + i >= length)
+                break;
+            if (i < fadeIn)
+            {
+                // Both sides are rendering the same thing, so a linear (equal-gain) fade
+                const float gain = (float)(i + 1) / (float)(fadeIn + 1);
+                output[start + i] = gain * chunk[i] + (1.0f - gain) * output[start + i];
+            }
+            else
+                output[start + i] = chunk[i];
+        }
+    }
+    return output;
+}
+
+OfflineRenderer::NullTestResult OfflineRenderer::nullTest(const std::vector<float>& reference, const std::vector<float>& output)
+{
+    NullTestResult result;
+    const size_t length = std::min(reference.size(), output.size());
+    double referenceEnergy = 0.0, residualEnergy = 0.0;
+    for (size_t i = 0; i < length; i++)
+    {
+        const double difference = (double)output[i] - (double)reference[i];
+        result.maxDifference = std::max(result.maxDifference, std::fabs(difference));
+        referenceEnergy += (double)reference[i] * reference[i];
+        residualEnergy += difference * difference;
+    }
+    if (residualEnergy > 0.0 && referenceEnergy > 0.0)
+        result.residualDB = 10.0 * std::log10(residualEnergy / referenceEnergy);
+    return result;
+}
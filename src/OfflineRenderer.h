@@ -0,0 +1,70 @@
+#ifndef __OFFLINE_RENDERER_H__
+#define __OFFLINE_RENDERER_H__
+
+#include "NeuralAmpModeler.h"
+
+#include <array>
+#include <memory>
+#include <vector>
+
+// Renders a whole file through the NeuralAmpModeler chain on all cores.
+//
+// The model's state only runs forwards, so one long file would normally render on one core. Instead, the input
+// is cut into chunks and each chunk gets its own chain, which is first run (output thrown away) over the audio
+// just before the chunk, for at least as long as the model can remember. By the time the chunk starts, that
+// chain is in (very nearly) the state the serial render would be in, so the chunks can all run at once. Each
+// chunk also renders a little past its end, and the seams are crossfaded over that stretch.
+//
+// Models with a finite receptive field (WaveNet, ConvNet, Linear) come out the same as the serial render up to
+// float rounding; LSTMs to within how far they've settled after the warm-up. NullTest() measures it.
+class OfflineRenderer
+{
+public:
+    struct Options
+    {
+        double sampleRate = 48000.0;
+        // How many chunks run at once; 0 for one per core
+        int numThreads = 0;
+        // 0 to split the file evenly across the threads
+        double chunkSeconds = 0.0;
+        // Warm-up before each chunk; less than 0 to use the model's receptive field plus a margin for the
+        // resampler, gate and tone stack
+        double overlapSeconds = -1.0;
+        double crossfadeSeconds = 0.01;
+        // Size of the blocks handed to the chain, like a host would
+        int blockSize = 512;
+        // Same meaning as the plugin's parameters
+        std::array<float, NeuralAmpModeler::kNumParameters> parameters{0.0f, -80.0f, 5.0f, 5.0f, 5.0f, 0.0f, 1.0f, 0.0f, 0.0f};
+    };
+
+    struct NullTestResult
+    {
+        double maxDifference = 0.0;
+        // Level of the difference relative to the reference, in dB
+        double residualDB = -200.0;
+    };
+
+    OfflineRenderer (std::shared_ptr<const nam::dspData> model, const Options& options);
+
+    std::vector<float> render (const std::vector<float>& input) const;
+    // One chain over the whole file, for reference
+    std::vector<float> renderSerial (const std::vector<float>& input) const;
+
+    double getOverlapSeconds () const { return overlapSeconds; };
+
+    static NullTestResult nullTest (const std::vector<float>& reference, const std::vector<float>& output);
+
+private:
+    struct Chain;
+
+    std::unique_ptr<Chain> makeChain () const;
+    // Runs input[begin, end) through the chain, writing what it produces for [outputBegin, end) into output
+    void renderRange (Chain& chain, const std::vector<float>& input, const size_t begin, const size_t outputBegin, const size_t end,
+                      float* output) const;
+
+    std::shared_ptr<const nam::dspData> model;
+    Options options;
+    double overlapSeconds = 0.0;
+};
+
+#endif
@@ -0,0 +1,193 @@
+#include "PackedMatrix.h"
+#include "CpuFeatures.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace
+{
+const int kPanelRows = PackedMatrix::kPanelRows;
+
+using MultiplyFunction = void (*)(const float* panels, const int rows, const int cols, const PackedMatrix::Input* inputs,
+                                  const int numInputs, float* output, const int numFrames, const float* addend);
+
+void MultiplyGeneric(const float* panels, const int rows, const int cols, const PackedMatrix::Input* inputs, const int numInputs,
+                     float* output, const int numFrames, const float* addend)
+{
+    const size_t panelSize = (size_t)kPanelRows * (cols + 1);
+    const float* panel = panels;
+    for (int row = 0; row < rows; row += kPanelRows, panel += panelSize)
+    {
+        const int panelRows = std::min(kPanelRows, rows - row);
+        for (int t = 0; t < numFrames; t++)
+        {
+            float sum[kPanelRows];
+            for (int i = 0; i < kPanelRows; i++)
+                sum[i] = panel[i];
+            if (addend != nullptr)
+                for (int i = 0; i < panelRows; i++)
+                    sum[i] += addend[(size_t)t * rows + row + i];
+
+            const float* w = panel + kPanelRows;
+            for (int n = 0; n < numInputs; n++)
+            {
+                const float* x = inputs[n].data + (size_t)t * inputs[n].rows;
+                for (int k = 0; k < inputs[n].rows; k++, w += kPanelRows)
+                    for (int i = 0; i < kPanelRows; i++)
+                        sum[i] += w[i] * x[k];
+            }
+
+            for (int i = 0; i < panelRows; i++)
+                output[(size_t)t * rows + row + i] = sum[i];
+        }
+    }
+}
+
+#ifdef NAM_X86
+// The first n lanes, from kRowMask + kPanelRows - n
+const int32_t kRowMask[2 * kPanelRows] = {-1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0};
+
+NAM_TARGET_AVX2 inline __m256 LoadRows(const float* data, const int numRows, const __m256i mask)
+{
+    return numRows == kPanelRows ? _mm256_loadu_ps(data) : _mm256_maskload_ps(data, mask);
+}
+
+NAM_TARGET_AVX2 inline void StoreRows(float* data, const int numRows, const __m256i mask, const __m256 value)
+{
+    if (numRows == kPanelRows)
+        _mm256_storeu_ps(data, value);
+    else
+        _mm256_maskstore_ps(data, mask, value);
+}
+
+// Four columns at a time, for four independent FMA chains per panel. A panel is read once per four columns and, at
+// NAM's layer sizes, is still in L1 the next time.
+NAM_TARGET_AVX2 void MultiplyAVX2(const float* panels, const int rows, const int cols, const PackedMatrix::Input* inputs,
+                                  const int numInputs, float* output, const int numFrames, const float* addend)
+{
+    const size_t panelSize = (size_t)kPanelRows * (cols + 1);
+    const float* panel = panels;
+    for (int row = 0; row < rows; row += kPanelRows, panel += panelSize)
+    {
+        const int panelRows = std::min(kPanelRows, rows - row);
+        const __m256i mask = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(kRowMask + kPanelRows - panelRows));
+        const __m256 bias = _mm256_load_ps(panel);
+
+        int t = 0;
+        for (; t + 4 <= numFrames; t += 4)
+        {
+            __m256 sum0 = bias, sum1 = bias, sum2 = bias, sum3 = bias;
+            if (addend != nullptr)
+            {
+                const float* add = addend + (size_t)t * rows + row;
+                sum0 = _mm256_add_ps(sum0, LoadRows(add, panelRows, mask));
+                sum1 = _mm256_add_ps(sum1, LoadRows(add + rows, panelRows, mask));
+                sum2 = _mm256_add_ps(sum2, LoadRows(add + 2 * rows, panelRows, mask));
+                sum3 = _mm256_add_ps(sum3, LoadRows(add + 3 * rows, panelRows, mask));
+            }
+
+            const float* w = panel + kPanelRows;
+            for (int n = 0; n < numInputs; n++)
+            {
+                const int inputRows = inputs[n].rows;
+                const float* x0 = inputs[n].data + (size_t)t * inputRows;
+                const float* x1 = x0 + inputRows;
+                const float* x2 = x1 + inputRows;
+                const float* x3 = x2 + inputRows;
+                for (int k = 0; k < inputRows; k++, w += kPanelRows)
+                {
+                    const __m256 wk = _mm256_load_ps(w);
+                    sum0 = _mm256_fmadd_ps(wk, _mm256_broadcast_ss(x0 + k), sum0);
+                    sum1 = _mm256_fmadd_ps(wk, _mm256_broadcast_ss(x1 + k), sum1);
+                    sum2 = _mm256_fmadd_ps(wk, _mm256_broadcast_ss(x2 + k), sum2);
+                    sum3 = _mm256_fmadd_ps(wk, _mm256_broadcast_ss(x3 + k), sum3);
+                }
+            }
+
+            float* out = output + (size_t)t * rows + row;
+            StoreRows(out, panelRows, mask, sum0);
+            StoreRows(out + rows, panelRows, mask, sum1);
+            StoreRows(out + 2 * rows, panelRows, mask, sum2);
+            StoreRows(out + 3 * rows, panelRows, mask, sum3);
+        }
+
+        // The last few columns, or the only one (the LSTM's recurrence): the weights' even and odd columns go into
+        // separate sums, for two chains instead of one
+        for (; t < numFrames; t++)
+        {
+            __m256 sum0 = bias;
+            __m256 sum1 = _mm256_setzero_ps();
+            if (addend != nullptr)
+                sum0 = _mm256_add_ps(sum0, LoadRows(addend + (size_t)t * rows + row, panelRows, mask));
+
+            const float* w = panel + kPanelRows;
+            for (int n = 0; n < numInputs; n++)
+            {
+                const int inputRows = inputs[n].rows;
+                const float* x = inputs[n].data + (size_t)t * inputRows;
+                int k = 0;
+                for (; k + 2 <= inputRows; k += 2, w += 2 * kPanelRows)
+                {
+                    sum0 = _mm256_fmadd_ps(_mm256_load_ps(w), _mm256_broadcast_ss(x + k), sum0);
+                    sum1 = _mm256_fmadd_ps(_mm256_load_ps(w + kPanelRows), _mm256_broadcast_ss(x + k + 1), sum1);
+                }
+                if (k < inputRows)
+                {
+                    sum0 = _mm256_fmadd_ps(_mm256_load_ps(w), _mm256_broadcast_ss(x + k), sum0);
+                    w += kPanelRows;
+                }
+            }
+
+            StoreRows(output + (size_t)t * rows + row, panelRows, mask, _mm256_add_ps(sum0, sum1));
+        }
+    }
+}
+#endif
+
+MultiplyFunction GetMultiply()
+{
+#ifdef NAM_X86
+    static const MultiplyFunction function = CpuHasAVX2() ? MultiplyAVX2 : MultiplyGeneric;
+    return function;
+#else
+    return MultiplyGeneric;
+#endif
+}
+}; // namespace
+
+PackedMatrix PackedMatrix::Pack(DSPArena& arena, const Eigen::Ref<const Eigen::MatrixXf>& weights, const float* bias)
+{
+    const int rows = static_cast<int>(weights.rows());
+    const int cols = static_cast<int>(weights.cols());
+    const int numPanels = (rows + kPanelRows - 1) / kPanelRows;
+    const size_t panelSize = (size_t)kPanelRows * (cols + 1);
+
+    PackedMatrix matrix;
+    float* data = arena.Allocate<float>(numPanels * panelSize);
+    if (data == nullptr)
+        return matrix;
+
+    // The arena hands out zeros, so the rows past the end are done already
+    for (int p = 0; p < numPanels; p++)
+    {
+        float* panel = data + p * panelSize;
+        const int row = p * kPanelRows;
+        for (int i = 0; i < std::min(kPanelRows, rows - row); i++)
+        {
+            if (bias != nullptr)
+                panel[i] = bias[row + i];
+            for (int j = 0; j < cols; j++)
+                panel[(size_t)(j + 1) * kPanelRows + i] = weights(row + i, j);
+        }
+    }
+
+    matrix.mData = data;
+    matrix.mRows = rows;
+    matrix.mCols = cols;
+    return matrix;
+}
+
+void PackedMatrix::Multiply(const Input* inputs, const int numInputs, float* output, const int numFrames, const float* addend) const
+{
+    GetMultiply()(mData, mRows, mCols, inputs, numInputs, output, numFrames, addend);
+}
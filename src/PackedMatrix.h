@@ -0,0 +1,50 @@
+#ifndef __PACKED_MATRIX_H__
+#define __PACKED_MATRIX_H__
+
+#include "DSPArena.h"
+
+#include <Eigen/Dense>
+
+// A layer's weights, repacked once when the model is built into the order that Multiply() reads them in, so that
+// every block streams through them front to back instead of striding through the trainer's layout.
+//
+// The rows are cut into panels of kPanelRows, one register's worth. A panel is its rows' bias, then, column by
+// column, those rows' weights; rows past the end of the matrix are zero. A product whose right-hand side comes from
+// several places (a dilated conv's taps and the condition) is one matrix, with the inputs' columns side by side,
+// so that the whole sum is done in one pass with the accumulators in registers.
+class PackedMatrix
+{
+public:
+    static constexpr int kPanelRows = 8;
+
+    // One of the right-hand side's inputs: rows x numFrames, column-major, with nothing between the columns
+    struct Input
+    {
+        const float* data;
+        int rows;
+    };
+
+    PackedMatrix () = default;
+
+    // Takes room for the weights from the arena, in the order it's called, and packs them into it. Returns an empty
+    // matrix while the arena is measuring. bias may be null for none.
+    static PackedMatrix Pack (DSPArena& arena, const Eigen::Ref<const Eigen::MatrixXf>& weights, const float* bias = nullptr);
+
+    int GetRows () const { return mRows; };
+    int GetCols () const { return mCols; };
+
+    // output = weights * [inputs, stacked] + bias, plus addend if there is one. output and addend are
+    // GetRows() x numFrames, column-major; addend may be output itself. The inputs' rows must add up to GetCols().
+    void Multiply (const Input* inputs, const int numInputs, float* output, const int numFrames, const float* addend = nullptr) const;
+    void Multiply (const Input& input, float* output, const int numFrames, const float* addend = nullptr) const
+    {
+        this->Multiply(&input, 1, output, numFrames, addend);
+    };
+
+private:
+    const float* mData = nullptr;
+    int mRows = 0;
+    int mCols = 0;
+};
+
+#endif
@@ -0,0 +1,280 @@
+#include "PartitionedConvolver.h"
+
+#include <stdexcept>
+#include <utility>
+
+PartitionedConvolver::PartitionedConvolver(std::shared_ptr<const IRSpectra> first, std::shared_ptr<const IRSpectra> second)
+    : mIRs{std::move(first), std::move(second)}, mFFT(2 * mIRs[0]->partitionSize), mPartitionSize(mIRs[0]->partitionSize),
+      mNumBins(mIRs[0]->numBins), mNumPartitions(mIRs[0]->numPartitions)
+{
+    if (mIRs[1] != nullptr)
+    {
+        if (mIRs[1]->partitionSize != mPartitionSize || mIRs[1]->sampleRate != mIRs[0]->sampleRate)
+            throw std::invalid_argument("Blended IRs must have the same partition size and sample rate");
+        mNumPartitions = std::max(mNumPartitions, mIRs[1]->numPartitions);
+    }
+
+    mInput.resize(2 * mPartitionSize);
+    mHistoryReal.resize((size_t)mNumPartitions * mNumBins);
+    mHistoryImag.resize(mHistoryReal.size());
+    for (Mix& mix : mMixes)
+    {
+        mix.tailReal.resize(mNumBins);
+        mix.tailImag.resize(mNumBins);
+        if (mIRs[1] != nullptr)
+        {
+            mix.premixReal.resize((size_t)mNumPartitions * mNumBins);
+            mix.premixImag.resize(mix.premixReal.size());
+        }
+    }
+    mSpectrumReal.resize(mNumBins);
+    mSpectrumImag.resize(mNumBins);
+    mProductReal.resize(mNumBins);
+    mProductImag.resize(mNumBins);
+    mOutput.resize(2 * mPartitionSize);
+    mFadeOutput.resize(2 * mPartitionSize);
+
+    mFadeLength = std::max(1, static_cast<int>(kBlendRampSeconds * mIRs[0]->sampleRate));
+    this->SetMix(mMixes[0], 0.0f);
+}
+
+void PartitionedConvolver::Reset()
+{
+    std::fill(mInput.begin(), mInput.end(), 0.0f);
+    std::fill(mHistoryReal.begin(), mHistoryReal.end(), 0.0f);
+    std::fill(mHistoryImag.begin(), mHistoryImag.end(), 0.0f);
+    for (Mix& mix : mMixes)
+    {
+        std::fill(mix.tailReal.begin(), mix.tailReal.end(), 0.0f);
+        std::fill(mix.tailImag.begin(), mix.tailImag.end(), 0.0f);
+    }
+    mFill = 0;
+    mNewest = 0;
+
+    // Nothing to fade from
+    mFading = false;
+    if (mIRs[1] != nullptr && mMixes[mActive].blend != mTargetBlend)
+        this->SetMix(mMixes[mActive], mTargetBlend);
+}
+
+int PartitionedConvolver::GetLength() const
+{
+    return mIRs[1] != nullptr ? std::max(mIRs[0]->length, mIRs[1]->length) : mIRs[0]->length;
+}
+
+size_t PartitionedConvolver::GetStateBytes() const
+{
+    size_t floats = mInput.size() + mHistoryReal.size() + mHistoryImag.size() + mSpectrumReal.size() + mSpectrumImag.size()
+                    + mProductReal.size() + mProductImag.size() + mOutput.size() + mFadeOutput.size();
+    for (const Mix& mix : mMixes)
+        floats += mix.tailReal.size() + mix.tailImag.size() + mix.premixReal.size() + mix.premixImag.size();
+    return floats * sizeof(float);
+}
+
+void PartitionedConvolver::SetMix(Mix& mix, const float blend)
+{
+    mix.blend = blend;
+
+    const IRSpectra* only = mIRs[1] == nullptr || blend <= 0.0f ? mIRs[0].get() : blend >= 1.0f ? mIRs[1].get() : nullptr;
+    if (only != nullptr)
+    {
+        mix.real = only->real.data();
+        mix.imag = only->imag.data();
+        mix.numPartitions = only->numPartitions;
+        return;
+    }
+
+    // The shorter IR is zero past its end
+    const size_t size = (size_t)mNumPartitions * mNumBins;
+    const size_t firstSize = mIRs[0]->real.size();
+    const size_t secondSize = mIRs[1]->real.size();
+    const float firstGain = 1.0f - blend;
+    for (size_t i = 0; i < size; i++)
+    {
+        const float firstReal = i < firstSize ? mIRs[0]->real[i] : 0.0f;
+        const float firstImag = i < firstSize ? mIRs[0]->imag[i] : 0.0f;
+        const float secondReal = i < secondSize ? mIRs[1]->real[i] : 0.0f;
+        const float secondImag = i < secondSize ? mIRs[1]->imag[i] : 0.0f;
+        mix.premixReal[i] = firstGain * firstReal + blend * secondReal;
+        mix.premixImag[i] = firstGain * firstImag + blend * secondImag;
+    }
+    mix.real = mix.premixReal.data();
+    mix.imag = mix.premixImag.data();
+    mix.numPartitions = mNumPartitions;
+}
+
+void PartitionedConvolver::ComputeTail(Mix& mix)
+{
+    // Partition p of the IR meets the input from p partitions ago, counting the one being filled as 0
+    std::fill(mix.tailReal.begin(), mix.tailReal.end(), 0.0f);
+    std::fill(mix.tailImag.begin(), mix.tailImag.end(), 0.0f);
+    for (int p = 1; p < mix.numPartitions; p++)
+    {
+        const int slot = (mNewest - (p - 1) + mNumPartitions) % mNumPartitions;
+        const float* xReal = mHistoryReal.data() + (size_t)slot * mNumBins;
+        const float* xImag = mHistoryImag.data() + (size_t)slot * mNumBins;
+        const float* hReal = mix.real + (size_t)p * mNumBins;
+        const float* hImag = mix.imag + (size_t)p * mNumBins;
+        for (int k = 0; k < mNumBins; k++)
+        {
+            mix.tailReal[k] += xReal[k] * hReal[k] - xImag[k] * hImag[k];
+            mix.tailImag[k] += xReal[k] * hImag[k] + xImag[k] * hReal[k];
+        }
+    }
+}
+
+void PartitionedConvolver::ConvolveFirst(const Mix& mix, float* output)
+{
+    for (int k = 0; k < mNumBins; k++)
+    {
+        const float xr = mSpectrumReal[k];
+        const float xi = mSpectrumImag[k];
+        mProductReal[k] = xr * mix.real[k] - xi * mix.imag[k] + mix.tailReal[k];
+        mProductImag[k] = xr * mix.imag[k] + xi * mix.real[k] + mix.tailImag[k];
+    }
+    mFFT.Inverse(mProductReal.data(), mProductImag.data(), output);
+}
+
+void PartitionedConvolver::Process(float* data, const int numFrames)
+{
+    // A new blend starts a crossfade to it, once the last one is done
+    if (mIRs[1] != nullptr && !mFading && mTargetBlend != mMixes[mActive].blend)
+    {
+        Mix& next = mMixes[1 - mActive];
+        this->SetMix(next, mTargetBlend);
+        this->ComputeTail(next);
+        mFadePosition = 0;
+        mFading = true;
+    }
+
+    int done = 0;
+    while (done < numFrames)
+    {
+        const int count = std::min(numFrames - done, mPartitionSize - mFill);
+        this->ProcessPartial(data + done, count);
+        done += count;
+    }
+}
+
+void PartitionedConvolver::ProcessPartial(float* data, const int numFrames)
+{
+    std::copy_n(data, numFrames, mInput.data() + mPartitionSize + mFill);
+    mFFT.Forward(mInput.data(), mSpectrumReal.data(), mSpectrumImag.data());
+
+    // The second half is the linear part of the circular convolution
+    this->ConvolveFirst(mMixes[mActive], mOutput.data());
+    const float* output = mOutput.data() + mPartitionSize + mFill;
+
+    if (mFading)
+    {
+        this->ConvolveFirst(mMixes[1 - mActive], mFadeOutput.data());
+        const float* next = mFadeOutput.data() + mPartitionSize + mFill;
+        for (int i = 0; i < numFrames; i++)
+        {
+            const float g = std::min(1.0f, static_cast<float>(mFadePosition + i) / mFadeLength);
+            data[i] = output[i] + g * (next[i] - output[i]);
+        }
+        mFadePosition += numFrames;
+        if (mFadePosition >= mFadeLength)
+        {
+            mFading = false;
+            mActive = 1 - mActive;
+        }
+    }
+    else
+        std::copy_n(output, numFrames, data);
+
+    mFill += numFrames;
+    if (mFill == mPartitionSize)
+        this->CompletePartition();
+}
+
+void PartitionedConvolver::CompletePartition()
+{
+    // The completed partition's spectrum goes into the history. ProcessPartial() has just transformed the input
+    // with the partition full, so that's it.
+    mNewest = (mNewest + 1) % mNumPartitions;
+    std::copy(mSpectrumReal.begin(), mSpectrumReal.end(), mHistoryReal.begin() + (size_t)mNewest * mNumBins);
+    std::copy(mSpectrumImag.begin(), mSpectrumImag.end(), mHistoryImag.begin() + (size_t)mNewest * mNumBins);
+
+    this->ComputeTail(mMixes[mActive]);
+    if (mFading)
+        this->ComputeTail(mMixes[1 - mActive]);
+
+    std::copy_n(mInput.data() + mPartitionSize, mPartitionSize, mInput.data());
+    std::fill(mInput.begin() + mPartitionSize, mInput.end(), 0.0f);
+    mFill = 0;
+}
+
+void StagedConvolver::Stage(std::shared_ptr<const IRSpectra> first, std::shared_ptr<const IRSpectra> second)
+{
+    if (first == nullptr)
+        std::swap(first, second);
+
+    std::unique_ptr<PartitionedConvolver> convolver;
+    if (first != nullptr)
+    {
+        convolver = std::make_unique<PartitionedConvolver>(std::move(first), std::move(second));
+        convolver->SetBlend(mBlend);
+        convolver->Reset();
+    }
+
+    // Freed outside the lock: a staged convolver that never got used, and whatever the audio thread has retired
+    std::unique_ptr<PartitionedConvolver> unused, retired;
+    const std::lock_guard<std::mutex> lock(mMutex);
+    unused = std::move(mStaged);
+    retired = std::move(mRetired);
+    mStaged = std::move(convolver);
+    mHasStaged = true;
+}
+
+void StagedConvolver::PickUpStaged()
+{
+    std::unique_lock<std::mutex> lock(mMutex, std::try_to_lock);
+    if (!lock.owns_lock() || !mHasStaged || mRetired != nullptr)
+        return;
+    mRetired = std::move(mLive);
+    mLive = std::move(mStaged);
+    mHasStaged = false;
+    if (mLive != nullptr)
+        mLive->SetBlend(mBlend);
+}
+
+void StagedConvolver::Process(float* data, const int numFrames)
+{
+    this->PickUpStaged();
+    if (mLive != nullptr)
+        mLive->Process(data, numFrames);
+}
+
+void StagedConvolver::Reset()
+{
+    this->PickUpStaged();
+    if (mLive != nullptr)
+        mLive->Reset();
+}
+
+void StagedConvolver::SetBlend(const float blend)
+{
+    mBlend = blend;
+    if (mLive != nullptr)
+        mLive->SetBlend(blend);
+}
+
+size_t StagedConvolver::Release()
+{
+    size_t bytes = 0;
+    const std::lock_guard<std::mutex> lock(mMutex);
+    for (std::unique_ptr<PartitionedConvolver>* convolver : {&mLive, &mStaged, &mRetired})
+    {
+        if (*convolver == nullptr)
+            continue;
+        bytes += (*convolver)->GetStateBytes();
+        for (const int index : {0, 1})
+            if ((*convolver)->GetIR(index) != nullptr && (*convolver)->GetIR(index).use_count() == 1)
+                bytes += (*convolver)->GetIR(index)->GetBytes();
+        convolver->reset();
+    }
+    mHasStaged = false;
+    return bytes;
+}
@@ -0,0 +1,140 @@
+#ifndef __PARTITIONED_CONVOLVER_H__
+#define __PARTITIONED_CONVOLVER_H__
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "IRStore.h"
+#include "RealFFT.h"
+
+// Uniformly partitioned convolution (overlap-save) with no latency, on spectra from IRStore, of one IR or a blend
+// of two.
+//
+// The spectra are shared; what each convolver keeps of its own is only the input history (the spectra of the
+// last numPartitions blocks of input) and the partition being filled. Each call transforms that partition as
+// far as it's filled and multiplies it with the first partition of the IR; everything the older partitions
+// contribute is added up once per partition, when one is completed.
+//
+// Both IRs convolve the same input, so the input is only transformed and kept once. Since convolution is linear,
+// a blend of the two is the convolution with the blend of their spectra: while the blend holds still, that's
+// premixed once and costs the same as a single IR. A change of blend crossfades from the old mix to the new one,
+// which is exactly the same as ramping the blend; only during the crossfade are there two mixes to run.
+class PartitionedConvolver
+{
+public:
+    // Allocates all the state, so not on the audio thread. second may be null; if not, it must have the same
+    // partition size and sample rate as first.
+    PartitionedConvolver (std::shared_ptr<const IRSpectra> first, std::shared_ptr<const IRSpectra> second = nullptr);
+
+    void Reset ();
+    // In place, any number of frames
+    void Process (float* data, const int numFrames);
+
+    // 0 is only the first IR, 1 only the second. Changes are crossfaded over kBlendRampSeconds.
+    void SetBlend (const float blend) { mTargetBlend = std::clamp(blend, 0.0f, 1.0f); };
+
+    const std::shared_ptr<const IRSpectra>& GetIR (const int index = 0) const { return mIRs[index]; };
+    // Of the longer IR, in samples
+    int GetLength () const;
+    size_t GetStateBytes () const;
+
+    static constexpr double kBlendRampSeconds = 0.02;
+
+private:
+    // Spectra that the input is convolved with, and what their older partitions add to the partition being filled
+    struct Mix
+    {
+        float blend = 0.0f;
+        const float* real = nullptr;
+        const float* imag = nullptr;
+        int numPartitions = 0;
+        std::vector<float> tailReal;
+        std::vector<float> tailImag;
+        // Where real/imag point to if the blend is strictly between the IRs; allocated only if there are two
+        std::vector<float> premixReal;
+        std::vector<float> premixImag;
+    };
+
+    // Points the mix at one IR, or premixes both
+    void SetMix (Mix& mix, const float blend);
+    void ComputeTail (Mix& mix);
+    // Y = X * H0 + tail, and back to the time domain
+    void ConvolveFirst (const Mix& mix, float* output);
+
+    // Up to the end of the partition being filled
+    void ProcessPartial (float* data, const int numFrames);
+    void CompletePartition ();
+
+    std::shared_ptr<const IRSpectra> mIRs[2];
+    RealFFT mFFT;
+    int mPartitionSize;
+    int mNumBins;
+    // Of the longer IR
+    int mNumPartitions;
+
+    // The previous partition of input, then the one being filled (zeros after mFill)
+    std::vector<float> mInput;
+    int mFill = 0;
+    // Spectra of past input partitions, newest at mNewest, going back through the ring
+    std::vector<float> mHistoryReal;
+    std::vector<float> mHistoryImag;
+    int mNewest = 0;
+
+    Mix mMixes[2];
+    int mActive = 0;
+    float mTargetBlend = 0.0f;
+    // Crossfading from the active mix to the other one
+    int mFadeLength;
+    int mFadePosition = 0;
+    bool mFading = false;
+
+    // The input partition's spectrum, and its product with a mix
+    std::vector<float> mSpectrumReal;
+    std::vector<float> mSpectrumImag;
+    std::vector<float> mProductReal;
+    std::vector<float> mProductImag;
+    std::vector<float> mOutput;
+    std::vector<float> mFadeOutput;
+};
+
+// A convolver as the audio thread sees it: a new one, made off the audio thread, is swapped in at the start of
+// the next block, the same way NeuralAmpModeler stages models.
+class StagedConvolver
+{
+public:
+    // Not on the audio thread. Null first and second clears the IR; if only one is set, that one is used.
+    void Stage (std::shared_ptr<const IRSpectra> first, std::shared_ptr<const IRSpectra> second = nullptr);
+
+    // Audio thread. Passes through if there's no IR.
+    void Process (float* data, const int numFrames);
+    // Audio thread, or while it's held off
+    void Reset ();
+    // Audio thread; see PartitionedConvolver::SetBlend()
+    void SetBlend (const float blend);
+    bool IsActive () const { return mLive != nullptr; };
+    // Of the live IRs, in samples; 0 if there are none
+    int GetIRLength () const { return mLive != nullptr ? mLive->GetLength() : 0; };
+
+    // Drops everything now, while the audio thread is held off. Returns roughly how much that freed: the state,
+    // plus the spectra if nobody else was using them.
+    size_t Release ();
+
+private:
+    void PickUpStaged ();
+
+    std::mutex mMutex;
+    std::unique_ptr<PartitionedConvolver> mLive;
+    // Guarded by mMutex
+    std::unique_ptr<PartitionedConvolver> mStaged;
+    bool mHasStaged = false;
+    // Swapped out by the audio thread, freed by the next Stage()
+    std::unique_ptr<PartitionedConvolver> mRetired;
+    // Set by the audio thread, and given to new convolvers so that they start at the right blend
+    std::atomic<float> mBlend{0.0f};
+};
+
+#endif
@@ -7,7 +7,10 @@ NAMAudioProcessorEditor::NAMAudioProcessorEditor(NAMAudioProcessor& p)
 {
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
-    setSize(500, 500);
+    setSize(500, 800);
+
+    // Whatever the user is looking at loads first
+    processorRef.setLoadPriority(LoaderService::Priority::kVisible);
 
     //==============================================================================
     addAndMakeVisible(inputSlider);
@@ -49,10 +52,102 @@ NAMAudioProcessorEditor::NAMAudioProcessorEditor(NAMAudioProcessor& p)
             processorRef.loadNamModel(model);
         }
     };
+
+    // The second model, and how much of it is blended in
+    addAndMakeVisible(blendSlider);
+    blendSlider.setSliderStyle(juce::Slider::LinearHorizontal);
+    blendSliderptr.reset(new juce::AudioProcessorValueTreeState::SliderAttachment(processorRef.apvts, "BLEND_ID", blendSlider));
+
+    loadBlendButton.reset(new juce::TextButton("Blend Model"));
+    addAndMakeVisible(loadBlendButton.get());
+    loadBlendButton->onClick = [this]
+    {
+        juce::File searchLocation = juce::File::getSpecialLocation(juce::File::userHomeDirectory);
+        juce::FileChooser chooser("Choose a model to blend with", searchLocation, "*.nam", true, false);
+        if (chooser.browseForFileToOpen())
+            processorRef.loadNamModel(chooser.getResult(), {}, 1);
+    };
+
+    // Picks from the indexed library; only the chosen model gets parsed
+    addAndMakeVisible(modelBrowser);
+    modelBrowser.onModelChosen = [this](const juce::File& model) { processorRef.loadNamModel(model); };
+
+    addAndMakeVisible(sleepLabel);
+    sleepLabel.setJustificationType(juce::Justification::centredLeft);
+
+    startTimerHz(meterRefreshHz);
 }
 
 NAMAudioProcessorEditor::~NAMAudioProcessorEditor()
 {
+    stopTimer();
+    processorRef.setLoadPriority(LoaderService::Priority::kNormal);
+}
+
+void NAMAudioProcessorEditor::timerCallback()
+{
+    updateMeters();
+
+    if (processorRef.isHibernating())
+        sleepLabel.setText("Hibernating, freed " + juce::String(processorRef.getBytesReclaimed() / (1024.0 * 1024.0), 1) + " MB",
+                           juce::dontSendNotification);
+    else
+        sleepLabel.setText("Asleep: " + juce::String(processorRef.getSecondsAsleep(), 1) + " s ("
+                               + juce::String(100.0 * processorRef.getFractionAsleep(), 1) + "%)",
+                           juce::dontSendNotification);
+}
+
+void NAMAudioProcessorEditor::updateMeters()
+{
+    // Levels jump up straight away and fall back at a fixed rate
+    const float fall = meterFallDBPerSecond / meterRefreshHz;
+    float newInputPeakDB = juce::jmax(meterFloorDB, inputPeakDB - fall);
+    float newInputRmsDB = juce::jmax(meterFloorDB, inputRmsDB - fall);
+    float newOutputPeakDB = juce::jmax(meterFloorDB, outputPeakDB - fall);
+    float newOutputRmsDB = juce::jmax(meterFloorDB, outputRmsDB - fall);
+    float newGainReductionDB = juce::jmin(0.0f, gainReductionDB + fall);
+    bool newGating = gating;
+
+    MeterFrame frame;
+    bool gotFrame = false;
+    while (processorRef.getMeters().Pop(frame))
+    {
+        if (!gotFrame)
+            newGating = false;
+        gotFrame = true;
+        newInputPeakDB = juce::jmax(newInputPeakDB, juce::Decibels::gainToDecibels(frame.inputPeak, meterFloorDB));
+        newInputRmsDB = juce::jmax(newInputRmsDB, juce::Decibels::gainToDecibels(frame.inputRms, meterFloorDB));
+        newOutputPeakDB = juce::jmax(newOutputPeakDB, juce::Decibels::gainToDecibels(frame.outputPeak, meterFloorDB));
+        newOutputRmsDB = juce::jmax(newOutputRmsDB, juce::Decibels::gainToDecibels(frame.outputRms, meterFloorDB));
+        newGainReductionDB = juce::jmin(newGainReductionDB, frame.gainReductionDB);
+        newGating = newGating || frame.gating;
+    }
+
+    if (newInputPeakDB != inputPeakDB || newInputRmsDB != inputRmsDB || newOutputPeakDB != outputPeakDB
+        || newOutputRmsDB != outputRmsDB || newGainReductionDB != gainReductionDB || newGating != gating)
+    {
+        inputPeakDB = newInputPeakDB;
+        inputRmsDB = newInputRmsDB;
+        outputPeakDB = newOutputPeakDB;
+        outputRmsDB = newOutputRmsDB;
+        gainReductionDB = newGainReductionDB;
+        gating = newGating;
+        repaint(meterArea);
+    }
+}
+
+void NAMAudioProcessorEditor::drawMeter(juce::Graphics& g, juce::Rectangle<int> bounds, const juce::String& name, float peakDB, float rmsDB)
+{
+    g.setColour(juce::Colours::white);
+    g.drawText(name, bounds.removeFromLeft(40), juce::Justification::centredLeft);
+
+    const auto toWidth = [&bounds](const float dB) { return juce::jmap(dB, meterFloorDB, 0.0f, 0.0f, (float)bounds.getWidth()); };
+    g.setColour(juce::Colours::darkgrey);
+    g.fillRect(bounds);
+    g.setColour(juce::Colours::green);
+    g.fillRect(bounds.withWidth(juce::roundToInt(toWidth(rmsDB))));
+    g.setColour(peakDB >= 0.0f ? juce::Colours::red : juce::Colours::lightgreen);
+    g.fillRect(bounds.getX() + juce::roundToInt(toWidth(peakDB)) - 1, bounds.getY(), 2, bounds.getHeight());
 }
 
 //==============================================================================
@@ -61,7 +156,23 @@ void NAMAudioProcessorEditor::paint(juce::Graphics& g)
     // (Our component is opaque, so we must completely fill the background with a solid colour)
     g.fillAll (getLookAndFeel().findColour (juce::ResizableWindow::backgroundColourId));
     g.setColour (juce::Colours::white);
-    g.setFont (15.0f);
+    g.setFont (12.0f);
+
+    auto area = meterArea;
+    drawMeter(g, area.removeFromTop(12), "In", inputPeakDB, inputRmsDB);
+    area.removeFromTop(2);
+    drawMeter(g, area.removeFromTop(12), "Out", outputPeakDB, outputRmsDB);
+    area.removeFromTop(2);
+
+    // Gate: how far it's pulling down, from the right
+    auto gateRow = area.removeFromTop(12);
+    g.setColour(gating ? juce::Colours::orange : juce::Colours::white);
+    g.drawText("Gate", gateRow.removeFromLeft(40), juce::Justification::centredLeft);
+    g.setColour(juce::Colours::darkgrey);
+    g.fillRect(gateRow);
+    const int reductionWidth = juce::roundToInt(juce::jmap(juce::jmax(gainReductionDB, meterFloorDB), meterFloorDB, 0.0f, (float)gateRow.getWidth(), 0.0f));
+    g.setColour(juce::Colours::orange);
+    g.fillRect(gateRow.withLeft(gateRow.getRight() - reductionWidth));
 }
 
 void NAMAudioProcessorEditor::resized()
@@ -74,4 +185,8 @@ void NAMAudioProcessorEditor::resized()
     middleSlider.setBounds(50, 200, 400, 50);
     trebleSlider.setBounds(50, 250, 400, 50);
     outputSlider.setBounds(50, 300, 400, 50);
+    blendSlider.setBounds(50, 350, 290, 50);
+    loadBlendButton->setBounds(350, 360, 100, 30);
+    sleepLabel.setBounds(200, 400, 250, 50);
+    modelBrowser.setBounds(50, 505, 400, 280);
 }
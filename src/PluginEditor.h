@@ -1,10 +1,11 @@
 #pragma once
 
 #include "PluginProcessor.h"
+#include "ModelBrowser.h"
 #include "juce_gui_basics/juce_gui_basics.h"
 
 //==============================================================================
-class NAMAudioProcessorEditor final : public juce::AudioProcessorEditor
+class NAMAudioProcessorEditor final : public juce::AudioProcessorEditor, private juce::Timer
 {
 public:
     explicit NAMAudioProcessorEditor(NAMAudioProcessor&);
@@ -15,6 +16,16 @@ public:
     void resized () override;
 
 private:
+    void timerCallback () override;
+    // Takes whatever frames the processor has published since the last tick
+    void updateMeters ();
+    void drawMeter (juce::Graphics& g, juce::Rectangle<int> bounds, const juce::String& name, float peakDB, float rmsDB);
+
+    static constexpr int meterRefreshHz = 30;
+    // How fast the displayed levels fall back when the signal drops, in dB per second
+    static constexpr float meterFallDBPerSecond = 40.0f;
+    static constexpr float meterFloorDB = -60.0f;
+
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
     NAMAudioProcessor& processorRef;
@@ -38,7 +49,24 @@ private:
     juce::Slider outputSlider;
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> outputSliderptr;
 
+    juce::Slider blendSlider;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> blendSliderptr;
+
     std::unique_ptr<juce::TextButton> loadButton;
+    std::unique_ptr<juce::TextButton> loadBlendButton;
+
+    ModelBrowser modelBrowser;
+
+    juce::Label sleepLabel;
+
+    // What the meters show, in dB
+    float inputPeakDB{meterFloorDB};
+    float inputRmsDB{meterFloorDB};
+    float outputPeakDB{meterFloorDB};
+    float outputRmsDB{meterFloorDB};
+    float gainReductionDB{0.0f};
+    bool gating{false};
+    juce::Rectangle<int> meterArea{50, 455, 400, 40};
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NAMAudioProcessorEditor)
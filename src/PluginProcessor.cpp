@@ -9,6 +9,18 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
+namespace
+{
+// Where the engine reads each of its parameters from
+const std::pair<int, const char*> kEngineParameterIds[] = {
+    {NeuralAmpModeler::kInputLevel, "INPUT_ID"},       {NeuralAmpModeler::kNoiseGateThreshold, "GATE_ID"},
+    {NeuralAmpModeler::kToneBass, "BASS_ID"},          {NeuralAmpModeler::kToneMid, "MIDDLE_ID"},
+    {NeuralAmpModeler::kToneTreble, "TREBLE_ID"},      {NeuralAmpModeler::kOutputLevel, "OUTPUT_ID"},
+    {NeuralAmpModeler::kEQActive, "TONE_STACK_ON_ID"}, {NeuralAmpModeler::kOutNorm, "NORMALIZE_ID"},
+    {NeuralAmpModeler::kModelBlend, "BLEND_ID"},       {NamEngine::kCabActive, "CAB_ON_ID"},
+    {NamEngine::kCabBlend, "CAB_BLEND_ID"}};
+}; // namespace
+
 //==============================================================================
 NAMAudioProcessor::NAMAudioProcessor()
     : AudioProcessor(BusesProperties()
@@ -21,10 +33,17 @@ NAMAudioProcessor::NAMAudioProcessor()
         ),
       apvts(*this, nullptr, "Parameters", createParameters())
 {
+    for (const auto& [parameter, id] : kEngineParameterIds)
+        engine.HookParameter(parameter, apvts.getRawParameterValue(id));
+    loaderClientId = loader->RegisterClient();
+    startTimerHz(hibernationCheckHz);
 }
 
 NAMAudioProcessor::~NAMAudioProcessor()
 {
+    stopTimer();
+    // Make sure no load finishes into a half-destroyed instance
+    loader->CancelClient(loaderClientId);
 }
 
 //==============================================================================
@@ -95,23 +114,29 @@ void NAMAudioProcessor::changeProgramName(int index, const juce::String& newName
 //==============================================================================
 void NAMAudioProcessor::prepareToPlay(double sampleRate, int samplesPerBlock)
 {
-    juce::dsp::ProcessSpec spec;
+    engine.Prepare(sampleRate, samplesPerBlock);
 
-    spec.sampleRate = sampleRate;
-    spec.numChannels = getTotalNumOutputChannels();
-    spec.maximumBlockSize = samplesPerBlock;
+    const int partitionSize = engine.GetPartitionSize();
+    const bool cabChanged = sampleRate != cabSampleRate.load() || partitionSize != cabPartitionSize.load();
+    cabSampleRate = sampleRate;
+    cabPartitionSize = partitionSize;
 
-    myNAM.prepare(spec);
-    myNAM.hookParameters(apvts);
+    sleepDetector.Reset(sampleRate);
+    meters.Reset(sampleRate);
 
-    cab.reset();
-    cab.prepare(spec);
+    bypassedSamples = 0;
+    const bool wasHibernating = hibernating;
+    wakeUp();
+
+    // The IRs' spectra were made for the old rate or partition size (or they've waited for this to learn them)
+    if (cabChanged && !wasHibernating)
+        reloadImpulseResponses();
 }
 
 void NAMAudioProcessor::releaseResources()
 {
-    // When playback stops, you can use this as an opportunity to free up any
-    // spare memory, etc.
+    // Nothing is going to play until the next prepareToPlay(), which reloads what this frees
+    hibernate();
 }
 
 bool NAMAudioProcessor::isBusesLayoutSupported(const BusesLayout& layouts) const
@@ -141,107 +166,399 @@ bool NAMAudioProcessor::isBusesLayoutSupported(const BusesLayout& layouts) const
 void NAMAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
     juce::ScopedNoDenormals noDenormals;
+    bypassedSamples.store(0, std::memory_order_relaxed);
+    if (hibernating.load(std::memory_order_relaxed))
+        wakeRequested = true;
+
     auto totalNumInputChannels = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear(i, 0, buffer.getNumSamples());
 
-    juce::dsp::AudioBlock<float> block(buffer);
-
     auto* channelDataLeft = buffer.getWritePointer(0);
     auto* channelDataRight = buffer.getWritePointer(1);
 
-    myNAM.processBlock(buffer);
-
-    if (bool(*apvts.getRawParameterValue("CAB_ON_ID")) && irLoaded)
+    const int numSamples = buffer.getNumSamples();
+    const float inputPeak = buffer.getMagnitude(0, 0, numSamples);
+    meters.AddInput(channelDataLeft, numSamples);
+
+    // Nothing coming in and nothing ringing out: skip the whole chain. The input is judged as the models would see
+    // it, after the input gain, so that a quiet signal that's turned up wakes the chain.
+    const float inputGainDB = *apvts.getRawParameterValue("INPUT_ID");
+    const float gainedInputPeak = inputPeak * juce::Decibels::decibelsToGain(inputGainDB);
+    sleepDetector.SetEnabled(bool(*apvts.getRawParameterValue("SLEEP_ON_ID")));
+    sleepDetector.SetThresholdDB(*apvts.getRawParameterValue("SLEEP_THRESHOLD_ID"));
+    if (sleepDetector.ShouldSleep(gainedInputPeak, numSamples))
     {
-        cab.process(juce::dsp::ProcessContextReplacing<float>(block));
-        if (irFound)
-            buffer.applyGain(juce::Decibels::decibelsToGain(6.0f));
+        buffer.clear();
+        meters.AddOutput(channelDataLeft, numSamples, 0.0f, false);
+        return;
     }
 
+    engine.Process(channelDataLeft, numSamples);
+
+    sleepDetector.SetTailSeconds(engine.GetTailSeconds());
+    // The gate's level follower sees the input before the input gain
+    const double inputLevelDB =
+        juce::jmax(engine.GetAmp().getInputLevelDB() + inputGainDB, (double)juce::Decibels::gainToDecibels(gainedInputPeak, -200.0f));
+    sleepDetector.Update(inputLevelDB, buffer.getMagnitude(0, 0, numSamples), numSamples);
+
+    meters.AddOutput(channelDataLeft, numSamples, engine.GetAmp().getGainReductionDB(), engine.GetAmp().isGating());
+
     // Do Dual Mono
     for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
         channelDataRight[sample] = channelDataLeft[sample];
 }
 
+void NAMAudioProcessor::processBlockBypassed(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    // Counted for the message thread, which hibernates the instance once it's been bypassed for long enough
+    bypassedSamples.fetch_add(buffer.getNumSamples(), std::memory_order_relaxed);
+    AudioProcessor::processBlockBypassed(buffer, midiMessages);
+}
+
 //==============================================================================
-void NAMAudioProcessor::loadNamModel(juce::File modelToLoad)
+void NAMAudioProcessor::setHibernateAfterSeconds(const double seconds)
 {
-    std::string model_path = modelToLoad.getFullPathName().toStdString();
+    hibernateAfterSeconds = juce::jmax(0.0, seconds);
+}
+
+void NAMAudioProcessor::setPruneThreshold(const float threshold)
+{
+    pruneThreshold = threshold;
+    engine.GetAmp().setPruneThreshold(threshold);
+}
+
+void NAMAudioProcessor::setIrProcessing(const IRProcessing& processing)
+{
+    const IRProcessing previous = getIrProcessing();
+    irTailFloorDB = processing.tailFloorDB;
+    irMinimumPhase = processing.minimumPhase;
+    // The store keeps spectra by their processing, so IRs that other instances process the same way are shared
+    if ((processing.tailFloorDB != previous.tailFloorDB || processing.minimumPhase != previous.minimumPhase) && !hibernating)
+        reloadImpulseResponses();
+}
+
+IRProcessing NAMAudioProcessor::getIrProcessing() const
+{
+    IRProcessing processing;
+    processing.tailFloorDB = irTailFloorDB;
+    processing.minimumPhase = irMinimumPhase;
+    return processing;
+}
+
+std::string NAMAudioProcessor::getIrReport(const int slot)
+{
+    const juce::ScopedLock lock(stateLock);
+    return cabSpectra[slot] != nullptr ? cabSpectra[slot]->report.ToString() : std::string();
+}
+
+void NAMAudioProcessor::hibernate()
+{
+    if (hibernating)
+        return;
+
     this->suspendProcessing(true);
-    namModelLoaded = myNAM.loadModel(model_path);
+
+    // Drop any load that's queued, and wait out one that's handing over right now, so that nothing lands in what's
+    // about to be freed. The paths and hashes stay, for wakeUp().
+    for (std::atomic<int>& generation : modelLoadGeneration)
+        ++generation;
+    for (std::atomic<int>& generation : irLoadGeneration)
+        ++generation;
+    loader->CancelClient(loaderClientId);
+    loader->SetPriority(loaderClientId, loadPriority);
+
+    // The IR's spectra go too, unless another instance is still using them
+    {
+        const juce::ScopedLock lock(stateLock);
+        cabSpectra = {};
+    }
+    const size_t bytes = engine.Release();
+
+    for (std::atomic<bool>& loaded : namModelLoaded)
+        loaded = false;
+    irLoaded = false;
+    wakeRequested = false;
+    hibernating = true;
+    bytesReclaimed = bytes;
+
     this->suspendProcessing(false);
+    DBG("Hibernating, freed about " << (int)(bytes / 1024) << " KiB");
+}
 
-    auto addons = apvts.state.getOrCreateChildWithName("addons", nullptr);
-    lastModelPath = model_path;
-    lastModelName = modelToLoad.getFileNameWithoutExtension().toStdString();
-    addons.setProperty("model_path", juce::String(lastModelPath), nullptr);
+void NAMAudioProcessor::wakeUp()
+{
+    if (!hibernating.exchange(false))
+        return;
+    wakeRequested = false;
+
+    std::array<juce::String, numModels> modelPath, modelHash;
+    std::array<juce::String, numIRs> irPath, irHash;
+    {
+        const juce::ScopedLock lock(stateLock);
+        for (int slot = 0; slot < numModels; slot++)
+        {
+            modelPath[slot] = lastModelPath[slot];
+            modelHash[slot] = lastModelHash[slot];
+        }
+        for (int slot = 0; slot < numIRs; slot++)
+        {
+            irPath[slot] = lastIrPath[slot];
+            irHash[slot] = lastIrHash[slot];
+        }
+    }
+
+    // Through the shared loader like any other load, so that instances waking up together (e.g. the host preparing a
+    // whole session again) share one parse of each file
+    for (int slot = 0; slot < numModels; slot++)
+        if (juce::File::isAbsolutePath(modelPath[slot]))
+            loadNamModel(juce::File(modelPath[slot]), modelHash[slot], slot);
+    for (int slot = 0; slot < numIRs; slot++)
+        if (juce::File::isAbsolutePath(irPath[slot]))
+            loadImpulseResponse(juce::File(irPath[slot]), irHash[slot], slot);
+}
+
+void NAMAudioProcessor::timerCallback()
+{
+    if (hibernating)
+    {
+        if (wakeRequested)
+            wakeUp();
+        return;
+    }
+
+    const double afterSeconds = hibernateAfterSeconds;
+    const double sampleRate = getSampleRate();
+    if (afterSeconds > 0.0 && sampleRate > 0.0 && bypassedSamples.load(std::memory_order_relaxed) >= afterSeconds * sampleRate)
+        hibernate();
+}
+
+//==============================================================================
+void NAMAudioProcessor::loadNamModel(juce::File modelToLoad, const juce::String& expectedHash, const int slot)
+{
+    // Bring the IR back too; the model we were going to reload is superseded by this one
+    wakeUp();
 
+    std::string model_path = modelToLoad.getFullPathName().toStdString();
+
+    auto addons = apvts.state.getOrCreateChildWithName("addons", nullptr);
     auto search_paths = apvts.state.getOrCreateChildWithName("search_paths", nullptr);
-    lastModelSerachDir = modelToLoad.getParentDirectory().getFullPathName().toStdString();
-    search_paths.setProperty("LastModelSearchDir", juce::String(lastModelSerachDir), nullptr);
+    {
+        const juce::ScopedLock lock(stateLock);
+        lastModelPath[slot] = model_path;
+        lastModelName[slot] = modelToLoad.getFileNameWithoutExtension().toStdString();
+        lastModelHash[slot] = "";
+        lastModelSerachDir = modelToLoad.getParentDirectory().getFullPathName().toStdString();
+    }
+    addons.setProperty(slotProperty("model", slot, "path"), juce::String(model_path), nullptr);
+    search_paths.setProperty("LastModelSearchDir", modelToLoad.getParentDirectory().getFullPathName(), nullptr);
+
+    // Parsed by the shared loader (once, however many instances ask for the same file); each instance then
+    // builds its own model from the result and stages it for the audio thread.
+    const int generation = ++modelLoadGeneration[slot];
+    loader->Request<ParsedModel>(
+        "model:" + model_path, LoaderService::Priority::kNormal, loaderClientId, [modelToLoad] { return parseModelFile(modelToLoad); },
+        [this, modelToLoad, expectedHash, generation, slot](std::shared_ptr<const ParsedModel> parsed, const std::string& error)
+        {
+            // A newer request came in while this one was loading
+            if (generation != modelLoadGeneration[slot].load())
+                return;
+
+            if (parsed == nullptr)
+                DBG("Failed to read " << modelToLoad.getFullPathName() << ": " << error);
+
+            // Checked again when the model is staged, since clearNAM() or a newer load can come in while it's being built
+            const bool loaded = parsed != nullptr
+                                && engine.LoadModel(parsed->data, slot, [this, generation, slot] { return generation == modelLoadGeneration[slot].load(); });
+            if (loaded && expectedHash.isNotEmpty() && juce::String(parsed->hash) != expectedHash)
+                DBG("Model " << modelToLoad.getFullPathName() << " has changed since the session was saved");
+
+            const juce::ScopedLock lock(stateLock);
+            if (generation == modelLoadGeneration[slot].load())
+            {
+                namModelLoaded[slot] = loaded;
+                lastModelHash[slot] = loaded ? parsed->hash : "";
+            }
+        });
 }
 
 bool NAMAudioProcessor::getTriggerStatus()
 {
-    auto t_state = myNAM.getTrigger();
+    auto t_state = engine.GetAmp().getTrigger();
     return t_state->isGating();
 }
 
-bool NAMAudioProcessor::getNamModelStatus()
+double NAMAudioProcessor::getSecondsAsleep() const
 {
-    return this->namModelLoaded;
+    return sleepDetector.GetSecondsAsleep();
 }
 
-void NAMAudioProcessor::clearNAM()
+double NAMAudioProcessor::getFractionAsleep() const
+{
+    return sleepDetector.GetFractionAsleep();
+}
+
+bool NAMAudioProcessor::getNamModelStatus(const int slot)
+{
+    return this->namModelLoaded[slot];
+}
+
+void NAMAudioProcessor::clearNAM(const int slot)
 {
     this->suspendProcessing(true);
-    myNAM.clearModel();
-    lastModelPath = "null";
-    lastModelName = "null";
+    ++modelLoadGeneration[slot];
+    engine.ClearModel(slot);
+    {
+        const juce::ScopedLock lock(stateLock);
+        lastModelPath[slot] = "null";
+        lastModelName[slot] = "null";
+        lastModelHash[slot] = "";
+    }
 
     auto addons = apvts.state.getOrCreateChildWithName("addons", nullptr);
-    addons.setProperty("model_path", juce::String(lastModelPath), nullptr);
+    addons.setProperty(slotProperty("model", slot, "path"), juce::String(lastModelPath[slot]), nullptr);
 
-    namModelLoaded = false;
+    namModelLoaded[slot] = false;
 
     this->suspendProcessing(false);
 }
 
-void NAMAudioProcessor::loadImpulseResponse(juce::File irToLoad)
+void NAMAudioProcessor::loadImpulseResponse(juce::File irToLoad, const juce::String& expectedHash, const int slot)
 {
+    wakeUp();
+
     this->suspendProcessing(true);
 
-    this->clearIR();
+    // Whatever's loaded in the slot keeps playing until the new spectra are staged, so that a reload (for a new
+    // rate, partition size or processing) doesn't drop the cab in between
+    const int generation = ++irLoadGeneration[slot];
     std::string ir_path = irToLoad.getFullPathName().toStdString();
-    cab.loadImpulseResponse(
-        irToLoad, juce::dsp::Convolution::Stereo::no, juce::dsp::Convolution::Trim::no, 0, juce::dsp::Convolution::Normalise::yes);
-    irLoaded = true;
-    irFound = true;
 
     auto addons = apvts.state.getOrCreateChildWithName("addons", nullptr);
-    lastIrPath = ir_path;
-    lastIrName = irToLoad.getFileNameWithoutExtension().toStdString();
-    addons.setProperty("ir_path", juce::String(lastIrPath), nullptr);
-
     auto search_paths = apvts.state.getOrCreateChildWithName("search_paths", nullptr);
-    lastIrSerachDir = irToLoad.getParentDirectory().getFullPathName().toStdString();
-    search_paths.setProperty("LastIrSearchDir", juce::String(lastIrSerachDir), nullptr);
+    {
+        const juce::ScopedLock lock(stateLock);
+        lastIrPath[slot] = ir_path;
+        lastIrName[slot] = irToLoad.getFileNameWithoutExtension().toStdString();
+        lastIrHash[slot] = expectedHash.toStdString();
+        lastIrSerachDir = irToLoad.getParentDirectory().getFullPathName().toStdString();
+    }
+    addons.setProperty(slotProperty("ir", slot, "path"), juce::String(ir_path), nullptr);
+    search_paths.setProperty("LastIrSearchDir", irToLoad.getParentDirectory().getFullPathName(), nullptr);
 
     this->suspendProcessing(false);
+
+    const double sampleRate = cabSampleRate;
+    const int partitionSize = cabPartitionSize;
+    const IRProcessing processing = getIrProcessing();
+    // The spectra are made for the rate the host runs at, which isn't known until prepareToPlay(); that loads it
+    if (sampleRate <= 0.0)
+        return;
+
+    // Another instance has this IR loaded at this rate already: share its spectra without touching the file
+    if (expectedHash.isNotEmpty())
+    {
+        if (auto spectra = irStore->Find(expectedHash.toStdString(), sampleRate, partitionSize, processing))
+        {
+            const juce::ScopedLock lock(stateLock);
+            cabSpectra[slot] = std::move(spectra);
+            stageCab();
+            return;
+        }
+    }
+
+    const std::string key = "ir:" + ir_path + "@" + std::to_string(sampleRate) + "/" + std::to_string(partitionSize) + "/"
+                            + std::to_string(processing.tailFloorDB) + (processing.minimumPhase ? "/min" : "");
+    loader->Request<ParsedIR>(
+        key, LoaderService::Priority::kNormal, loaderClientId,
+        [irToLoad, sampleRate, partitionSize, processing] { return parseIrFile(irToLoad, sampleRate, partitionSize, processing); },
+        [this, irToLoad, expectedHash, generation, slot](std::shared_ptr<const ParsedIR> parsed, const std::string& error)
+        {
+            if (generation != irLoadGeneration[slot].load())
+                return;
+
+            if (parsed == nullptr)
+            {
+                DBG("Failed to read " << irToLoad.getFullPathName() << ": " << error);
+                // Don't leave the last IR playing under this one's name
+                const juce::ScopedLock lock(stateLock);
+                if (generation == irLoadGeneration[slot].load() && cabSpectra[slot] != nullptr)
+                {
+                    lastIrHash[slot] = "";
+                    cabSpectra[slot] = nullptr;
+                    stageCab();
+                }
+                return;
+            }
+
+            if (expectedHash.isNotEmpty() && juce::String(parsed->hash) != expectedHash)
+                DBG("IR " << irToLoad.getFullPathName() << " has changed since the session was saved");
+            DBG(parsed->spectra->report.ToString());
+
+            const juce::ScopedLock lock(stateLock);
+            if (generation == irLoadGeneration[slot].load())
+            {
+                lastIrHash[slot] = parsed->hash;
+                cabSpectra[slot] = parsed->spectra;
+                stageCab();
+            }
+        });
 }
 
-void NAMAudioProcessor::clearIR()
+void NAMAudioProcessor::stageCab()
 {
-    cab.reset();
-    irLoaded = false;
-    lastIrPath = "null";
-    lastIrName = "null";
+    // Under stateLock, so that two IRs finishing at once can't stage an older pair over a newer one.
+    // While the IRs reload for a new rate or partition size, one may land before the other; the one still made
+    // for the old ones can't be blended with it, so it's left out until its own reload lands.
+    std::shared_ptr<const IRSpectra> first = cabSpectra[0], second = cabSpectra[1];
+    if (first != nullptr && second != nullptr
+        && (first->sampleRate != second->sampleRate || first->partitionSize != second->partitionSize))
+    {
+        const bool firstCurrent = first->sampleRate == cabSampleRate.load() && first->partitionSize == cabPartitionSize.load();
+        (firstCurrent ? second : first) = nullptr;
+    }
+    engine.SetIRs(first, second);
+    irLoaded = cabSpectra[0] != nullptr || cabSpectra[1] != nullptr;
+}
+
+void NAMAudioProcessor::reloadImpulseResponses()
+{
+    std::array<juce::String, numIRs> irPath, irHash;
+    {
+        const juce::ScopedLock lock(stateLock);
+        for (int slot = 0; slot < numIRs; slot++)
+        {
+            irPath[slot] = lastIrPath[slot];
+            irHash[slot] = lastIrHash[slot];
+        }
+    }
+    for (int slot = 0; slot < numIRs; slot++)
+        if (juce::File::isAbsolutePath(irPath[slot]))
+            loadImpulseResponse(juce::File(irPath[slot]), irHash[slot], slot);
+}
+
+void NAMAudioProcessor::setLoadPriority(const LoaderService::Priority priority)
+{
+    loadPriority = priority;
+    loader->SetPriority(loaderClientId, priority);
+}
+
+void NAMAudioProcessor::clearIR(const int slot)
+{
+    ++irLoadGeneration[slot];
+    {
+        const juce::ScopedLock lock(stateLock);
+        lastIrPath[slot] = "null";
+        lastIrName[slot] = "null";
+        lastIrHash[slot] = "";
+        cabSpectra[slot] = nullptr;
+        stageCab();
+    }
 
     auto addons = apvts.state.getOrCreateChildWithName("addons", nullptr);
-    addons.setProperty("ir_path", juce::String(lastIrPath), nullptr);
+    addons.setProperty(slotProperty("ir", slot, "path"), juce::String("null"), nullptr);
 }
 
 bool NAMAudioProcessor::getIrStatus()
@@ -262,6 +579,11 @@ juce::AudioProcessorValueTreeState::ParameterLayout NAMAudioProcessor::createPar
     layout.add(std::make_unique<juce::AudioParameterBool>("TONE_STACK_ON_ID", "TONE_STACK_ON", true, "TONE_STACK_ON"));
     layout.add(std::make_unique<juce::AudioParameterBool>("NORMALIZE_ID", "NORMALIZE", false, "NORMALIZE"));
     layout.add(std::make_unique<juce::AudioParameterBool>("CAB_ON_ID", "CAB_ON", true, "CAB_ON"));
+    layout.add(std::make_unique<juce::AudioParameterBool>("SLEEP_ON_ID", "SLEEP_ON", true, "SLEEP_ON"));
+    // dB, after the input gain
+    layout.add(std::make_unique<juce::AudioParameterFloat>("SLEEP_THRESHOLD_ID", "SLEEP_THRESHOLD", -120.0f, -40.0f, -90.0f));
+    layout.add(std::make_unique<juce::AudioParameterFloat>("BLEND_ID", "BLEND", 0.0f, 1.0f, 0.0f));
+    layout.add(std::make_unique<juce::AudioParameterFloat>("CAB_BLEND_ID", "CAB_BLEND", 0.0f, 1.0f, 0.0f));
     auto normRange = juce::NormalisableRange<float>(0.0, 20.0, 0.1f);
 
     return layout;
@@ -281,12 +603,136 @@ juce::AudioProcessorEditor* NAMAudioProcessor::createEditor()
 //==============================================================================
 void NAMAudioProcessor::getStateInformation(juce::MemoryBlock& destData)
 {
-    juce::ignoreUnused (destData);
+    auto state = apvts.copyState();
+
+    {
+        // Hashes are filled in by the loader threads once the files have been read
+        const juce::ScopedLock lock(stateLock);
+        auto addons = state.getOrCreateChildWithName("addons", nullptr);
+        for (int slot = 0; slot < numModels; slot++)
+        {
+            addons.setProperty(slotProperty("model", slot, "path"), juce::String(lastModelPath[slot]), nullptr);
+            addons.setProperty(slotProperty("model", slot, "hash"), juce::String(lastModelHash[slot]), nullptr);
+        }
+        for (int slot = 0; slot < numIRs; slot++)
+        {
+            addons.setProperty(slotProperty("ir", slot, "path"), juce::String(lastIrPath[slot]), nullptr);
+            addons.setProperty(slotProperty("ir", slot, "hash"), juce::String(lastIrHash[slot]), nullptr);
+        }
+    }
+    auto settings = state.getOrCreateChildWithName("addons", nullptr);
+    settings.setProperty("hibernate_after_seconds", hibernateAfterSeconds.load(), nullptr);
+    settings.setProperty("prune_threshold", pruneThreshold.load(), nullptr);
+    settings.setProperty("ir_tail_floor_db", irTailFloorDB.load(), nullptr);
+    settings.setProperty("ir_minimum_phase", irMinimumPhase.load(), nullptr);
+
+    std::unique_ptr<juce::XmlElement> xml(state.createXml());
+    copyXmlToBinary(*xml, destData);
 }
 
 void NAMAudioProcessor::setStateInformation(const void* data, int sizeInBytes)
 {
-    juce::ignoreUnused (data, sizeInBytes);
+    std::unique_ptr<juce::XmlElement> xml(getXmlFromBinary(data, sizeInBytes));
+    if (xml == nullptr || !xml->hasTagName(apvts.state.getType()))
+        return;
+
+    apvts.replaceState(juce::ValueTree::fromXml(*xml));
+
+    // Parameters are live now; the model and IR stream in on background threads.
+    auto addons = apvts.state.getOrCreateChildWithName("addons", nullptr);
+    auto search_paths = apvts.state.getOrCreateChildWithName("search_paths", nullptr);
+
+    setHibernateAfterSeconds(addons.getProperty("hibernate_after_seconds", defaultHibernateAfterSeconds));
+    setPruneThreshold(addons.getProperty("prune_threshold", -1.0f));
+    // Not through setIrProcessing(): the IRs are about to be loaded from the session anyway
+    irTailFloorDB = addons.getProperty("ir_tail_floor_db", 0.0);
+    irMinimumPhase = addons.getProperty("ir_minimum_phase", false);
+
+    for (int slot = 0; slot < numModels; slot++)
+    {
+        const juce::String modelPath = addons.getProperty(slotProperty("model", slot, "path"), "null");
+        const juce::String modelHash = addons.getProperty(slotProperty("model", slot, "hash"), "");
+        const juce::File modelFile = locateFile(modelPath, search_paths.getProperty("LastModelSearchDir", "null"));
+        if (modelFile.existsAsFile())
+            loadNamModel(modelFile, modelHash, slot);
+        else
+            clearNAM(slot);
+    }
+
+    for (int slot = 0; slot < numIRs; slot++)
+    {
+        const juce::String irPath = addons.getProperty(slotProperty("ir", slot, "path"), "null");
+        const juce::String irHash = addons.getProperty(slotProperty("ir", slot, "hash"), "");
+        const juce::File irFile = locateFile(irPath, search_paths.getProperty("LastIrSearchDir", "null"));
+        if (irFile.existsAsFile())
+            loadImpulseResponse(irFile, irHash, slot);
+        else
+        {
+            this->suspendProcessing(true);
+            clearIR(slot);
+            this->suspendProcessing(false);
+        }
+    }
+}
+
+juce::File NAMAudioProcessor::locateFile(const juce::String& savedPath, const juce::String& searchDir)
+{
+    if (!juce::File::isAbsolutePath(savedPath))
+        return {};
+
+    const juce::File savedFile(savedPath);
+    if (savedFile.existsAsFile() || !juce::File::isAbsolutePath(searchDir))
+        return savedFile;
+
+    // Sessions move between machines; fall back to a file of the same name in the folder we last loaded from
+    return juce::File(searchDir).getChildFile(savedFile.getFileName());
+}
+
+juce::Identifier NAMAudioProcessor::slotProperty(const char* kind, const int slot, const char* name)
+{
+    return juce::String(slot == 0 ? "" : "blend_") + kind + "_" + name;
+}
+
+std::shared_ptr<const NAMAudioProcessor::ParsedModel> NAMAudioProcessor::parseModelFile(const juce::File& file)
+{
+    juce::MemoryBlock bytes;
+    if (!file.loadFileAsData(bytes))
+        throw std::runtime_error("Couldn't read the file");
+
+    auto parsed = std::make_shared<ParsedModel>();
+    parsed->hash = juce::SHA256(bytes.getData(), bytes.getSize()).toHexString().toStdString();
+    parsed->data = ParseNamModel(static_cast<const char*>(bytes.getData()), bytes.getSize());
+    return parsed;
+}
+
+std::shared_ptr<const NAMAudioProcessor::ParsedIR> NAMAudioProcessor::parseIrFile(const juce::File& file, const double sampleRate,
+                                                                                   const int partitionSize, const IRProcessing& processing)
+{
+    juce::MemoryBlock bytes;
+    if (!file.loadFileAsData(bytes))
+        throw std::runtime_error("Couldn't read the file");
+
+    auto parsed = std::make_shared<ParsedIR>();
+    parsed->hash = juce::SHA256(bytes.getData(), bytes.getSize()).toHexString().toStdString();
+
+    // Another instance may have loaded the same IR (under any path) at this rate, processed the same way; then there's nothing to decode
+    const std::shared_ptr<IRStore> store = IRStore::GetInstance();
+    parsed->spectra = store->Find(parsed->hash, sampleRate, partitionSize, processing);
+    if (parsed->spectra != nullptr)
+        return parsed;
+
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(std::make_unique<juce::MemoryInputStream>(bytes, false)));
+    if (reader == nullptr)
+        throw std::runtime_error("Unsupported audio format");
+
+    // The cab is mono, so only the first channel is kept
+    juce::AudioBuffer<float> audio(1, (int)reader->lengthInSamples);
+    reader->read(&audio, 0, (int)reader->lengthInSamples, 0, true, false);
+    parsed->spectra = store->Acquire(parsed->hash, audio.getReadPointer(0), (size_t)audio.getNumSamples(), reader->sampleRate, sampleRate,
+                                     partitionSize, processing);
+    return parsed;
 }
 
 //==============================================================================
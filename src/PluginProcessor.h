@@ -2,10 +2,15 @@
 
 #include <juce_audio_processors/juce_audio_processors.h>
 #include <juce_dsp/juce_dsp.h>
-#include "NeuralAmpModeler.h"
+#include "NamEngine.h"
+#include "SleepDetector.h"
+#include "Metering.h"
+#include "LoaderService.h"
+#include "IRStore.h"
+#include "NamModelFile.h"
 
 //==============================================================================
-class NAMAudioProcessor final : public juce::AudioProcessor
+class NAMAudioProcessor final : public juce::AudioProcessor, private juce::Timer
 {
 public:
     //==============================================================================
@@ -19,7 +24,9 @@ public:
     bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlockBypassed (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
     using AudioProcessor::processBlock;
+    using AudioProcessor::processBlockBypassed;
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor () override;
@@ -45,37 +52,141 @@ public:
     void setStateInformation (const void* data, int sizeInBytes) override;
 
     //==============================================================================
-    void loadNamModel (juce::File modelToLoad);
-    bool getNamModelStatus ();
-    void clearNAM ();
-
-    void loadImpulseResponse (juce::File irToLoad);
+    // Returns straight away; the model is parsed on a background thread and swapped in when ready.
+    // expectedHash is the content hash saved with the session, if any.
+    // slot 1 is the model that the first one is blended with (see BLEND_ID).
+    void loadNamModel (juce::File modelToLoad, const juce::String& expectedHash = {}, const int slot = 0);
+    bool getNamModelStatus (const int slot = 0);
+    void clearNAM (const int slot = 0);
+
+    // slot 1 is the IR that the first one is blended with (see CAB_BLEND_ID)
+    void loadImpulseResponse (juce::File irToLoad, const juce::String& expectedHash = {}, const int slot = 0);
     bool getIrStatus ();
-    void clearIR ();
+    void clearIR (const int slot = 0);
+
+    // Loads for instances with a higher priority (e.g. an open editor) are served first
+    void setLoadPriority (const LoaderService::Priority priority);
 
     bool getTriggerStatus ();
 
+    // Levels and gate state, for the editor to drain on its timer
+    Metering& getMeters () { return meters; };
+
+    // Time this instance has spent asleep (skipping all DSP on silence)
+    double getSecondsAsleep () const;
+    double getFractionAsleep () const;
+
+    // Hibernation: once the host releases resources, or the instance has been bypassed for a while, the model and
+    // IR are freed, keeping only their paths, hashes and the parameters. They're reloaded in the background when
+    // processing resumes; until then the amp runs dry and the cab is skipped.
+    // 0 never hibernates on bypass. Saved with the session.
+    void setHibernateAfterSeconds (const double seconds);
+    double getHibernateAfterSeconds () const { return hibernateAfterSeconds; };
+    bool isHibernating () const { return hibernating; };
+    // Roughly how much memory the last hibernation gave back
+    size_t getBytesReclaimed () const { return bytesReclaimed; };
+
+    // Dead-channel pruning of models as they load (see NamBuildOptions::pruneThreshold); below 0 is off.
+    // Takes effect on the next load. Saved with the session.
+    void setPruneThreshold (const float threshold);
+
+    // Tail truncation and minimum-phase conversion of IRs as they load (see IRProcessing). Reloads the IRs that
+    // are in. Saved with the session.
+    void setIrProcessing (const IRProcessing& processing);
+    IRProcessing getIrProcessing () const;
+    // What processing did to the IR in a slot, or empty if there isn't one
+    std::string getIrReport (const int slot);
+
     juce::AudioProcessorValueTreeState apvts;
     juce::AudioProcessorValueTreeState::ParameterLayout createParameters ();
 
 private:
     //==============================================================================
-    NeuralAmpModeler myNAM;
+    // The whole chain, amp then cab; its parameters are the tree's own
+    NamEngine engine;
+
+    static constexpr int numIRs = NamEngine::kNumIRs;
+
+    // What's staged into the engine's cab, by slot; guarded by stateLock. The spectra come from the store, made for
+    // this sample rate and partition size.
+    std::array<std::shared_ptr<const IRSpectra>, numIRs> cabSpectra;
+    std::atomic<double> cabSampleRate{0.0};
+    std::atomic<int> cabPartitionSize{0};
+    std::atomic<bool> irLoaded{false};
 
-    juce::dsp::Convolution cab;
-    bool irFound{false};
-    bool irLoaded{false};
+    static constexpr int numModels = NamEngine::kNumModels;
 
-    std::string lastModelPath = "null";
-    std::string lastModelName = "null";
+    std::array<std::string, numModels> lastModelPath{"null", "null"};
+    std::array<std::string, numModels> lastModelName{"null", "null"};
 
-    std::string lastIrPath = "null";
-    std::string lastIrName = "null";
+    std::array<std::string, numIRs> lastIrPath{"null", "null"};
+    std::array<std::string, numIRs> lastIrName{"null", "null"};
 
     std::string lastModelSerachDir = "null";
     std::string lastIrSerachDir = "null";
 
-    bool namModelLoaded{false};
+    std::array<std::string, numModels> lastModelHash{};
+    std::array<std::string, numIRs> lastIrHash{};
+
+    // Guards the last* members, which the loader threads update
+    juce::CriticalSection stateLock;
+
+    std::array<std::atomic<bool>, numModels> namModelLoaded{};
+    std::array<std::atomic<int>, numModels> modelLoadGeneration{};
+    std::array<std::atomic<int>, numIRs> irLoadGeneration{};
+
+    SleepDetector sleepDetector;
+    Metering meters;
+
+    // Shared with every other instance in the process
+    std::shared_ptr<LoaderService> loader{LoaderService::GetInstance()};
+    std::shared_ptr<IRStore> irStore{IRStore::GetInstance()};
+    int64_t loaderClientId{0};
+    LoaderService::Priority loadPriority{LoaderService::Priority::kNormal};
+
+    static constexpr double defaultHibernateAfterSeconds = 60.0;
+    static constexpr int hibernationCheckHz = 4;
+    std::atomic<double> hibernateAfterSeconds{defaultHibernateAfterSeconds};
+    std::atomic<bool> hibernating{false};
+    // Set by the audio thread when it gets a block to process while hibernating
+    std::atomic<bool> wakeRequested{false};
+    // Samples since the last block that wasn't bypassed
+    std::atomic<int64_t> bypassedSamples{0};
+    std::atomic<size_t> bytesReclaimed{0};
+    std::atomic<float> pruneThreshold{-1.0f};
+    std::atomic<double> irTailFloorDB{0.0};
+    std::atomic<bool> irMinimumPhase{false};
+
+    // On the message thread
+    void hibernate ();
+    void wakeUp ();
+    void timerCallback () override;
+
+    // What the loader hands out: parsed once, shared by every instance that asked for the same file
+    struct ParsedModel
+    {
+        nam::dspData data;
+        std::string hash;
+    };
+
+    struct ParsedIR
+    {
+        std::shared_ptr<const IRSpectra> spectra;
+        std::string hash;
+    };
+
+    static std::shared_ptr<const ParsedModel> parseModelFile (const juce::File& file);
+    static std::shared_ptr<const ParsedIR> parseIrFile (const juce::File& file, const double sampleRate, const int partitionSize,
+                                                        const IRProcessing& processing);
+
+    static juce::File locateFile (const juce::String& savedPath, const juce::String& searchDir);
+    // Restages the cab with both IRs. Call with stateLock held.
+    void stageCab ();
+    // Loads the IRs again from their files, for a new sample rate, partition size or processing
+    void reloadImpulseResponses ();
+
+    // Session property for a model or IR slot: "model_path", "blend_ir_hash", ...
+    static juce::Identifier slotProperty (const char* kind, const int slot, const char* name);
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NAMAudioProcessor)
@@ -0,0 +1,97 @@
+#include "RealFFT.h"
+
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+RealFFT::RealFFT(const int size)
+    : mSize(size), mHalfSize(size / 2)
+{
+    if (size < 4 || (size & (size - 1)) != 0)
+        throw std::invalid_argument("FFT size must be a power of two");
+
+    const double pi = 3.14159265358979323846;
+    mTwiddles.resize(mHalfSize / 2);
+    for (int k = 0; k < mHalfSize / 2; k++)
+        mTwiddles[k] = std::polar(1.0, -2.0 * pi * k / mHalfSize);
+    mSplitTwiddles.resize(mHalfSize + 1);
+    for (int k = 0; k <= mHalfSize; k++)
+        mSplitTwiddles[k] = std::polar(1.0, -2.0 * pi * k / mSize);
+
+    int bits = 0;
+    while ((1 << bits) < mHalfSize)
+        bits++;
+    mBitReversed.resize(mHalfSize);
+    for (int i = 0; i < mHalfSize; i++)
+    {
+        int reversed = 0;
+        for (int b = 0; b < bits; b++)
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        mBitReversed[i] = reversed;
+    }
+
+    mWork.resize(mHalfSize);
+}
+
+void RealFFT::Transform(std::complex<float>* data, const bool inverse) const
+{
+    for (int i = 0; i < mHalfSize; i++)
+        if (i < mBitReversed[i])
+            std::swap(data[i], data[mBitReversed[i]]);
+
+    for (int length = 2; length <= mHalfSize; length *= 2)
+    {
+        const int half = length / 2;
+        const int stride = mHalfSize / length;
+        for (int start = 0; start < mHalfSize; start += length)
+        {
+            for (int k = 0; k < half; k++)
+            {
+                const std::complex<float> twiddle = inverse ? std::conj(mTwiddles[k * stride]) : mTwiddles[k * stride];
+                const std::complex<float> odd = data[start + k + half] * twiddle;
+                data[start + k + half] = data[start + k] - odd;
+                data[start + k] += odd;
+            }
+        }
+    }
+}
+
+void RealFFT::Forward(const float* input, float* real, float* imag)
+{
+    // Even samples as the real part, odd ones as the imaginary part
+    for (int k = 0; k < mHalfSize; k++)
+        mWork[k] = std::complex<float>(input[2 * k], input[2 * k + 1]);
+    this->Transform(mWork.data(), false);
+
+    // Pull the even and odd halves apart and combine them into the spectrum of the real signal
+    for (int k = 0; k <= mHalfSize; k++)
+    {
+        const std::complex<float> z = mWork[k % mHalfSize];
+        const std::complex<float> mirror = std::conj(mWork[(mHalfSize - k) % mHalfSize]);
+        const std::complex<float> even = 0.5f * (z + mirror);
+        const std::complex<float> odd = std::complex<float>(0.0f, -0.5f) * (z - mirror);
+        const std::complex<float> bin = even + mSplitTwiddles[k] * odd;
+        real[k] = bin.real();
+        imag[k] = bin.imag();
+    }
+}
+
+void RealFFT::Inverse(const float* real, const float* imag, float* output)
+{
+    for (int k = 0; k < mHalfSize; k++)
+    {
+        const std::complex<float> bin(real[k], imag[k]);
+        const std::complex<float> mirror(real[mHalfSize - k], -imag[mHalfSize - k]);
+        const std::complex<float> even = 0.5f * (bin + mirror);
+        const std::complex<float> odd = 0.5f * (bin - mirror) * std::conj(mSplitTwiddles[k]);
+        mWork[k] = even + std::complex<float>(0.0f, 1.0f) * odd;
+    }
+    this->Transform(mWork.data(), true);
+
+    const float scale = 1.0f / mHalfSize;
+    for (int k = 0; k < mHalfSize; k++)
+    {
+        output[2 * k] = mWork[k].real() * scale;
+        output[2 * k + 1] = mWork[k].imag() * scale;
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef __REAL_FFT_H__
+#define __REAL_FFT_H__
+
+#include <complex>
+#include <vector>
+
+// FFT of real signals, for the cab's convolution. Kept free of JUCE so that the DSP can be built without it.
+//
+// A size-N real transform is done as a size-N/2 complex one (radix-2, with precomputed twiddles and bit
+// reversal) plus a split step. Spectra are N/2 + 1 bins, stored as separate real and imaginary arrays, which
+// is what the convolution's multiply-accumulate wants.
+class RealFFT
+{
+public:
+    // size must be a power of two, at least 4
+    explicit RealFFT (const int size);
+
+    int GetSize () const { return mSize; };
+    int GetNumBins () const { return mSize / 2 + 1; };
+
+    // input: size samples. real, imag: GetNumBins() each. Unscaled.
+    void Forward (const float* input, float* real, float* imag);
+    // The exact inverse of Forward(), scaling included. output: size samples.
+    void Inverse (const float* real, const float* imag, float* output);
+
+private:
+    void Transform (std::complex<float>* data, const bool inverse) const;
+
+    int mSize;
+    int mHalfSize;
+    // e^(-2 pi i k / (size / 2)), for the complex transform
+    std::vector<std::complex<float>> mTwiddles;
+    // e^(-2 pi i k / size), for the split step
+    std::vector<std::complex<float>> mSplitTwiddles;
+    std::vector<int> mBitReversed;
+    std::vector<std::complex<float>> mWork;
+};
+
+#endif
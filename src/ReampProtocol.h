@@ -0,0 +1,110 @@
+#ifndef __REAMP_PROTOCOL_H__
+#define __REAMP_PROTOCOL_H__
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+// Framed protocol spoken over the reamp server's Unix domain socket.
+// Every message is a FrameHeader followed by `length` bytes of payload. Both ends are on the same machine, so
+// everything is in native byte order.
+//
+// Client -> server:
+//   kConfigure  "key=value" lines: model, ir, sample_rate, max_block_size, and the parameters (input, gate, bass,
+//               middle, treble, output, tone_stack, normalize, cab)
+//   kAudio      mono float32 samples, at most max_block_size of them
+//   kStats      empty
+// Server -> client:
+//   kAudio      the processed samples, same length as the request
+//   kStats      JSON text
+//   kAck        reply to kConfigure
+//   kError      text
+namespace reamp
+{
+static const uint32_t kMagic = 0x524d414e; // "NAMR"
+static const uint32_t kMaxPayloadBytes = 1 << 20;
+
+enum class MessageType : uint16_t
+{
+    kConfigure = 1,
+    kAudio,
+    kStats,
+    kAck,
+    kError
+};
+
+struct FrameHeader
+{
+    uint32_t magic = kMagic;
+    uint16_t type = 0;
+    uint16_t flags = 0;
+    uint32_t length = 0;
+};
+
+// Blocking I/O that deals with short reads/writes. Returns false if the connection went away.
+inline bool ReadFully(const int fd, void* data, size_t size)
+{
+    char* bytes = static_cast<char*>(data);
+    while (size > 0)
+    {
+        const ssize_t numRead = ::read(fd, bytes, size);
+        if (numRead < 0 && errno == EINTR)
+            continue;
+        if (numRead <= 0)
+            return false;
+        bytes += numRead;
+        size -= (size_t)numRead;
+    }
+    return true;
+}
+
+inline bool WriteFully(const int fd, const void* data, size_t size)
+{
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0)
+    {
+        const ssize_t numWritten = ::write(fd, bytes, size);
+        if (numWritten < 0 && errno == EINTR)
+            continue;
+        if (numWritten <= 0)
+            return false;
+        bytes += numWritten;
+        size -= (size_t)numWritten;
+    }
+    return true;
+}
+
+inline bool SendMessage(const int fd, const MessageType type, const void* payload, const uint32_t length)
+{
+    FrameHeader header;
+    header.type = static_cast<uint16_t>(type);
+    header.length = length;
+    return WriteFully(fd, &header, sizeof(header)) && (length == 0 || WriteFully(fd, payload, length));
+}
+
+inline bool SendMessage(const int fd, const MessageType type, const std::string& text)
+{
+    return SendMessage(fd, type, text.data(), (uint32_t)text.size());
+}
+
+// Reads the next message into `payload` (which is reused between calls to avoid reallocating).
+// Returns false on a closed connection or a malformed frame.
+inline bool ReceiveMessage(const int fd, MessageType& type, std::vector<char>& payload)
+{
+    FrameHeader header;
+    if (!ReadFully(fd, &header, sizeof(header)))
+        return false;
+    if (header.magic != kMagic || header.length > kMaxPayloadBytes)
+        return false;
+
+    type = static_cast<MessageType>(header.type);
+    payload.resize(header.length);
+    return header.length == 0 || ReadFully(fd, payload.data(), header.length);
+}
+}; // namespace reamp
+
+#endif
@@ -0,0 +1,337 @@
+#include "ReampServer.h"
+#include "ReampProtocol.h"
+#include "NeuralAmpModeler.h"
+#include "NamModelFile.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+struct ReampServer::Session
+{
+    double sampleRate = 48000.0;
+    int maxBlockSize = 512;
+
+    NeuralAmpModeler amp;
+    std::array<std::atomic<float>, NeuralAmpModeler::kNumParameters> params{};
+    juce::AudioBuffer<float> buffer;
+
+    juce::dsp::Convolution cab;
+    std::string irPath;
+    bool cabActive = false;
+
+    std::shared_ptr<const ResidentModel> model;
+};
+
+struct ReampServer::ResidentModel
+{
+    std::string path;
+    std::shared_ptr<const nam::dspData> data;
+};
+
+namespace
+{
+std::map<std::string, std::string> ParseKeyValues(const std::string& text)
+{
+    std::map<std::string, std::string> values;
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        const auto equals = line.find('=');
+        if (equals != std::string::npos)
+            values[line.substr(0, equals)] = line.substr(equals + 1);
+    }
+    return values;
+}
+
+struct ParameterKey
+{
+    const char* name;
+    NeuralAmpModeler::Parameters parameter;
+    float defaultValue;
+};
+
+// Same defaults as the plugin
+const ParameterKey kParameterKeys[] = {
+    {"input", NeuralAmpModeler::kInputLevel, 0.0f},      {"gate", NeuralAmpModeler::kNoiseGateThreshold, -80.0f},
+    {"bass", NeuralAmpModeler::kToneBass, 5.0f},         {"middle", NeuralAmpModeler::kToneMid, 5.0f},
+    {"treble", NeuralAmpModeler::kToneTreble, 5.0f},     {"output", NeuralAmpModeler::kOutputLevel, 0.0f},
+    {"tone_stack", NeuralAmpModeler::kEQActive, 1.0f},   {"normalize", NeuralAmpModeler::kOutNorm, 0.0f},
+};
+}; // namespace
+
+ReampServer::ReampServer(const Options& options)
+    : mOptions(options)
+{
+}
+
+ReampServer::~ReampServer()
+{
+    stop();
+}
+
+bool ReampServer::run()
+{
+    mListenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (mListenFd < 0)
+        return false;
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (mOptions.socketPath.size() >= sizeof(address.sun_path))
+        return false;
+    std::strncpy(address.sun_path, mOptions.socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+    ::unlink(mOptions.socketPath.c_str());
+    if (::bind(mListenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(mListenFd, 16) != 0)
+    {
+        ::close(mListenFd);
+        mListenFd = -1;
+        return false;
+    }
+
+    mStartTime = std::chrono::steady_clock::now();
+    mRunning = true;
+
+    while (mRunning)
+    {
+        const int clientFd = ::accept(mListenFd, nullptr, nullptr);
+        if (clientFd < 0)
+        {
+            if (errno == EINTR && mRunning)
+                continue;
+            break;
+        }
+
+        const std::lock_guard<std::mutex> lock(mClientsMutex);
+        for (const int finished : mFinishedClients)
+        {
+            mClients[finished].join();
+            mClients.erase(finished);
+        }
+        mFinishedClients.clear();
+        mClients[clientFd] = std::thread([this, clientFd] { serveClient(clientFd); });
+    }
+
+    // Wake up the clients and wait for them to go
+    {
+        std::unique_lock<std::mutex> lock(mClientsMutex);
+        for (auto& [fd, thread] : mClients)
+            ::shutdown(fd, SHUT_RDWR);
+        std::map<int, std::thread> clients = std::move(mClients);
+        lock.unlock();
+        for (auto& [fd, thread] : clients)
+            thread.join();
+    }
+
+    {
+        const std::lock_guard<std::mutex> lock(mModelsMutex);
+        mModels.clear();
+    }
+
+    ::close(mListenFd);
+    mListenFd = -1;
+    ::unlink(mOptions.socketPath.c_str());
+    return true;
+}
+
+void ReampServer::stop()
+{
+    mRunning = false;
+    if (mListenFd >= 0)
+        ::shutdown(mListenFd, SHUT_RDWR);
+}
+
+void ReampServer::serveClient(const int fd)
+{
+    std::unique_ptr<Session> session;
+    std::vector<char> payload;
+    reamp::MessageType type;
+
+    while (mRunning && reamp::ReceiveMessage(fd, type, payload))
+    {
+        bool sent = true;
+        switch (type)
+        {
+            case reamp::MessageType::kConfigure:
+            {
+                const std::string error = configure(session, std::string(payload.begin(), payload.end()));
+                sent = error.empty() ? reamp::SendMessage(fd, reamp::MessageType::kAck, std::string())
+                                     : reamp::SendMessage(fd, reamp::MessageType::kError, error);
+                break;
+            }
+            case reamp::MessageType::kAudio:
+            {
+                const int numFrames = (int)(payload.size() / sizeof(float));
+                if (session == nullptr)
+                    sent = reamp::SendMessage(fd, reamp::MessageType::kError, "Send a configuration before any audio");
+                else if (numFrames > session->maxBlockSize)
+                    sent = reamp::SendMessage(fd, reamp::MessageType::kError, "Block is longer than max_block_size");
+                else
+                {
+                    const auto received = std::chrono::steady_clock::now();
+                    std::memcpy(session->buffer.getWritePointer(0), payload.data(), numFrames * sizeof(float));
+                    processBlock(*session, numFrames);
+                    recordLatency(std::chrono::steady_clock::now() - received);
+                    sent = reamp::SendMessage(fd, reamp::MessageType::kAudio, session->buffer.getReadPointer(0), numFrames * sizeof(float));
+                }
+                break;
+            }
+            case reamp::MessageType::kStats: sent = reamp::SendMessage(fd, reamp::MessageType::kStats, getStatsJson()); break;
+            default: sent = reamp::SendMessage(fd, reamp::MessageType::kError, "Unknown message type"); break;
+        }
+
+        if (!sent)
+            break;
+    }
+
+    ::close(fd);
+
+    const std::lock_guard<std::mutex> lock(mClientsMutex);
+    if (mClients.count(fd) > 0)
+        mFinishedClients.push_back(fd);
+}
+
+std::string ReampServer::configure(std::unique_ptr<Session>& session, const std::string& request)
+{
+    auto values = ParseKeyValues(request);
+    if (values["model"].empty())
+        return "No model given";
+
+    try
+    {
+        const double sampleRate = values.count("sample_rate") > 0 ? std::stod(values["sample_rate"]) : 48000.0;
+        const int maxBlockSize = values.count("max_block_size") > 0 ? std::stoi(values["max_block_size"]) : 512;
+        if (sampleRate <= 0.0 || maxBlockSize <= 0 || maxBlockSize * sizeof(float) > reamp::kMaxPayloadBytes)
+            return "Bad sample_rate or max_block_size";
+
+        const bool needNewSession = session == nullptr || session->model->path != values["model"] || session->sampleRate != sampleRate
+                                    || session->maxBlockSize != maxBlockSize;
+        if (needNewSession)
+        {
+            std::shared_ptr<const ResidentModel> model = getModel(values["model"]);
+
+            // Set up on the side, so that if anything fails the stream keeps the session it had
+            auto newSession = std::make_unique<Session>();
+            newSession->sampleRate = sampleRate;
+            newSession->maxBlockSize = maxBlockSize;
+            newSession->buffer.setSize(1, maxBlockSize);
+
+            for (const auto& key : kParameterKeys)
+                newSession->params[key.parameter] = key.defaultValue;
+            newSession->amp.hookParameters(newSession->params);
+
+            newSession->amp.prepare(sampleRate, maxBlockSize);
+            if (!newSession->amp.loadModel(*model->data))
+                return "Failed to build the model";
+
+            juce::dsp::ProcessSpec spec{sampleRate, (juce::uint32)newSession->amp.getInternalBlockSize(), 1};
+            newSession->cab.prepare(spec);
+            newSession->model = std::move(model);
+            session = std::move(newSession);
+        }
+
+        for (const auto& key : kParameterKeys)
+            if (values.count(key.name) > 0)
+                session->params[key.parameter] = std::stof(values[key.name]);
+
+        const std::string irPath = values["ir"];
+        if (irPath != session->irPath)
+        {
+            session->irPath = irPath;
+            if (irPath.empty())
+                session->cab.reset();
+            else
+                session->cab.loadImpulseResponse(juce::File(irPath), juce::dsp::Convolution::Stereo::no, juce::dsp::Convolution::Trim::no, 0,
+                                                 juce::dsp::Convolution::Normalise::yes);
+        }
+        session->cabActive = !irPath.empty() && values["cab"] != "0";
+    }
+    catch (std::exception& e)
+    {
+        return e.what();
+    }
+
+    return {};
+}
+
+void ReampServer::processBlock(Session& session, const int numFrames)
+{
+    // Each stream runs on its own client's thread, so streams run in parallel, on as many cores as there are
+    const auto started = std::chrono::steady_clock::now();
+    session.amp.process(session.buffer.getWritePointer(0), numFrames);
+    mBusyMicros += (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count();
+
+    if (session.cabActive)
+    {
+        juce::dsp::AudioBlock<float> block(session.buffer.getArrayOfWritePointers(), 1, (size_t)numFrames);
+        const int cabBlockSize = session.amp.getInternalBlockSize();
+        for (int offset = 0; offset < numFrames; offset += cabBlockSize)
+        {
+            auto subBlock = block.getSubBlock((size_t)offset, (size_t)std::min(cabBlockSize, numFrames - offset));
+            session.cab.process(juce::dsp::ProcessContextReplacing<float>(subBlock));
+        }
+        session.buffer.applyGain(0, 0, numFrames, juce::Decibels::decibelsToGain(6.0f));
+    }
+
+    mNumBlocks++;
+    mNumSamples += numFrames;
+    mAudioMicros += (uint64_t)(1.0e6 * numFrames / session.sampleRate);
+}
+
+std::shared_ptr<const ReampServer::ResidentModel> ReampServer::getModel(const std::string& modelPath)
+{
+    const std::lock_guard<std::mutex> lock(mModelsMutex);
+    auto it = mModels.find(modelPath);
+    if (it != mModels.end())
+        return it->second;
+
+    auto model = std::make_shared<ResidentModel>();
+    model->path = modelPath;
+    model->data = std::make_shared<const nam::dspData>(ReadNamModel(std::filesystem::u8path(modelPath)));
+    mModels[modelPath] = model;
+    return model;
+}
+
+void ReampServer::recordLatency(const std::chrono::steady_clock::duration latency)
+{
+    const auto micros = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+    mLatencyMicrosTotal += micros;
+    mLatencyHistogram[std::min<uint64_t>(micros / kLatencyBinMicros, kLatencyBins - 1)]++;
+
+    uint64_t previousMax = mLatencyMicrosMax.load();
+    while (micros > previousMax && !mLatencyMicrosMax.compare_exchange_weak(previousMax, micros))
+        ;
+}
+
+std::string ReampServer::getStatsJson() const
+{
+    const uint64_t numBlocks = mNumBlocks.load();
+    const double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - mStartTime).count();
+    const double audioSeconds = mAudioMicros.load() * 1.0e-6;
+    const double busySeconds = mBusyMicros.load() * 1.0e-6;
+
+    auto percentileMs = [this, numBlocks](const double fraction)
+    {
+        uint64_t seen = 0;
+        for (int bin = 0; bin < kLatencyBins; bin++)
+        {
+            seen += mLatencyHistogram[bin].load();
+            if (seen > 0 && seen >= fraction * numBlocks)
+                return (bin + 1) * kLatencyBinMicros * 1.0e-3;
+        }
+        return kLatencyBins * kLatencyBinMicros * 1.0e-3;
+    };
+
+    std::ostringstream json;
+    json << "{\"blocks\":" << numBlocks << ",\"samples\":" << mNumSamples.load() << ",\"latency_ms\":{\"mean\":" << (numBlocks > 0 ? mLatencyMicrosTotal.load() * 1.0e-3 / numBlocks : 0.0)
+         << ",\"p50\":" << percentileMs(0.5) << ",\"p99\":" << percentileMs(0.99) << ",\"max\":" << mLatencyMicrosMax.load() * 1.0e-3 << "}"
+         << ",\"audio_seconds\":" << audioSeconds << ",\"realtime_factor\":" << (wallSeconds > 0.0 ? audioSeconds / wallSeconds : 0.0)
+         << ",\"inference_realtime_factor\":" << (busySeconds > 0.0 ? audioSeconds / busySeconds : 0.0) << "}";
+    return json.str();
+}
@@ -0,0 +1,77 @@
+#ifndef __REAMP_SERVER_H__
+#define __REAMP_SERVER_H__
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Amp simulation as a local service: clients stream mono PCM over a Unix domain socket (see ReampProtocol.h)
+// and get it back through the same NeuralAmpModeler chain that the plugin runs, plus an optional cab IR.
+//
+// Parsed models stay resident for the life of the server and are shared by every stream that uses them; each
+// stream builds its own model from them and runs it on its client's thread.
+class ReampServer
+{
+public:
+    struct Options
+    {
+        std::string socketPath = "/tmp/nam-reamp.sock";
+    };
+
+    explicit ReampServer (const Options& options);
+    ~ReampServer ();
+
+    // Serves clients until stop() is called. Returns false if the socket couldn't be set up.
+    bool run ();
+    // Safe to call from any thread (or a signal handler's helper thread)
+    void stop ();
+
+    std::string getStatsJson () const;
+
+private:
+    struct Session;
+    struct ResidentModel;
+
+    void serveClient (const int fd);
+    // Returns an error message, or an empty string on success
+    std::string configure (std::unique_ptr<Session>& session, const std::string& request);
+    void processBlock (Session& session, const int numFrames);
+
+    // Resident model for this path, parsing it if needed. Throws if the model can't be read.
+    std::shared_ptr<const ResidentModel> getModel (const std::string& modelPath);
+
+    void recordLatency (const std::chrono::steady_clock::duration latency);
+
+    Options mOptions;
+    int mListenFd = -1;
+    std::atomic<bool> mRunning{false};
+
+    std::mutex mModelsMutex;
+    std::map<std::string, std::shared_ptr<const ResidentModel>> mModels;
+
+    std::mutex mClientsMutex;
+    std::map<int, std::thread> mClients;
+    std::vector<int> mFinishedClients;
+
+    // Statistics
+    static constexpr int kLatencyBins = 200;
+    static constexpr int kLatencyBinMicros = 100;
+    std::chrono::steady_clock::time_point mStartTime;
+    std::atomic<uint64_t> mNumBlocks{0};
+    std::atomic<uint64_t> mNumSamples{0};
+    std::atomic<uint64_t> mAudioMicros{0};
+    std::atomic<uint64_t> mBusyMicros{0};
+    std::atomic<uint64_t> mLatencyMicrosTotal{0};
+    std::atomic<uint64_t> mLatencyMicrosMax{0};
+    std::array<std::atomic<uint64_t>, kLatencyBins> mLatencyHistogram{};
+};
+
+#endif
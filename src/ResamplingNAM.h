@@ -8,7 +8,9 @@ namespace iplug
 static const double PI = 3.1415926535897931;
 };
 
+#include <algorithm> // min
 #include <cmath> // pow
+#include <cstddef> // size_t
 #include <dsp.h>
 #include <ResamplingContainer.h>
 
@@ -25,6 +27,41 @@ static inline double GetNAMSampleRate(const std::unique_ptr<nam::DSP>& model)
     return encapsulatedSampleRate;
 };
 
+// Get how many samples of input a NAM model can remember, at the model's own sample rate.
+// Recurrent models don't have a finite receptive field; for those this returns the half second that the core
+// prewarms them with, which is long enough for them to settle.
+static inline int GetNAMReceptiveField(const nam::dspData& modelData)
+{
+    const nlohmann::json& config = modelData.config;
+    const double sampleRate = modelData.expected_sample_rate <= 0.0 ? 48000.0 : modelData.expected_sample_rate;
+
+    if (modelData.architecture == "Linear")
+        return config["receptive_field"].get<int>();
+
+    if (modelData.architecture == "ConvNet")
+    {
+        // ConvNet blocks all use a kernel size of 2
+        int receptiveField = 1;
+        for (const auto& dilation : config["dilations"])
+            receptiveField += dilation.get<int>();
+        return receptiveField;
+    }
+
+    if (modelData.architecture == "WaveNet")
+    {
+        int receptiveField = 1;
+        for (const auto& layerArray : config["layers"])
+        {
+            const int kernelSize = layerArray["kernel_size"].get<int>();
+            for (const auto& dilation : layerArray["dilations"])
+                receptiveField += (kernelSize - 1) * dilation.get<int>();
+        }
+        return receptiveField;
+    }
+
+    return static_cast<int>(0.5 * sampleRate);
+};
+
 class ResamplingNAM : public nam::DSP
 {
 public:
@@ -59,18 +96,22 @@ public:
 
     void process(NAM_SAMPLE* input, NAM_SAMPLE* output, const int num_frames) override
     {
-
-        if (num_frames > mMaxExternalBlockSize)
-            // We can afford to be careful
-            throw std::runtime_error("More frames were provided than the max expected!");
-
-        if (!NeedToResample())
+        // Hosts don't always keep their promises about block sizes; split anything bigger than we were reset for
+        // instead of failing.
+        for (int offset = 0; offset < num_frames; offset += mMaxExternalBlockSize)
         {
-            mEncapsulated->process(input, output, num_frames);
-        }
-        else
-        {
-            mResampler.ProcessBlock(&input, &output, num_frames, mBlockProcessFunc);
+            NAM_SAMPLE* inputChunk = input + offset;
+            NAM_SAMPLE* outputChunk = output + offset;
+            const int numChunkFrames = std::min(mMaxExternalBlockSize, num_frames - offset);
+
+            if (!NeedToResample())
+            {
+                mEncapsulated->process(inputChunk, outputChunk, numChunkFrames);
+            }
+            else
+            {
+                mResampler.ProcessBlock(&inputChunk, &outputChunk, numChunkFrames, mBlockProcessFunc);
+            }
         }
 
         // Prepare for external call to .finalize_()
@@ -79,6 +120,14 @@ public:
 
     int GetLatency() const { return NeedToResample() ? mResampler.GetLatency() : 0; };
 
+    // How long the model keeps responding after its input goes silent
+    void SetReceptiveField(const int numEncapsulatedSamples) { mReceptiveField = numEncapsulatedSamples; };
+    double GetTailSeconds() const { return mReceptiveField / GetEncapsulatedSampleRate(); };
+
+    // Rough size of the model in memory, for reporting what freeing it gives back
+    void SetMemoryBytes(const size_t bytes) { mMemoryBytes = bytes; };
+    size_t GetMemoryBytes() const { return mMemoryBytes; };
+
     void Reset(const double sampleRate, const int maxBlockSize) override
     {
         mExpectedSampleRate = sampleRate;
@@ -117,6 +166,9 @@ private:
     // Keep track of how many frames were processed so that we can be sure that finalize_() is being used correctly.
     // This is kind of hacky, but I'm not sure I want to rethink the core right now.
     int lastNumExternalFramesProcessed = -1;
+    // Receptive field of the encapsulated model, in its own samples
+    int mReceptiveField = 0;
+    size_t mMemoryBytes = 0;
 
     // This function is defined to conform to the interface expected by the iPlug2 resampler.
     std::function<void(NAM_SAMPLE**, NAM_SAMPLE**, int)> mBlockProcessFunc;
@@ -0,0 +1,473 @@
+#include "RingWaveNet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+// What the arena aligns to
+const size_t kAlignFloats = DSPArena::kAlignment / sizeof(float);
+
+int NextPowerOfTwo(const int value)
+{
+    int result = 1;
+    while (result < value)
+        result *= 2;
+    return result;
+}
+
+void ReadMatrix(Eigen::MatrixXf& matrix, std::vector<float>::const_iterator& weights)
+{
+    for (int i = 0; i < matrix.rows(); i++)
+        for (int j = 0; j < matrix.cols(); j++)
+            matrix(i, j) = *(weights++);
+}
+
+void ReadVector(Eigen::VectorXf& vector, std::vector<float>::const_iterator& weights)
+{
+    for (int i = 0; i < vector.size(); i++)
+        vector(i) = *(weights++);
+}
+
+Eigen::MatrixXf Select(const Eigen::MatrixXf& matrix, const std::vector<int>& rows, const std::vector<int>& cols)
+{
+    Eigen::MatrixXf result(rows.size(), cols.size());
+    for (size_t i = 0; i < rows.size(); i++)
+        for (size_t j = 0; j < cols.size(); j++)
+            result(i, j) = matrix(rows[i], cols[j]);
+    return result;
+}
+
+Eigen::VectorXf Select(const Eigen::VectorXf& vector, const std::vector<int>& rows)
+{
+    Eigen::VectorXf result(rows.size());
+    for (size_t i = 0; i < rows.size(); i++)
+        result(i) = vector(rows[i]);
+    return result;
+}
+
+std::vector<int> AllOf(const int size)
+{
+    std::vector<int> indices(size);
+    for (int i = 0; i < size; i++)
+        indices[i] = i;
+    return indices;
+}
+
+std::vector<int> LiveOf(const std::vector<bool>& live)
+{
+    std::vector<int> indices;
+    for (size_t i = 0; i < live.size(); i++)
+        if (live[i])
+            indices.push_back((int)i);
+    return indices;
+}
+}; // namespace
+
+RingWaveNet::RingWaveNet(const std::vector<LayerArrayParams>& params, const std::vector<float>& weights, const double expectedSampleRate,
+                         const float pruneThreshold, const bool hugePages)
+    : nam::DSP(expectedSampleRate)
+{
+    auto it = weights.begin();
+    for (size_t a = 0; a < params.size(); a++)
+    {
+        const LayerArrayParams& p = params[a];
+        if (a > 0 && p.channels != params[a - 1].headSize)
+        {
+            std::stringstream ss;
+            ss << "channels of layer " << a << " (" << p.channels << ") doesn't match head_size of preceding layer (" << params[a - 1].headSize
+               << "!\n";
+            throw std::runtime_error(ss.str().c_str());
+        }
+
+        LayerArray layerArray;
+        layerArray.channels = p.channels;
+        layerArray.kernelSize = p.kernelSize;
+
+        // Same order as the core: rechannel, then each layer's dilated conv (weights, bias), input mixin and 1x1
+        // (weights, bias), then the head rechannel
+        layerArray.rechannelWeights.resize(p.channels, p.inputSize);
+        ReadMatrix(layerArray.rechannelWeights, it);
+
+        for (const int dilation : p.dilations)
+        {
+            Layer layer;
+            layer.dilation = dilation;
+            layer.convWeights.assign(p.kernelSize, Eigen::MatrixXf(p.channels, p.channels));
+            // Flattened output channel, then input channel, then tap
+            for (int i = 0; i < p.channels; i++)
+                for (int j = 0; j < p.channels; j++)
+                    for (int k = 0; k < p.kernelSize; k++)
+                        layer.convWeights[k](i, j) = *(it++);
+            layer.convBias.resize(p.channels);
+            ReadVector(layer.convBias, it);
+            layer.mixinWeights.resize(p.channels, p.conditionSize);
+            ReadMatrix(layer.mixinWeights, it);
+            layer.outputWeights.resize(p.channels, p.channels);
+            ReadMatrix(layer.outputWeights, it);
+            layer.outputBias.resize(p.channels);
+            ReadVector(layer.outputBias, it);
+            layer.activation = nam::activations::Activation::get_activation(p.activation);
+            if (layer.activation == nullptr)
+                throw std::runtime_error("Unknown activation " + p.activation);
+            layer.zRows = p.channels;
+            layerArray.layers.push_back(std::move(layer));
+        }
+
+        layerArray.headWeights.resize(p.headSize, p.channels);
+        ReadMatrix(layerArray.headWeights, it);
+        if (p.headBias)
+        {
+            layerArray.headBias.resize(p.headSize);
+            ReadVector(layerArray.headBias, it);
+        }
+
+        if (a == 0)
+            mHeadRows.push_back(p.channels);
+        mHeadRows.push_back(p.headSize);
+
+        int receptiveField = 0;
+        for (const int dilation : p.dilations)
+            receptiveField += dilation * (p.kernelSize - 1);
+        mPrewarmSamples += receptiveField;
+
+        mLayerArrays.push_back(std::move(layerArray));
+    }
+
+    mHeadScale = *(it++);
+    if (it != weights.end())
+        throw std::runtime_error("Weight mismatch: WaveNet didn't use all of the weights");
+    if (mHeadRows.empty() || mHeadRows.back() != 1)
+        throw std::runtime_error("WaveNet must have a mono output");
+
+    mPruneStats.flopsBefore = this->CountFlops();
+    if (pruneThreshold >= 0.0f)
+        this->Prune(pruneThreshold);
+    mPruneStats.flopsAfter = this->CountFlops();
+    this->PackWeights(hugePages);
+
+    // Lay out the state for what's left
+    for (LayerArray& layerArray : mLayerArrays)
+    {
+        int maxZRows = 0;
+        for (Layer& layer : layerArray.layers)
+        {
+            // Enough to reach back over all the taps from anywhere in the newest chunk
+            layer.ringSize = NextPowerOfTwo(layer.dilation * (layerArray.kernelSize - 1) + kMaxChunkFrames);
+            layer.ringOffset = this->Reserve(layerArray.channels, layer.ringSize + kMaxChunkFrames);
+            maxZRows = std::max(maxZRows, layer.zRows);
+        }
+        layerArray.convOutputOffset = this->Reserve(maxZRows, kMaxChunkFrames);
+        layerArray.outputOffset = this->Reserve(layerArray.channels, kMaxChunkFrames);
+    }
+
+    mConditionOffset = this->Reserve(params[0].conditionSize, kMaxChunkFrames);
+    for (const int rows : mHeadRows)
+        mHeadOffsets.push_back(this->Reserve(rows, kMaxChunkFrames));
+
+    // Everything starts out silent, like the core's zeroed buffers. The arena's block starts on a cache line, and
+    // Reserve() keeps every buffer in it on one too.
+    mArena.Build([this](DSPArena& arena) { mArenaStart = arena.Allocate<float>(mArenaSize); });
+}
+
+void RingWaveNet::Prune(const float threshold)
+{
+    const size_t numArrays = mLayerArrays.size();
+    const auto isZero = [threshold](const float weight) { return std::fabs(weight) <= threshold; };
+
+    std::vector<std::vector<bool>> residualLive(numArrays);
+    std::vector<std::vector<std::vector<bool>>> zLive(numArrays);
+    for (size_t a = 0; a < numArrays; a++)
+    {
+        const LayerArray& layerArray = mLayerArrays[a];
+        residualLive[a].assign(layerArray.channels, true);
+        zLive[a].assign(layerArray.layers.size(), std::vector<bool>(layerArray.channels, true));
+    }
+
+    // Taking one channel out can leave another with nothing to read from or write to, so go until nothing changes
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (size_t a = 0; a < numArrays; a++)
+        {
+            const LayerArray& layerArray = mLayerArrays[a];
+            const int channels = layerArray.channels;
+
+            // A residual channel that nothing writes is zero all the way through; one that nothing reads doesn't
+            // matter. The last array's residual output goes nowhere.
+            for (int c = 0; c < channels; c++)
+            {
+                if (!residualLive[a][c])
+                    continue;
+
+                bool written = false;
+                for (int j = 0; j < layerArray.rechannelWeights.cols(); j++)
+                    written = written || ((a == 0 || residualLive[a - 1][j]) && !isZero(layerArray.rechannelWeights(c, j)));
+                bool read = false;
+                for (size_t l = 0; l < layerArray.layers.size(); l++)
+                {
+                    const Layer& layer = layerArray.layers[l];
+                    written = written || !isZero(layer.outputBias(c));
+                    for (int i = 0; i < channels; i++)
+                    {
+                        if (!zLive[a][l][i])
+                            continue;
+                        written = written || !isZero(layer.outputWeights(c, i));
+                        for (const Eigen::MatrixXf& tap : layer.convWeights)
+                            read = read || !isZero(tap(i, c));
+                    }
+                }
+                if (a + 1 < numArrays)
+                    for (int r = 0; r < mLayerArrays[a + 1].channels; r++)
+                        read = read || (residualLive[a + 1][r] && !isZero(mLayerArrays[a + 1].rechannelWeights(r, c)));
+
+                if (!written || !read)
+                {
+                    residualLive[a][c] = false;
+                    changed = true;
+                }
+            }
+
+            // A z row is dead if it's always zero (nothing in, no bias, and an activation that keeps zero at zero),
+            // or if neither the head nor the residual takes anything from it
+            for (size_t l = 0; l < layerArray.layers.size(); l++)
+            {
+                const Layer& layer = layerArray.layers[l];
+                float activatedZero = 0.0f;
+                layer.activation->apply(&activatedZero, 1);
+
+                for (int i = 0; i < channels; i++)
+                {
+                    if (!zLive[a][l][i])
+                        continue;
+
+                    bool fed = !isZero(layer.convBias(i)) || activatedZero != 0.0f;
+                    for (int j = 0; j < layer.mixinWeights.cols(); j++)
+                        fed = fed || !isZero(layer.mixinWeights(i, j));
+                    for (int c = 0; c < channels; c++)
+                        for (const Eigen::MatrixXf& tap : layer.convWeights)
+                            fed = fed || (residualLive[a][c] && !isZero(tap(i, c)));
+
+                    bool used = false;
+                    for (int h = 0; h < layerArray.headWeights.rows(); h++)
+                        used = used || !isZero(layerArray.headWeights(h, i));
+                    for (int c = 0; c < channels; c++)
+                        used = used || (residualLive[a][c] && !isZero(layer.outputWeights(c, i)));
+
+                    if (!fed || !used)
+                    {
+                        zLive[a][l][i] = false;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+
+    // Rebuild the matrices from what's left
+    std::vector<int> previousResidual = AllOf((int)mLayerArrays[0].rechannelWeights.cols());
+    for (size_t a = 0; a < numArrays; a++)
+    {
+        LayerArray& layerArray = mLayerArrays[a];
+        const int channels = layerArray.channels;
+        const std::vector<int> residual = LiveOf(residualLive[a]);
+
+        layerArray.rechannelWeights = Select(layerArray.rechannelWeights, residual, previousResidual);
+        for (size_t l = 0; l < layerArray.layers.size(); l++)
+        {
+            Layer& layer = layerArray.layers[l];
+            const std::vector<int> z = LiveOf(zLive[a][l]);
+            for (Eigen::MatrixXf& tap : layer.convWeights)
+                tap = Select(tap, z, residual);
+            layer.convBias = Select(layer.convBias, z);
+            layer.mixinWeights = Select(layer.mixinWeights, z, AllOf((int)layer.mixinWeights.cols()));
+            layer.outputWeights = Select(layer.outputWeights, residual, z);
+            layer.outputBias = Select(layer.outputBias, residual);
+            layer.zRows = (int)z.size();
+            layer.headRows = (int)z.size() < channels ? z : std::vector<int>();
+            mPruneStats.layerChannelsRemoved += channels - (int)z.size();
+        }
+
+        layerArray.channels = (int)residual.size();
+        mPruneStats.residualChannelsRemoved += channels - (int)residual.size();
+        previousResidual = residual;
+    }
+}
+
+void RingWaveNet::PackWeights(const bool hugePages)
+{
+    mWeights.SetHugePages(hugePages);
+    mWeights.Build(
+        [this](DSPArena& arena)
+        {
+            for (LayerArray& layerArray : mLayerArrays)
+            {
+                const int channels = layerArray.channels;
+                layerArray.rechannel = PackedMatrix::Pack(arena, layerArray.rechannelWeights);
+                for (Layer& layer : layerArray.layers)
+                {
+                    const int kernelSize = static_cast<int>(layer.convWeights.size());
+                    Eigen::MatrixXf conv(layer.zRows, kernelSize * channels + layer.mixinWeights.cols());
+                    for (int k = 0; k < kernelSize; k++)
+                        conv.middleCols(k * channels, channels) = layer.convWeights[k];
+                    conv.rightCols(layer.mixinWeights.cols()) = layer.mixinWeights;
+                    layer.conv = PackedMatrix::Pack(arena, conv, layer.convBias.data());
+                    layer.output = PackedMatrix::Pack(arena, layer.outputWeights, layer.outputBias.data());
+                }
+                layerArray.head = PackedMatrix::Pack(arena, layerArray.headWeights, layerArray.headBias.size() > 0 ? layerArray.headBias.data() : nullptr);
+            }
+        });
+
+    for (LayerArray& layerArray : mLayerArrays)
+    {
+        for (Layer& layer : layerArray.layers)
+        {
+            layer.convInputs.assign(layer.convWeights.size(), {nullptr, layerArray.channels});
+            layer.convInputs.push_back({nullptr, static_cast<int>(layer.mixinWeights.cols())});
+            layer.convWeights.clear();
+            layer.convBias.resize(0);
+            layer.mixinWeights.resize(0, 0);
+            layer.outputWeights.resize(0, 0);
+            layer.outputBias.resize(0);
+        }
+        layerArray.rechannelWeights.resize(0, 0);
+        layerArray.headWeights.resize(0, 0);
+        layerArray.headBias.resize(0);
+    }
+}
+
+int64_t RingWaveNet::CountFlops() const
+{
+    int64_t multiplies = 0;
+    for (const LayerArray& layerArray : mLayerArrays)
+    {
+        multiplies += layerArray.rechannelWeights.size() + layerArray.headWeights.size();
+        for (const Layer& layer : layerArray.layers)
+        {
+            for (const Eigen::MatrixXf& tap : layer.convWeights)
+                multiplies += tap.size();
+            multiplies += layer.mixinWeights.size() + layer.outputWeights.size();
+        }
+    }
+    // A multiply and an add each
+    return 2 * multiplies;
+}
+
+size_t RingWaveNet::Reserve(const int rows, const int cols)
+{
+    const size_t offset = mArenaSize;
+    const size_t size = static_cast<size_t>(rows) * cols;
+    mArenaSize = offset + (size + kAlignFloats - 1) / kAlignFloats * kAlignFloats;
+    return offset;
+}
+
+Eigen::Map<Eigen::MatrixXf> RingWaveNet::ArenaMatrix(const size_t offset, const int rows, const int cols)
+{
+    return Eigen::Map<Eigen::MatrixXf>(mArenaStart + offset, rows, cols);
+}
+
+Eigen::Map<Eigen::MatrixXf> RingWaveNet::RingWindow(const Layer& layer, const int channels, const int64_t position, const int numFrames)
+{
+    // Works for negative positions too (before the first sample), which is the silent history
+    const int64_t column = position & (layer.ringSize - 1);
+    return Eigen::Map<Eigen::MatrixXf>(mArenaStart + layer.ringOffset + column * channels, channels, numFrames);
+}
+
+void RingWaveNet::SyncMirror(const Layer& layer, const int channels, const int64_t position, const int numFrames)
+{
+    float* ring = mArenaStart + layer.ringOffset;
+    const int64_t start = position & (layer.ringSize - 1);
+    for (int64_t column = start; column < start + numFrames; column++)
+    {
+        // Written into the mirror: update the original. Written near the start: update the mirror.
+        if (column >= layer.ringSize)
+            std::memcpy(ring + (column - layer.ringSize) * channels, ring + column * channels, channels * sizeof(float));
+        else if (column < kMaxChunkFrames)
+            std::memcpy(ring + (column + layer.ringSize) * channels, ring + column * channels, channels * sizeof(float));
+    }
+}
+
+void RingWaveNet::process(NAM_SAMPLE* input, NAM_SAMPLE* output, const int num_frames)
+{
+    for (int offset = 0; offset < num_frames; offset += kMaxChunkFrames)
+        this->ProcessChunk(input + offset, output + offset, std::min(kMaxChunkFrames, num_frames - offset));
+}
+
+void RingWaveNet::ProcessChunk(const NAM_SAMPLE* input, NAM_SAMPLE* output, const int numFrames)
+{
+    auto condition = this->ArenaMatrix(mConditionOffset, 1, numFrames);
+    for (int i = 0; i < numFrames; i++)
+        condition(0, i) = static_cast<float>(input[i]);
+
+    this->ArenaMatrix(mHeadOffsets[0], mHeadRows[0], numFrames).setZero();
+
+    for (size_t a = 0; a < mLayerArrays.size(); a++)
+    {
+        LayerArray& layerArray = mLayerArrays[a];
+        const int channels = layerArray.channels;
+        auto head = this->ArenaMatrix(mHeadOffsets[a], mHeadRows[a], numFrames);
+        auto arrayOutput = this->ArenaMatrix(layerArray.outputOffset, channels, numFrames);
+
+        // The first layer's input
+        float* firstInput = this->RingWindow(layerArray.layers[0], channels, mPosition, numFrames).data();
+        if (a == 0)
+            layerArray.rechannel.Multiply({condition.data(), 1}, firstInput, numFrames);
+        else
+        {
+            const LayerArray& previous = mLayerArrays[a - 1];
+            layerArray.rechannel.Multiply({mArenaStart + previous.outputOffset, previous.channels}, firstInput, numFrames);
+        }
+        this->SyncMirror(layerArray.layers[0], channels, mPosition, numFrames);
+
+        for (size_t l = 0; l < layerArray.layers.size(); l++)
+        {
+            Layer& layer = layerArray.layers[l];
+            const int kernelSize = layerArray.kernelSize;
+            auto z = this->ArenaMatrix(layerArray.convOutputOffset, layer.zRows, numFrames);
+
+            // Dilated conv straight out of the ring, the mixin and the bias, in one go
+            for (int k = 0; k < kernelSize; k++)
+            {
+                const int64_t tapPosition = mPosition - static_cast<int64_t>(layer.dilation) * (kernelSize - 1 - k);
+                layer.convInputs[k].data = this->RingWindow(layer, channels, tapPosition, numFrames).data();
+            }
+            layer.convInputs[kernelSize].data = condition.data();
+            layer.conv.Multiply(layer.convInputs.data(), kernelSize + 1, z.data(), numFrames);
+
+            layer.activation->apply(z.data(), static_cast<long>(z.size()));
+            if (layer.headRows.empty())
+                head += z;
+            else
+                for (int i = 0; i < layer.zRows; i++)
+                    head.row(layer.headRows[i]) += z.row(i);
+
+            // Residual: into the next layer's history, or out of the array after the last layer
+            const float* layerInput = this->RingWindow(layer, channels, mPosition, numFrames).data();
+            if (l + 1 < layerArray.layers.size())
+            {
+                const Layer& next = layerArray.layers[l + 1];
+                float* nextInput = this->RingWindow(next, channels, mPosition, numFrames).data();
+                layer.output.Multiply({z.data(), layer.zRows}, nextInput, numFrames, layerInput);
+                this->SyncMirror(next, channels, mPosition, numFrames);
+            }
+            else
+            {
+                layer.output.Multiply({z.data(), layer.zRows}, arrayOutput.data(), numFrames, layerInput);
+            }
+        }
+
+        auto nextHead = this->ArenaMatrix(mHeadOffsets[a + 1], mHeadRows[a + 1], numFrames);
+        layerArray.head.Multiply({head.data(), mHeadRows[a]}, nextHead.data(), numFrames);
+    }
+
+    const auto finalHead = this->ArenaMatrix(mHeadOffsets.back(), 1, numFrames);
+    for (int i = 0; i < numFrames; i++)
+        output[i] = static_cast<NAM_SAMPLE>(mHeadScale * finalHead(0, i));
+
+    mPosition += numFrames;
+}
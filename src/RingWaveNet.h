@@ -0,0 +1,159 @@
+#ifndef __RING_WAVENET_H__
+#define __RING_WAVENET_H__
+
+#include "DSPArena.h"
+#include "PackedMatrix.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <activations.h>
+#include <dsp.h>
+
+// Drop-in for the core's nam::wavenet::WaveNet (without the unused post-head, and without gated layers) that
+// keeps each layer's input history in a ring instead of a long buffer that gets rewound.
+//
+// Every ring is a power of two long, so a position is just masked, and is followed by a mirror of its first
+// kMaxChunkFrames columns, so a window of up to kMaxChunkFrames columns starting anywhere in the ring is
+// contiguous: dilated taps read straight out of the ring and nothing ever gets copied back to the start.
+// All the state (rings and scratch) sits in one 64-byte aligned arena, sized when the model is built.
+//
+// Reads the same weights in the same order and does the same arithmetic as the core, so the output matches
+// it up to float rounding.
+//
+// Optionally, channels that can't affect the output are taken out when the model is built (see Prune()): models
+// are often trained wider than they need to be, and what's left is just smaller matrices.
+//
+// What's left is then packed (see PackedMatrix.h) into one arena of its own, in the order the chunk loop uses it,
+// with the biases folded in. A layer's dilated conv and input mixin are one matrix, done in one pass.
+class RingWaveNet : public nam::DSP
+{
+public:
+    struct LayerArrayParams
+    {
+        int inputSize;
+        int conditionSize;
+        int headSize;
+        int channels;
+        int kernelSize;
+        std::vector<int> dilations;
+        std::string activation;
+        bool headBias;
+    };
+
+    // What pruning took out
+    struct PruneStats
+    {
+        // Per sample, of the matrix products
+        int64_t flopsBefore = 0;
+        int64_t flopsAfter = 0;
+        // Channels of the residual stream between layers, and of the layers' own outputs (z)
+        int residualChannelsRemoved = 0;
+        int layerChannelsRemoved = 0;
+    };
+
+    // Channels are pruned if pruneThreshold is 0 or more: weights no bigger than it count as zero. At 0, only
+    // channels that are exactly dead go, and the output only changes by float rounding. hugePages asks for the
+    // weights to be on huge pages, if there are enough of them (see DSPArena).
+    RingWaveNet (const std::vector<LayerArrayParams>& params, const std::vector<float>& weights, const double expectedSampleRate,
+                 const float pruneThreshold = -1.0f, const bool hugePages = false);
+
+    void process (NAM_SAMPLE* input, NAM_SAMPLE* output, const int num_frames) override;
+
+    // Size of everything the model keeps between and during blocks, apart from its weights
+    size_t GetStateBytes () const { return mArena.GetUsedBytes(); };
+    // Of the packed weights, padding included
+    size_t GetWeightBytes () const { return mWeights.GetUsedBytes(); };
+    const PruneStats& GetPruneStats () const { return mPruneStats; };
+
+protected:
+    int PrewarmSamples () override { return mPrewarmSamples; };
+
+private:
+    // Longest stretch processed in one go; longer blocks are split
+    static constexpr int kMaxChunkFrames = 256;
+
+    struct Layer
+    {
+        int dilation;
+        // As read, and pruned; emptied once they're packed
+        // One channels x channels matrix per tap, oldest first
+        std::vector<Eigen::MatrixXf> convWeights;
+        Eigen::VectorXf convBias;
+        Eigen::MatrixXf mixinWeights;
+        Eigen::MatrixXf outputWeights;
+        Eigen::VectorXf outputBias;
+        // The taps side by side, then the mixin, and the conv's bias
+        PackedMatrix conv;
+        // With its bias
+        PackedMatrix output;
+        // What conv reads: the taps' windows of the ring (filled in for every chunk), then the condition
+        std::vector<PackedMatrix::Input> convInputs;
+        nam::activations::Activation* activation;
+        // Rows of z (the conv output) that are left, and which rows of the head they add into; empty if that's
+        // all of them in order
+        int zRows;
+        std::vector<int> headRows;
+
+        // History of this layer's input: channels x (ringSize + kMaxChunkFrames)
+        int ringSize;
+        size_t ringOffset;
+    };
+
+    struct LayerArray
+    {
+        // Of the residual stream, after pruning
+        int channels;
+        int kernelSize;
+        // As read, and pruned; emptied once they're packed
+        Eigen::MatrixXf rechannelWeights;
+        Eigen::MatrixXf headWeights;
+        Eigen::VectorXf headBias; // Empty if there's none
+        PackedMatrix rechannel;
+        PackedMatrix head;
+        std::vector<Layer> layers;
+
+        // Scratch: channels x kMaxChunkFrames each
+        size_t convOutputOffset;
+        size_t outputOffset;
+    };
+
+    // Takes out the residual channels that are never written or never read, and the z rows that are always zero
+    // or go nowhere, until there's nothing more to take out
+    void Prune (const float threshold);
+    // Packs what's left into mWeights, and lets go of the matrices it came from
+    void PackWeights (const bool hugePages);
+    int64_t CountFlops () const;
+
+    // Reserves room for rows x cols floats in the arena, 64-byte aligned, and returns its offset
+    size_t Reserve (const int rows, const int cols);
+    Eigen::Map<Eigen::MatrixXf> ArenaMatrix (const size_t offset, const int rows, const int cols);
+    // numFrames columns of a layer's history, starting at an absolute sample position
+    Eigen::Map<Eigen::MatrixXf> RingWindow (const Layer& layer, const int channels, const int64_t position, const int numFrames);
+    // Copies columns that were just written into the ring to their other copy, if they have one
+    void SyncMirror (const Layer& layer, const int channels, const int64_t position, const int numFrames);
+
+    void ProcessChunk (const NAM_SAMPLE* input, NAM_SAMPLE* output, const int numFrames);
+
+    std::vector<LayerArray> mLayerArrays;
+    float mHeadScale = 0.0f;
+    int mPrewarmSamples = 1;
+    PruneStats mPruneStats;
+    DSPArena mWeights;
+
+    // The state, laid out by Reserve() as offsets from mArenaStart, in floats
+    DSPArena mArena;
+    float* mArenaStart = nullptr;
+    size_t mArenaSize = 0;
+    size_t mConditionOffset = 0;
+    // Head accumulators: one for each layer array's input, plus the final output
+    std::vector<size_t> mHeadOffsets;
+    std::vector<int> mHeadRows;
+
+    // Absolute position of the next sample to be written
+    int64_t mPosition = 0;
+};
+
+#endif
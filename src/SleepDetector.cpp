@@ -0,0 +1,74 @@
+#include "SleepDetector.h"
+
+#include <cmath>
+
+void SleepDetector::Reset(const double sampleRate)
+{
+    this->mSampleRate = sampleRate;
+    this->mAsleep = false;
+    this->mQuietSamples = 0;
+}
+
+void SleepDetector::SetThresholdDB(const double thresholdDB)
+{
+    // Called on every block
+    if (thresholdDB == this->mThresholdDB)
+        return;
+    this->mThresholdDB = thresholdDB;
+    this->mThresholdLinear = static_cast<float>(std::pow(10.0, thresholdDB / 20.0));
+}
+
+bool SleepDetector::ShouldSleep(const float inputPeak, const int numFrames)
+{
+    if (!this->mEnabled)
+    {
+        this->mAsleep = false;
+        this->mQuietSamples = 0;
+    }
+    else if (this->mAsleep && inputPeak > this->mThresholdLinear)
+    {
+        // Wake up and process this block
+        this->mAsleep = false;
+        this->mQuietSamples = 0;
+    }
+
+    this->CountFrames(numFrames, this->mAsleep);
+    return this->mAsleep;
+}
+
+void SleepDetector::Update(const double inputLevelDB, const float outputPeak, const int numFrames)
+{
+    if (!this->mEnabled)
+        return;
+
+    if (inputLevelDB < this->mThresholdDB && outputPeak < this->mThresholdLinear)
+        this->mQuietSamples += numFrames;
+    else
+        this->mQuietSamples = 0;
+
+    const auto tailSamples = static_cast<int64_t>(std::ceil(this->mTailSeconds * this->mSampleRate));
+    if (this->mQuietSamples > tailSamples)
+        this->mAsleep = true;
+}
+
+double SleepDetector::GetSecondsAsleep() const
+{
+    return static_cast<double>(this->mNanosecondsAsleep.load(std::memory_order_relaxed)) * 1e-9;
+}
+
+double SleepDetector::GetFractionAsleep() const
+{
+    const int64_t total = this->mNanosecondsTotal.load(std::memory_order_relaxed);
+    if (total == 0)
+        return 0.0;
+
+    return static_cast<double>(this->mNanosecondsAsleep.load(std::memory_order_relaxed)) / static_cast<double>(total);
+}
+
+void SleepDetector::CountFrames(const int numFrames, const bool asleep)
+{
+    const auto nanoseconds = static_cast<int64_t>(std::llround(numFrames * 1e9 / this->mSampleRate));
+    this->mNanosecondsTotal.fetch_add(nanoseconds, std::memory_order_relaxed);
+    if (asleep)
+        this->mNanosecondsAsleep.fetch_add(nanoseconds, std::memory_order_relaxed);
+}
@@ -0,0 +1,55 @@
+#ifndef __SLEEP_DETECTOR_H__
+#define __SLEEP_DETECTOR_H__
+
+#include <atomic>
+#include <cstdint>
+
+// Decides when an instance can stop running its DSP because nothing is coming in and nothing is ringing out.
+// The instance falls asleep once the input level and the output tail have both stayed under the threshold for
+// longer than the chain's tail (model receptive field plus IR length), and wakes on the first block whose input
+// peak crosses the threshold again. Since the chain was fed silence for longer than it can remember before
+// sleeping, its internal state is already the "silent" state when it wakes up.
+class SleepDetector
+{
+public:
+    void Reset (const double sampleRate);
+
+    void SetEnabled (const bool enabled) { this->mEnabled = enabled; };
+    // Of the input as the chain sees it (after any input gain), and of the output. Cheap if it hasn't changed.
+    void SetThresholdDB (const double thresholdDB);
+    // How long the chain keeps ringing after its input goes silent, in seconds.
+    void SetTailSeconds (const double tailSeconds) { this->mTailSeconds = tailSeconds; };
+
+    // Call at the start of the block with the block's input peak (linear), after the input gain.
+    // Returns true if the block can be skipped entirely (the caller outputs silence).
+    bool ShouldSleep (const float inputPeak, const int numFrames);
+
+    // Call after a processed block with the input level (dB, after the input gain) and the peak of the output (linear).
+    void Update (const double inputLevelDB, const float outputPeak, const int numFrames);
+
+    bool IsAsleep () const { return this->mAsleep; };
+
+    // Safe to call from any thread
+    double GetSecondsAsleep () const;
+    double GetFractionAsleep () const;
+
+private:
+    void CountFrames (const int numFrames, const bool asleep);
+
+    double mSampleRate = 48000.0;
+    double mThresholdDB = -90.0;
+    float mThresholdLinear = 3.1622777e-5f;
+    double mTailSeconds = 0.0;
+    bool mEnabled = true;
+
+    bool mAsleep = false;
+    // How many consecutive samples have been under the threshold
+    int64_t mQuietSamples = 0;
+
+    // In nanoseconds rather than samples, so that they can be read without the sample rate, and stay right across
+    // a change of rate
+    std::atomic<int64_t> mNanosecondsAsleep{0};
+    std::atomic<int64_t> mNanosecondsTotal{0};
+};
+
+#endif
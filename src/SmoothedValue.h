@@ -0,0 +1,90 @@
+#ifndef __SMOOTHED_VALUE_H__
+#define __SMOOTHED_VALUE_H__
+
+#include <cmath>
+
+// A value that ramps linearly to its target over a fixed time, so that parameter changes don't click. Behaves
+// exactly like juce::SmoothedValue<float> (linear), which the chain used before it was made independent of JUCE.
+class SmoothedValue
+{
+public:
+    explicit SmoothedValue (const float initialValue = 0.0f)
+        : mCurrent(initialValue), mTarget(initialValue)
+    {
+    }
+
+    // Sets the ramp length, and jumps to the target
+    void reset (const double sampleRate, const double rampSeconds)
+    {
+        mStepsToTarget = static_cast<int>(std::floor(rampSeconds * sampleRate));
+        this->setCurrentAndTargetValue(mTarget);
+    }
+
+    void setCurrentAndTargetValue (const float value)
+    {
+        mCurrent = mTarget = value;
+        mCountdown = 0;
+    }
+
+    void setTargetValue (const float value)
+    {
+        if (value == mTarget)
+            return;
+        if (mStepsToTarget <= 0)
+        {
+            this->setCurrentAndTargetValue(value);
+            return;
+        }
+        mTarget = value;
+        mCountdown = mStepsToTarget;
+        mStep = (mTarget - mCurrent) / static_cast<float>(mCountdown);
+    }
+
+    bool isSmoothing () const { return mCountdown > 0; };
+    float getCurrentValue () const { return mCurrent; };
+    float getTargetValue () const { return mTarget; };
+
+    float getNextValue ()
+    {
+        if (!this->isSmoothing())
+            return mTarget;
+        --mCountdown;
+        mCurrent = this->isSmoothing() ? mCurrent + mStep : mTarget;
+        return mCurrent;
+    }
+
+    float skip (const int numSamples)
+    {
+        if (numSamples >= mCountdown)
+        {
+            this->setCurrentAndTargetValue(mTarget);
+            return mTarget;
+        }
+        mCurrent += mStep * static_cast<float>(numSamples);
+        mCountdown -= numSamples;
+        return mCurrent;
+    }
+
+    void applyGain (float* samples, const int numSamples)
+    {
+        if (this->isSmoothing())
+        {
+            for (int i = 0; i < numSamples; i++)
+                samples[i] *= this->getNextValue();
+        }
+        else
+        {
+            for (int i = 0; i < numSamples; i++)
+                samples[i] *= mTarget;
+        }
+    }
+
+private:
+    float mCurrent;
+    float mTarget;
+    float mStep = 0.0f;
+    int mCountdown = 0;
+    int mStepsToTarget = 0;
+};
+
+#endif
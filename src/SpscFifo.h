@@ -0,0 +1,49 @@
+#ifndef __SPSC_FIFO_H__
+#define __SPSC_FIFO_H__
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+// Fixed-size queue between exactly one producer thread and one consumer thread. Push() and Pop() never block,
+// never allocate and finish in a fixed number of steps, so the producer can be the audio thread.
+//
+// The indices only ever count up and are masked on use, so full and empty are told apart without a spare slot.
+// Each one sits on its own cache line, since the two threads write one each.
+template <typename T, size_t Capacity>
+class SpscFifo
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    static_assert(std::is_trivially_copyable<T>::value, "Items are copied in and out of the slots");
+
+public:
+    // Producer only. Returns false (and drops the item) if the consumer has fallen a whole queue behind.
+    bool Push (const T& item)
+    {
+        const size_t write = mWrite.load(std::memory_order_relaxed);
+        if (write - mRead.load(std::memory_order_acquire) == Capacity)
+            return false;
+        mItems[write & (Capacity - 1)] = item;
+        mWrite.store(write + 1, std::memory_order_release);
+        return true;
+    };
+
+    // Consumer only. Returns false if there's nothing to read.
+    bool Pop (T& item)
+    {
+        const size_t read = mRead.load(std::memory_order_relaxed);
+        if (read == mWrite.load(std::memory_order_acquire))
+            return false;
+        item = mItems[read & (Capacity - 1)];
+        mRead.store(read + 1, std::memory_order_release);
+        return true;
+    };
+
+private:
+    std::array<T, Capacity> mItems{};
+    alignas(64) std::atomic<size_t> mWrite{0};
+    alignas(64) std::atomic<size_t> mRead{0};
+};
+
+#endif
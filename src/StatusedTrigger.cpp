@@ -75,6 +75,8 @@ DSP_SAMPLE** StatusedTrigger::Process(DSP_SAMPLE** inputs, const size_t numChann
         }
     }
 
+    this->gatingStatus.store(this->gating, std::memory_order_relaxed);
+
     // Share the results with gain objects that are listening to this trigger:
     for (auto gain = this->mGainListeners.begin(); gain != this->mGainListeners.end(); ++gain)
         (*gain)->SetGainReductionDB(this->mGainReductionDB);
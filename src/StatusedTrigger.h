@@ -1,6 +1,8 @@
 #ifndef __STATUSED_TRIGGER_H__
 #define __STATUSED_TRIGGER_H__
 
+#include <algorithm> // max
+#include <atomic>
 #include <cmath>
 #include <unordered_set>
 #include <vector>
@@ -18,10 +20,11 @@ class StatusedTrigger : public dsp::noise_gate::Trigger
 public:
     StatusedTrigger();
     DSP_SAMPLE** Process (DSP_SAMPLE** inputs, const size_t numChannels, const size_t numFrames) override;
-    std::vector<std::vector<DSP_SAMPLE>> GetGainReduction() const { return this->mGainReductionDB; };
+    // Only valid on the audio thread, until the next Process()
+    const std::vector<std::vector<DSP_SAMPLE>>& GetGainReduction() const { return this->mGainReductionDB; };
     void SetParams(const dsp::noise_gate::TriggerParams& params) { this->mParams = params; };
     void SetSampleRate(const double sampleRate) { this->mSampleRate = sampleRate; }
-    std::vector<std::vector<DSP_SAMPLE>> GetGainReductionDB() const { return this->mGainReductionDB; };
+    const std::vector<std::vector<DSP_SAMPLE>>& GetGainReductionDB() const { return this->mGainReductionDB; };
 
     void AddListener(dsp::noise_gate::Gain* gain)
     {
@@ -30,7 +33,17 @@ public:
         this->mGainListeners.insert(gain);
     }
 
-    bool isGating() { return this->gating; };
+    // As of the end of the last block. Safe to call from any thread.
+    bool isGating() const { return this->gatingStatus.load(std::memory_order_relaxed); };
+
+    // Loudest level follower across the channels, in dB
+    double GetLevelDB() const
+    {
+        double level = dsp::noise_gate::MINIMUM_LOUDNESS_POWER;
+        for (const double channelLevel : this->mLevel)
+            level = std::max(level, channelLevel);
+        return 10.0 * log10(level);
+    };
 
 private:
     enum class State
@@ -66,7 +79,9 @@ private:
 
     double level_to_db(const DSP_SAMPLE db) { return 10.0 * log10(db); };
 
+    // Worked on by Process(), and published to gatingStatus once per block
     bool gating{false};
+    std::atomic<bool> gatingStatus{false};
 };
 
 #endif
@@ -1,5 +1,8 @@
 #include "ToneStack.h"
 
+#include <algorithm>
+#include <cmath>
+
 DSP_SAMPLE** dsp::tone_stack::BasicNamToneStack::Process(DSP_SAMPLE** inputs, const int numChannels, const int numFrames)
 {
     DSP_SAMPLE** bassPointers = mToneBass.Process(inputs, numChannels, numFrames);
@@ -54,4 +57,342 @@ void dsp::tone_stack::BasicNamToneStack::SetParam(const std::string name, const
         recursive_linear_filter::BiquadParams trebleParams(sampleRate, trebleFrequency, trebleQuality, trebleGainDB);
         mToneTreble.SetParams(trebleParams);
     }
-}
\ No newline at end of file
+}
+
+namespace
+{
+using Coefficients = dsp::tone_stack::FusedToneStack::Coefficients;
+using State = dsp::tone_stack::FusedToneStack::State;
+
+enum class BandShape
+{
+    LowShelf,
+    Peaking,
+    HighShelf
+};
+
+// Audio EQ Cookbook (RBJ), same as recursive_linear_filter's
+Coefficients DesignBiquad(const BandShape shape, const double sampleRate, const double frequency, const double quality,
+                          const double gainDB)
+{
+    Coefficients c;
+    // Flat is exactly flat, so that the band can be skipped
+    if (gainDB == 0.0)
+        return c;
+
+    const double a = std::pow(10.0, gainDB / 40.0);
+    const double omega0 = 2.0 * 3.14159265358979323846 * frequency / sampleRate;
+    const double alpha = std::sin(omega0) / (2.0 * quality);
+    const double cosW = std::cos(omega0);
+    const double sqrtA2Alpha = 2.0 * std::sqrt(a) * alpha;
+
+    double b0, b1, b2, a0, a1, a2;
+    switch (shape)
+    {
+        case BandShape::LowShelf:
+            b0 = a * ((a + 1.0) - (a - 1.0) * cosW + sqrtA2Alpha);
+            b1 = 2.0 * a * ((a - 1.0) - (a + 1.0) * cosW);
+            b2 = a * ((a + 1.0) - (a - 1.0) * cosW - sqrtA2Alpha);
+            a0 = (a + 1.0) + (a - 1.0) * cosW + sqrtA2Alpha;
+            a1 = -2.0 * ((a - 1.0) + (a + 1.0) * cosW);
+            a2 = (a + 1.0) + (a - 1.0) * cosW - sqrtA2Alpha;
+            break;
+        case BandShape::Peaking:
+            b0 = 1.0 + alpha * a;
+            b1 = -2.0 * cosW;
+            b2 = 1.0 - alpha * a;
+            a0 = 1.0 + alpha / a;
+            a1 = -2.0 * cosW;
+            a2 = 1.0 - alpha / a;
+            break;
+        case BandShape::HighShelf:
+        default:
+            b0 = a * ((a + 1.0) + (a - 1.0) * cosW + sqrtA2Alpha);
+            b1 = -2.0 * a * ((a - 1.0) + (a + 1.0) * cosW);
+            b2 = a * ((a + 1.0) + (a - 1.0) * cosW - sqrtA2Alpha);
+            a0 = (a + 1.0) - (a - 1.0) * cosW + sqrtA2Alpha;
+            a1 = 2.0 * ((a - 1.0) - (a + 1.0) * cosW);
+            a2 = (a + 1.0) - (a - 1.0) * cosW - sqrtA2Alpha;
+            break;
+    }
+
+    c.b0 = b0 / a0;
+    c.b1 = b1 / a0;
+    c.b2 = b2 / a0;
+    c.a1 = a1 / a0;
+    c.a2 = a2 / a0;
+    return c;
+}
+
+bool IsIdentity(const Coefficients& c)
+{
+    return c.b0 == 1.0 && c.b1 == 0.0 && c.b2 == 0.0 && c.a1 == 0.0 && c.a2 == 0.0;
+}
+
+// Runs numBands biquads back to back on every sample. The coefficients and states are copied into locals so that
+// the compiler can keep them in registers for the whole loop; with Ramping, every coefficient moves by its step
+// before each sample.
+template <int NumBands, bool Ramping>
+void ProcessCascade(const DSP_SAMPLE* input, DSP_SAMPLE* output, const int numFrames, const Coefficients* coefficients,
+                    const Coefficients* steps, State* states)
+{
+    Coefficients c[NumBands];
+    Coefficients step[NumBands];
+    State s[NumBands];
+    for (int b = 0; b < NumBands; b++)
+    {
+        c[b] = coefficients[b];
+        step[b] = steps[b];
+        s[b] = states[b];
+    }
+
+    for (int i = 0; i < numFrames; i++)
+    {
+        double x = input[i];
+        for (int b = 0; b < NumBands; b++)
+        {
+            if (Ramping)
+            {
+                c[b].b0 += step[b].b0;
+                c[b].b1 += step[b].b1;
+                c[b].b2 += step[b].b2;
+                c[b].a1 += step[b].a1;
+                c[b].a2 += step[b].a2;
+            }
+            const double y = c[b].b0 * x + s[b].z1;
+            s[b].z1 = c[b].b1 * x - c[b].a1 * y + s[b].z2;
+            s[b].z2 = c[b].b2 * x - c[b].a2 * y;
+            x = y;
+        }
+        output[i] = static_cast<DSP_SAMPLE>(x);
+    }
+
+    for (int b = 0; b < NumBands; b++)
+        states[b] = s[b];
+}
+
+template <bool Ramping>
+void ProcessCascade(const int numBands, const DSP_SAMPLE* input, DSP_SAMPLE* output, const int numFrames,
+                    const Coefficients* coefficients, const Coefficients* steps, State* states)
+{
+    switch (numBands)
+    {
+        case 0: std::copy(input, input + numFrames, output); break;
+        case 1: ProcessCascade<1, Ramping>(input, output, numFrames, coefficients, steps, states); break;
+        case 2: ProcessCascade<2, Ramping>(input, output, numFrames, coefficients, steps, states); break;
+        default: ProcessCascade<3, Ramping>(input, output, numFrames, coefficients, steps, states); break;
+    }
+}
+}; // namespace
+
+dsp::tone_stack::FusedToneStack::FusedToneStack()
+{
+    SetParam("bass", 5.0);
+    SetParam("middle", 5.0);
+    SetParam("treble", 5.0);
+}
+
+DSP_SAMPLE** dsp::tone_stack::FusedToneStack::Process(DSP_SAMPLE** inputs, const int numChannels, const int numFrames)
+{
+    DSP_SAMPLE** outputs = mArenaOutputs;
+    if (outputs == nullptr || numChannels > mArenaChannels || numFrames > mArenaFrames)
+    {
+        PrepareBuffers(numChannels, numFrames);
+        outputs = mOutputPointers.data();
+    }
+
+    // All flat and settled: nothing to do
+    bool anyActive = false;
+    for (int b = 0; b < kNumBands; b++)
+        anyActive = anyActive || !IsSilent(b);
+    if (!anyActive)
+        return inputs;
+
+    // Split the block wherever a band's ramp ends, so that each stretch either ramps or doesn't
+    int offset = 0;
+    while (offset < numFrames)
+    {
+        int segment = numFrames - offset;
+        bool ramping = false;
+        int active[kNumBands];
+        int numActive = 0;
+        Coefficients coefficients[kNumBands];
+        Coefficients steps[kNumBands];
+        for (int b = 0; b < kNumBands; b++)
+        {
+            const Band& band = mBands[b];
+            if (band.rampRemaining > 0)
+            {
+                segment = std::min(segment, band.rampRemaining);
+                ramping = true;
+            }
+            if (!IsSilent(b))
+            {
+                coefficients[numActive] = band.current;
+                steps[numActive] = band.step;
+                active[numActive++] = b;
+            }
+        }
+
+        for (int channel = 0; channel < numChannels; channel++)
+        {
+            State states[kNumBands];
+            for (int i = 0; i < numActive; i++)
+                states[i] = mStates[channel][active[i]];
+
+            const DSP_SAMPLE* input = inputs[channel] + offset;
+            DSP_SAMPLE* output = outputs[channel] + offset;
+            if (ramping)
+                ProcessCascade<true>(numActive, input, output, segment, coefficients, steps, states);
+            else
+                ProcessCascade<false>(numActive, input, output, segment, coefficients, steps, states);
+
+            for (int i = 0; i < numActive; i++)
+                mStates[channel][active[i]] = states[i];
+        }
+
+        for (Band& band : mBands)
+        {
+            if (band.rampRemaining == 0)
+                continue;
+            band.rampRemaining -= segment;
+            if (band.rampRemaining == 0)
+            {
+                // Land exactly on the target, so that a band that went flat can be skipped again
+                band.current = band.target;
+                band.step = Coefficients{0.0, 0.0, 0.0, 0.0, 0.0};
+            }
+            else
+            {
+                band.current.b0 += segment * band.step.b0;
+                band.current.b1 += segment * band.step.b1;
+                band.current.b2 += segment * band.step.b2;
+                band.current.a1 += segment * band.step.a1;
+                band.current.a2 += segment * band.step.a2;
+            }
+        }
+        offset += segment;
+    }
+    return outputs;
+}
+
+void dsp::tone_stack::FusedToneStack::Reset(const double sampleRate, const int maxBlockSize)
+{
+    dsp::tone_stack::AbstractToneStack::Reset(sampleRate, maxBlockSize);
+
+    for (int b = 0; b < kNumBands; b++)
+        UpdateBand(b, false);
+    for (auto& channelStates : mStates)
+        channelStates.fill(State());
+    if (mArenaOutputs == nullptr || maxBlockSize > mArenaFrames)
+        PrepareBuffers(std::max<int>(1, (int)mStates.size()), maxBlockSize);
+}
+
+void dsp::tone_stack::FusedToneStack::AllocateBuffers(DSPArena& arena, const int numChannels, const int maxFrames)
+{
+    if ((int)mStates.size() < numChannels)
+        mStates.resize(numChannels);
+
+    mArenaOutputs = arena.Allocate<DSP_SAMPLE*>(numChannels);
+    for (int c = 0; c < numChannels; c++)
+    {
+        DSP_SAMPLE* output = arena.Allocate<DSP_SAMPLE>(maxFrames);
+        if (mArenaOutputs != nullptr)
+            mArenaOutputs[c] = output;
+    }
+    mArenaChannels = numChannels;
+    mArenaFrames = maxFrames;
+}
+
+void dsp::tone_stack::FusedToneStack::SetParam(const std::string name, const double val)
+{
+    int band;
+    if (name == "bass")
+        band = 0;
+    else if (name == "middle")
+        band = 1;
+    else if (name == "treble")
+        band = 2;
+    else
+        return;
+
+    // Called on every block whether or not anything moved
+    if (val == mBands[band].value)
+        return;
+    mBands[band].value = val;
+    UpdateBand(band, true);
+}
+
+void dsp::tone_stack::FusedToneStack::UpdateBand(const int band, const bool ramp)
+{
+    const double sampleRate = GetSampleRate();
+    // Not prepared yet; Reset() will design it
+    if (sampleRate <= 0.0)
+        return;
+
+    Band& b = mBands[band];
+    b.target = Design(band);
+    const int rampSamples = static_cast<int>(kRampSeconds * sampleRate);
+    if (!ramp || rampSamples <= 1)
+    {
+        b.current = b.target;
+        b.step = Coefficients{0.0, 0.0, 0.0, 0.0, 0.0};
+        b.rampRemaining = 0;
+        return;
+    }
+
+    // Straight lines between two stable biquads stay stable: the region of stable (a1, a2) is a triangle, and so
+    // convex. That holds even when the mid's Q flips between cut and boost.
+    b.step.b0 = (b.target.b0 - b.current.b0) / rampSamples;
+    b.step.b1 = (b.target.b1 - b.current.b1) / rampSamples;
+    b.step.b2 = (b.target.b2 - b.current.b2) / rampSamples;
+    b.step.a1 = (b.target.a1 - b.current.a1) / rampSamples;
+    b.step.a2 = (b.target.a2 - b.current.a2) / rampSamples;
+    b.rampRemaining = rampSamples;
+}
+
+dsp::tone_stack::FusedToneStack::Coefficients dsp::tone_stack::FusedToneStack::Design(const int band) const
+{
+    // Same mappings as BasicNamToneStack
+    const double sampleRate = GetSampleRate();
+    const double val = mBands[band].value;
+    if (band == 0)
+    {
+        const double bassGainDB = 4.0 * (val - 5.0); // +/- 20
+        return DesignBiquad(BandShape::LowShelf, sampleRate, 150.0, 0.707, bassGainDB);
+    }
+    if (band == 1)
+    {
+        const double midGainDB = 3.0 * (val - 5.0); // +/- 15
+        const double midQuality = midGainDB < 0.0 ? 1.5 : 0.7;
+        return DesignBiquad(BandShape::Peaking, sampleRate, 425.0, midQuality, midGainDB);
+    }
+    const double trebleGainDB = 2.0 * (val - 5.0); // +/- 10
+    return DesignBiquad(BandShape::HighShelf, sampleRate, 1800.0, 0.707, trebleGainDB);
+}
+
+bool dsp::tone_stack::FusedToneStack::IsSilent(const int band) const
+{
+    const Band& b = mBands[band];
+    if (b.rampRemaining > 0 || !IsIdentity(b.current))
+        return false;
+    // A flat band flushes its state to exactly zero two samples after it gets there
+    for (const auto& channelStates : mStates)
+        if (channelStates[band].z1 != 0.0 || channelStates[band].z2 != 0.0)
+            return false;
+    return true;
+}
+
+void dsp::tone_stack::FusedToneStack::PrepareBuffers(const int numChannels, const int numFrames)
+{
+    if ((int)mStates.size() < numChannels)
+        mStates.resize(numChannels);
+    if ((int)mOutputs.size() < numChannels)
+        mOutputs.resize(numChannels);
+    for (auto& output : mOutputs)
+        if ((int)output.size() < numFrames)
+            output.resize(numFrames);
+    mOutputPointers.resize(mOutputs.size());
+    for (size_t c = 0; c < mOutputs.size(); c++)
+        mOutputPointers[c] = mOutputs[c].data();
+}
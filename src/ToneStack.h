@@ -1,9 +1,13 @@
 #pragma once
 
+#include <array>
 #include <string>
+#include <vector>
 #include <dsp.h>
 #include <RecursiveLinearFilter.h>
 
+#include "DSPArena.h"
+
 namespace dsp
 {
 namespace tone_stack
@@ -22,6 +26,9 @@ public:
     // Set the various parameters of your tone stack by name.
     // Call this during OnParamChange()
     virtual void SetParam (const std::string name, const double val) = 0;
+    // Optionally take the per-block buffers for up to numChannels x maxFrames from the owner's arena, inside its
+    // DSPArena::Build(). Blocks that don't fit fall back to the tone stack's own buffers.
+    virtual void AllocateBuffers (DSPArena& arena, const int numChannels, const int maxFrames) {};
 
 protected:
     double GetSampleRate() const { return mSampleRate; };
@@ -55,5 +62,64 @@ protected:
     double mMiddleVal = 5.0;
     double mTrebleVal = 5.0;
 };
+// Same controls and response as BasicNamToneStack, done in one pass: each sample goes through all three bands
+// back to back, with the filter states held in locals for the whole block instead of three passes over three
+// buffers. A band that's at exactly 0 dB is skipped. When a knob moves, the band's coefficients glide to their
+// new values over kRampSeconds instead of being redesigned at the next block boundary.
+class FusedToneStack : public AbstractToneStack
+{
+public:
+    FusedToneStack();
+    ~FusedToneStack() = default;
+
+    DSP_SAMPLE** Process (DSP_SAMPLE** inputs, const int numChannels, const int numFrames) override;
+    void Reset (const double sampleRate, const int maxBlockSize) override;
+    // :param val: Assumed to be between 0 and 10, 5 is "noon"
+    void SetParam (const std::string name, const double val) override;
+    void AllocateBuffers (DSPArena& arena, const int numChannels, const int maxFrames) override;
+
+    static constexpr int kNumBands = 3;
+
+    // Normalized biquad (a0 = 1)
+    struct Coefficients
+    {
+        double b0 = 1.0, b1 = 0.0, b2 = 0.0, a1 = 0.0, a2 = 0.0;
+    };
+
+    // Transposed direct form II
+    struct State
+    {
+        double z1 = 0.0, z2 = 0.0;
+    };
+
+private:
+    static constexpr double kRampSeconds = 0.02;
+
+    struct Band
+    {
+        double value = 5.0;
+        Coefficients current;
+        Coefficients target;
+        // Per-sample increment while ramping
+        Coefficients step;
+        int rampRemaining = 0;
+    };
+
+    // Redesigns a band's target from its knob value, and either ramps to it or jumps straight there
+    void UpdateBand (const int band, const bool ramp);
+    Coefficients Design (const int band) const;
+    bool IsSilent (const int band) const;
+    void PrepareBuffers (const int numChannels, const int numFrames);
+
+    std::array<Band, kNumBands> mBands;
+    // Per channel, then per band
+    std::vector<std::array<State, kNumBands>> mStates;
+    std::vector<std::vector<DSP_SAMPLE>> mOutputs;
+    std::vector<DSP_SAMPLE*> mOutputPointers;
+    // From the owner's arena, if it gave us any
+    DSP_SAMPLE** mArenaOutputs = nullptr;
+    int mArenaChannels = 0;
+    int mArenaFrames = 0;
+};
 }; // namespace tone_stack
 }; // namespace dsp
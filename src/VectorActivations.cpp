@@ -0,0 +1,432 @@
+#include "VectorActivations.h"
+#include "CpuFeatures.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+// Cephes-style exp: range reduction to [-ln2/2, ln2/2], degree-6 polynomial, then scale by 2^n.
+const float kExpHi = 88.3762626647949f;
+const float kExpLo = -88.3762626647949f;
+const float kLog2e = 1.44269504088896341f;
+const float kLn2Hi = 0.693359375f;
+const float kLn2Lo = -2.12194440e-4f;
+const float kExpP0 = 1.9875691500e-4f;
+const float kExpP1 = 1.3981999507e-3f;
+const float kExpP2 = 8.3334519073e-3f;
+const float kExpP3 = 4.1665795894e-2f;
+const float kExpP4 = 1.6666665459e-1f;
+const float kExpP5 = 5.0000001201e-1f;
+
+// Coefficients of the core's fast_tanh() rational approximation
+const float kFastTanhA = 2.45550750702956f;
+const float kFastTanhB = 0.893229853513558f;
+const float kFastTanhC = 0.821226666969744f;
+const float kFastTanhD = 2.44506634652299f;
+const float kFastTanhE = 0.814642734961073f;
+
+inline float FastTanhScalar(const float x)
+{
+    const float ax = std::fabs(x);
+    const float x2 = x * x;
+    return (x * (kFastTanhA + kFastTanhA * ax + (kFastTanhB + kFastTanhC * ax) * x2)
+            / (kFastTanhD + (kFastTanhD + x2) * std::fabs(x + kFastTanhE * x * ax)));
+}
+
+// Plain C++ versions. Used for the tails of the vector loops, and on their own where there's no vector path.
+void TanhScalar(float* data, long size)
+{
+    for (long i = 0; i < size; i++)
+        data[i] = std::tanh(data[i]);
+}
+
+void FastTanhScalar(float* data, long size)
+{
+    for (long i = 0; i < size; i++)
+        data[i] = FastTanhScalar(data[i]);
+}
+
+void SigmoidScalar(float* data, long size)
+{
+    for (long i = 0; i < size; i++)
+        data[i] = 1.0f / (1.0f + std::exp(-data[i]));
+}
+
+void ReluScalar(float* data, long size)
+{
+    for (long i = 0; i < size; i++)
+        data[i] = data[i] < 0.0f ? 0.0f : data[i];
+}
+
+void HardtanhScalar(float* data, long size)
+{
+    for (long i = 0; i < size; i++)
+        data[i] = std::min(std::max(data[i], -1.0f), 1.0f);
+}
+
+#ifdef NAM_X86
+//==============================================================================
+// SSE2 (always there on x86-64)
+inline __m128 ExpSSE2(__m128 x)
+{
+    x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(kExpLo)), _mm_set1_ps(kExpHi));
+
+    // n = floor(x * log2(e) + 0.5)
+    __m128 fx = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(kLog2e)), _mm_set1_ps(0.5f));
+    const __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(fx));
+    fx = _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, fx), _mm_set1_ps(1.0f)));
+
+    x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(kLn2Hi)));
+    x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(kLn2Lo)));
+
+    __m128 y = _mm_set1_ps(kExpP0);
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(kExpP1));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(kExpP2));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(kExpP3));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(kExpP4));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(kExpP5));
+    y = _mm_add_ps(_mm_mul_ps(y, _mm_mul_ps(x, x)), _mm_add_ps(x, _mm_set1_ps(1.0f)));
+
+    const __m128i exponent = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(fx), _mm_set1_epi32(0x7f)), 23);
+    return _mm_mul_ps(y, _mm_castsi128_ps(exponent));
+}
+
+inline __m128 AbsSSE2(const __m128 x)
+{
+    return _mm_and_ps(x, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)));
+}
+
+void TanhSSE2(float* data, long size)
+{
+    long i = 0;
+    for (; i + 4 <= size; i += 4)
+    {
+        // tanh(x) = 1 - 2 / (exp(2x) + 1)
+        const __m128 e = ExpSSE2(_mm_add_ps(_mm_loadu_ps(data + i), _mm_loadu_ps(data + i)));
+        _mm_storeu_ps(data + i, _mm_sub_ps(_mm_set1_ps(1.0f), _mm_div_ps(_mm_set1_ps(2.0f), _mm_add_ps(e, _mm_set1_ps(1.0f)))));
+    }
+    TanhScalar(data + i, size - i);
+}
+
+void FastTanhSSE2(float* data, long size)
+{
+    long i = 0;
+    for (; i + 4 <= size; i += 4)
+    {
+        const __m128 x = _mm_loadu_ps(data + i);
+        const __m128 ax = AbsSSE2(x);
+        const __m128 x2 = _mm_mul_ps(x, x);
+        const __m128 inner = _mm_add_ps(_mm_set1_ps(kFastTanhB), _mm_mul_ps(_mm_set1_ps(kFastTanhC), ax));
+        const __m128 num = _mm_mul_ps(x, _mm_add_ps(_mm_add_ps(_mm_set1_ps(kFastTanhA), _mm_mul_ps(_mm_set1_ps(kFastTanhA), ax)), _mm_mul_ps(inner, x2)));
+        const __m128 den = _mm_add_ps(_mm_set1_ps(kFastTanhD),
+                                      _mm_mul_ps(_mm_add_ps(_mm_set1_ps(kFastTanhD), x2),
+                                                 AbsSSE2(_mm_add_ps(x, _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(kFastTanhE), x), ax)))));
+        _mm_storeu_ps(data + i, _mm_div_ps(num, den));
+    }
+    FastTanhScalar(data + i, size - i);
+}
+
+void SigmoidSSE2(float* data, long size)
+{
+    long i = 0;
+    for (; i + 4 <= size; i += 4)
+    {
+        const __m128 e = ExpSSE2(_mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(data + i)));
+        _mm_storeu_ps(data + i, _mm_div_ps(_mm_set1_ps(1.0f), _mm_add_ps(e, _mm_set1_ps(1.0f))));
+    }
+    SigmoidScalar(data + i, size - i);
+}
+
+void ReluSSE2(float* data, long size)
+{
+    long i = 0;
+    for (; i + 4 <= size; i += 4)
+        _mm_storeu_ps(data + i, _mm_max_ps(_mm_loadu_ps(data + i), _mm_setzero_ps()));
+    ReluScalar(data + i, size - i);
+}
+
+void HardtanhSSE2(float* data, long size)
+{
+    long i = 0;
+    for (; i + 4 <= size; i += 4)
+        _mm_storeu_ps(data + i, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(data + i), _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f)));
+    HardtanhScalar(data + i, size - i);
+}
+
+//==============================================================================
+// AVX2 + FMA
+// The tails go to the SSE2 kernels, which aren't VEX-encoded; clear the upper register halves first, or every
+// call pays for an AVX/SSE transition.
+NAM_TARGET_AVX2 inline __m256 ExpAVX2(__m256 x)
+{
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(kExpLo)), _mm256_set1_ps(kExpHi));
+
+    const __m256 fx = _mm256_floor_ps(_mm256_fmadd_ps(x, _mm256_set1_ps(kLog2e), _mm256_set1_ps(0.5f)));
+    x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(kLn2Hi), x);
+    x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(kLn2Lo), x);
+
+    __m256 y = _mm256_set1_ps(kExpP0);
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(kExpP1));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(kExpP2));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(kExpP3));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(kExpP4));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(kExpP5));
+    y = _mm256_fmadd_ps(y, _mm256_mul_ps(x, x), _mm256_add_ps(x, _mm256_set1_ps(1.0f)));
+
+    const __m256i exponent = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(fx), _mm256_set1_epi32(0x7f)), 23);
+    return _mm256_mul_ps(y, _mm256_castsi256_ps(exponent));
+}
+
+NAM_TARGET_AVX2 inline __m256 AbsAVX2(const __m256 x)
+{
+    return _mm256_and_ps(x, _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff)));
+}
+
+NAM_TARGET_AVX2 void TanhAVX2(float* data, long size)
+{
+    long i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        const __m256 x = _mm256_loadu_ps(data + i);
+        const __m256 e = ExpAVX2(_mm256_add_ps(x, x));
+        _mm256_storeu_ps(data + i, _mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_div_ps(_mm256_set1_ps(2.0f), _mm256_add_ps(e, _mm256_set1_ps(1.0f)))));
+    }
+    _mm256_zeroupper();
+    TanhSSE2(data + i, size - i);
+}
+
+NAM_TARGET_AVX2 void FastTanhAVX2(float* data, long size)
+{
+    long i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        const __m256 x = _mm256_loadu_ps(data + i);
+        const __m256 ax = AbsAVX2(x);
+        const __m256 x2 = _mm256_mul_ps(x, x);
+        const __m256 inner = _mm256_fmadd_ps(_mm256_set1_ps(kFastTanhC), ax, _mm256_set1_ps(kFastTanhB));
+        const __m256 num = _mm256_mul_ps(x, _mm256_fmadd_ps(inner, x2, _mm256_fmadd_ps(_mm256_set1_ps(kFastTanhA), ax, _mm256_set1_ps(kFastTanhA))));
+        const __m256 den = _mm256_fmadd_ps(_mm256_add_ps(_mm256_set1_ps(kFastTanhD), x2),
+                                           AbsAVX2(_mm256_fmadd_ps(_mm256_mul_ps(_mm256_set1_ps(kFastTanhE), x), ax, x)), _mm256_set1_ps(kFastTanhD));
+        _mm256_storeu_ps(data + i, _mm256_div_ps(num, den));
+    }
+    _mm256_zeroupper();
+    FastTanhSSE2(data + i, size - i);
+}
+
+NAM_TARGET_AVX2 void SigmoidAVX2(float* data, long size)
+{
+    long i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        const __m256 e = ExpAVX2(_mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(data + i)));
+        _mm256_storeu_ps(data + i, _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_add_ps(e, _mm256_set1_ps(1.0f))));
+    }
+    _mm256_zeroupper();
+    SigmoidSSE2(data + i, size - i);
+}
+
+NAM_TARGET_AVX2 void ReluAVX2(float* data, long size)
+{
+    long i = 0;
+    for (; i + 8 <= size; i += 8)
+        _mm256_storeu_ps(data + i, _mm256_max_ps(_mm256_loadu_ps(data + i), _mm256_setzero_ps()));
+    _mm256_zeroupper();
+    ReluSSE2(data + i, size - i);
+}
+
+NAM_TARGET_AVX2 void HardtanhAVX2(float* data, long size)
+{
+    long i = 0;
+    for (; i + 8 <= size; i += 8)
+        _mm256_storeu_ps(data + i, _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(data + i), _mm256_set1_ps(-1.0f)), _mm256_set1_ps(1.0f)));
+    _mm256_zeroupper();
+    HardtanhSSE2(data + i, size - i);
+}
+
+//==============================================================================
+// AVX-512F
+NAM_TARGET_AVX512 inline __m512 ExpAVX512(__m512 x)
+{
+    x = _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(kExpLo)), _mm512_set1_ps(kExpHi));
+
+    const __m512 fx =
+        _mm512_roundscale_ps(_mm512_fmadd_ps(x, _mm512_set1_ps(kLog2e), _mm512_set1_ps(0.5f)), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+    x = _mm512_fnmadd_ps(fx, _mm512_set1_ps(kLn2Hi), x);
+    x = _mm512_fnmadd_ps(fx, _mm512_set1_ps(kLn2Lo), x);
+
+    __m512 y = _mm512_set1_ps(kExpP0);
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(kExpP1));
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(kExpP2));
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(kExpP3));
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(kExpP4));
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(kExpP5));
+    y = _mm512_fmadd_ps(y, _mm512_mul_ps(x, x), _mm512_add_ps(x, _mm512_set1_ps(1.0f)));
+
+    const __m512i exponent = _mm512_slli_epi32(_mm512_add_epi32(_mm512_cvttps_epi32(fx), _mm512_set1_epi32(0x7f)), 23);
+    return _mm512_mul_ps(y, _mm512_castsi512_ps(exponent));
+}
+
+NAM_TARGET_AVX512 inline __m512 AbsAVX512(const __m512 x)
+{
+    // _mm512_and_ps needs AVX512DQ; stick to F
+    return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(x), _mm512_set1_epi32(0x7fffffff)));
+}
+
+NAM_TARGET_AVX512 void TanhAVX512(float* data, long size)
+{
+    long i = 0;
+    for (; i + 16 <= size; i += 16)
+    {
+        const __m512 x = _mm512_loadu_ps(data + i);
+        const __m512 e = ExpAVX512(_mm512_add_ps(x, x));
+        _mm512_storeu_ps(data + i, _mm512_sub_ps(_mm512_set1_ps(1.0f), _mm512_div_ps(_mm512_set1_ps(2.0f), _mm512_add_ps(e, _mm512_set1_ps(1.0f)))));
+    }
+    _mm256_zeroupper();
+    TanhSSE2(data + i, size - i);
+}
+
+NAM_TARGET_AVX512 void FastTanhAVX512(float* data, long size)
+{
+    long i = 0;
+    for (; i + 16 <= size; i += 16)
+    {
+        const __m512 x = _mm512_loadu_ps(data + i);
+        const __m512 ax = AbsAVX512(x);
+        const __m512 x2 = _mm512_mul_ps(x, x);
+        const __m512 inner = _mm512_fmadd_ps(_mm512_set1_ps(kFastTanhC), ax, _mm512_set1_ps(kFastTanhB));
+        const __m512 num = _mm512_mul_ps(x, _mm512_fmadd_ps(inner, x2, _mm512_fmadd_ps(_mm512_set1_ps(kFastTanhA), ax, _mm512_set1_ps(kFastTanhA))));
+        const __m512 den = _mm512_fmadd_ps(_mm512_add_ps(_mm512_set1_ps(kFastTanhD), x2),
+                                           AbsAVX512(_mm512_fmadd_ps(_mm512_mul_ps(_mm512_set1_ps(kFastTanhE), x), ax, x)), _mm512_set1_ps(kFastTanhD));
+        _mm512_storeu_ps(data + i, _mm512_div_ps(num, den));
+    }
+    _mm256_zeroupper();
+    FastTanhSSE2(data + i, size - i);
+}
+
+NAM_TARGET_AVX512 void SigmoidAVX512(float* data, long size)
+{
+    long i = 0;
+    for (; i + 16 <= size; i += 16)
+    {
+        const __m512 e = ExpAVX512(_mm512_sub_ps(_mm512_setzero_ps(), _mm512_loadu_ps(data + i)));
+        _mm512_storeu_ps(data + i, _mm512_div_ps(_mm512_set1_ps(1.0f), _mm512_add_ps(e, _mm512_set1_ps(1.0f))));
+    }
+    _mm256_zeroupper();
+    SigmoidSSE2(data + i, size - i);
+}
+
+NAM_TARGET_AVX512 void ReluAVX512(float* data, long size)
+{
+    long i = 0;
+    for (; i + 16 <= size; i += 16)
+        _mm512_storeu_ps(data + i, _mm512_max_ps(_mm512_loadu_ps(data + i), _mm512_setzero_ps()));
+    _mm256_zeroupper();
+    ReluSSE2(data + i, size - i);
+}
+
+NAM_TARGET_AVX512 void HardtanhAVX512(float* data, long size)
+{
+    long i = 0;
+    for (; i + 16 <= size; i += 16)
+        _mm512_storeu_ps(data + i, _mm512_min_ps(_mm512_max_ps(_mm512_loadu_ps(data + i), _mm512_set1_ps(-1.0f)), _mm512_set1_ps(1.0f)));
+    _mm256_zeroupper();
+    HardtanhSSE2(data + i, size - i);
+}
+#endif
+
+ActivationKernels SelectKernels()
+{
+#ifdef NAM_X86
+    if (CpuHasAVX512())
+        return {TanhAVX512, FastTanhAVX512, SigmoidAVX512, ReluAVX512, HardtanhAVX512, "AVX-512"};
+    if (CpuHasAVX2())
+        return {TanhAVX2, FastTanhAVX2, SigmoidAVX2, ReluAVX2, HardtanhAVX2, "AVX2"};
+    return {TanhSSE2, FastTanhSSE2, SigmoidSSE2, ReluSSE2, HardtanhSSE2, "SSE2"};
+#else
+    return {TanhScalar, FastTanhScalar, SigmoidScalar, ReluScalar, HardtanhScalar, "scalar"};
+#endif
+}
+
+// Largest difference between a kernel and a reference over a grid that covers the saturated regions too
+template <typename Reference>
+float MaxError(void (*kernel)(float*, long), Reference reference)
+{
+    const long size = 4001;
+    std::vector<float> values(size);
+    for (long i = 0; i < size; i++)
+        values[i] = -20.0f + 40.0f * (float)i / (float)(size - 1);
+
+    std::vector<float> results(values);
+    kernel(results.data(), size);
+
+    float maxError = 0.0f;
+    for (long i = 0; i < size; i++)
+        maxError = std::max(maxError, std::fabs(results[i] - reference(values[i])));
+    return maxError;
+}
+
+class VectorTanh : public nam::activations::Activation
+{
+public:
+    using nam::activations::Activation::apply;
+    void apply(float* data, long size) override { GetActivationKernels().tanh(data, size); };
+};
+
+class VectorFastTanh : public nam::activations::Activation
+{
+public:
+    using nam::activations::Activation::apply;
+    void apply(float* data, long size) override { GetActivationKernels().fastTanh(data, size); };
+};
+
+class VectorSigmoid : public nam::activations::Activation
+{
+public:
+    using nam::activations::Activation::apply;
+    void apply(float* data, long size) override { GetActivationKernels().sigmoid(data, size); };
+};
+
+class VectorRelu : public nam::activations::Activation
+{
+public:
+    using nam::activations::Activation::apply;
+    void apply(float* data, long size) override { GetActivationKernels().relu(data, size); };
+};
+
+class VectorHardtanh : public nam::activations::Activation
+{
+public:
+    using nam::activations::Activation::apply;
+    void apply(float* data, long size) override { GetActivationKernels().hardtanh(data, size); };
+};
+}; // namespace
+
+const ActivationKernels& GetActivationKernels()
+{
+    static const ActivationKernels kernels = SelectKernels();
+    return kernels;
+}
+
+void VectorActivations::Install()
+{
+    static VectorTanh tanhActivation;
+    static VectorFastTanh fastTanhActivation;
+    static VectorSigmoid sigmoidActivation;
+    static VectorRelu reluActivation;
+    static VectorHardtanh hardtanhActivation;
+
+    const ActivationKernels& kernels = GetActivationKernels();
+
+    // Only swap in kernels that hold their documented accuracy on this machine; anything else keeps the
+    // core's version.
+    if (MaxError(kernels.tanh, [](float x) { return std::tanh(x); }) < 3e-7f)
+        _activations["Tanh"] = &tanhActivation;
+    if (MaxError(kernels.fastTanh, [](float x) { return nam::activations::fast_tanh(x); }) < 1e-6f)
+        _activations["Fast_Tanh"] = &fastTanhActivation;
+    if (MaxError(kernels.sigmoid, [](float x) { return 1.0f / (1.0f + std::exp(-x)); }) < 2e-7f)
+        _activations["Sigmoid"] = &sigmoidActivation;
+    _activations["ReLU"] = &reluActivation;
+    _activations["Hardtanh"] = &hardtanhActivation;
+}
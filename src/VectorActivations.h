@@ -0,0 +1,37 @@
+#ifndef __VECTOR_ACTIVATIONS_H__
+#define __VECTOR_ACTIVATIONS_H__
+
+#include <activations.h>
+
+// Vectorized replacements for the core's element-by-element activations.
+// The instruction set (AVX-512, AVX2+FMA, SSE2, or plain C++ elsewhere) is picked once, the first time the
+// kernels are asked for, from what the CPU running us supports; one binary runs the best kernels everywhere.
+//
+// Accuracy against the standard library, over [-20, 20]:
+//   Tanh:      |error| < 3e-7 (absolute) vs std::tanh
+//   Sigmoid:   |error| < 2e-7 (absolute) vs 1 / (1 + std::exp(-x))
+//   Fast_Tanh: same rational approximation as nam::activations::fast_tanh, |error| < 1e-6 vs it (FMA
+//              rounds differently); that approximation itself is within 1e-2 of std::tanh
+//   ReLU, Hardtanh: exact
+struct ActivationKernels
+{
+    void (*tanh)(float* data, long size);
+    void (*fastTanh)(float* data, long size);
+    void (*sigmoid)(float* data, long size);
+    void (*relu)(float* data, long size);
+    void (*hardtanh)(float* data, long size);
+    // Name of the instruction set these kernels were built for
+    const char* isa;
+};
+
+const ActivationKernels& GetActivationKernels ();
+
+// Puts the vectorized activations in place of the core's ones. Models pick up their activations when
+// they're built, so call this before loading any. Call enable_fast_tanh() after this, not before.
+class VectorActivations : public nam::activations::Activation
+{
+public:
+    static void Install ();
+};
+
+#endif
@@ -0,0 +1,219 @@
+// The whole chain, as NamEngine runs it, on synthetic models: gains, blending, lining up resampled models, the
+// tone stack and the cab, and its stored output on a WaveNet.
+
+#include "IRStore.h"
+#include "ModelFactory.h"
+#include "NamEngine.h"
+#include "NamTest.h"
+#include "SyntheticModels.h"
+#include "TestSupport.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace
+{
+const double kPi = 3.14159265358979323846;
+
+// The 6 dB that follows the cab
+const double kCabGain = 1.99526231;
+
+// Everything that changes the sound off: no gate, flat tone stack, unity gains, no cab
+void SetNeutral(NamEngine& engine)
+{
+    engine.SetParameter(NeuralAmpModeler::kInputLevel, 0.0f);
+    engine.SetParameter(NeuralAmpModeler::kNoiseGateThreshold, -101.0f);
+    engine.SetParameter(NeuralAmpModeler::kToneBass, 5.0f);
+    engine.SetParameter(NeuralAmpModeler::kToneMid, 5.0f);
+    engine.SetParameter(NeuralAmpModeler::kToneTreble, 5.0f);
+    engine.SetParameter(NeuralAmpModeler::kOutputLevel, 0.0f);
+    engine.SetParameter(NeuralAmpModeler::kEQActive, 0.0f);
+    engine.SetParameter(NeuralAmpModeler::kOutNorm, 0.0f);
+    engine.SetParameter(NeuralAmpModeler::kModelBlend, 0.0f);
+    engine.SetParameter(NamEngine::kCabActive, 0.0f);
+}
+
+void LoadModel(NamEngine& engine, const nam::dspData& data, const int slot)
+{
+    Expect(engine.LoadModel(data, slot), "Couldn't load the model into slot " + std::to_string(slot));
+}
+
+// Through the engine in host blocks of random sizes up to maxBlockSize, or all of maxBlockSize
+std::vector<float> RunEngine(NamEngine& engine, const std::vector<float>& input, const int maxBlockSize, const bool ragged = true)
+{
+    std::vector<float> output = input;
+    std::mt19937 generator(11);
+    std::uniform_int_distribution<int> blockSizes(1, maxBlockSize);
+    for (size_t offset = 0; offset < output.size();)
+    {
+        const int numFrames = (int)std::min<size_t>(ragged ? blockSizes(generator) : maxBlockSize, output.size() - offset);
+        engine.Process(output.data() + offset, numFrames);
+        offset += numFrames;
+    }
+    return output;
+}
+
+std::vector<float> Scaled(const std::vector<float>& signal, const double gain)
+{
+    std::vector<float> scaled(signal.size());
+    for (size_t i = 0; i < signal.size(); i++)
+        scaled[i] = (float)(gain * signal[i]);
+    return scaled;
+}
+
+double FromDB(const double db)
+{
+    return std::pow(10.0, db / 20.0);
+}
+
+// The engine with the standard WaveNet, the tone stack moved, and a cab
+std::vector<float> RunFullChain(const std::vector<float>& input)
+{
+    NamEngine engine;
+    SetNeutral(engine);
+    engine.SetParameter(NeuralAmpModeler::kInputLevel, 3.0f);
+    engine.SetParameter(NeuralAmpModeler::kEQActive, 1.0f);
+    engine.SetParameter(NeuralAmpModeler::kToneBass, 7.0f);
+    engine.SetParameter(NeuralAmpModeler::kToneMid, 3.5f);
+    engine.SetParameter(NeuralAmpModeler::kToneTreble, 6.0f);
+    engine.SetParameter(NeuralAmpModeler::kOutputLevel, -4.0f);
+    engine.SetParameter(NamEngine::kCabActive, 1.0f);
+    engine.Prepare(kSyntheticSampleRate, 256);
+    LoadModel(engine, MakeWaveNetData(), 0);
+    const std::vector<float> ir = MakeIR(2000, 1);
+    engine.SetIRs(MakeIRSpectra(ir.data(), ir.size(), kSyntheticSampleRate, kSyntheticSampleRate, engine.GetPartitionSize()), nullptr);
+    return RunEngine(engine, input, 256);
+}
+}; // namespace
+
+NAM_TEST(ChainGains)
+{
+    // Input gain, a model that halves, output gain: nothing else touches the signal
+    NamEngine engine;
+    SetNeutral(engine);
+    engine.SetParameter(NeuralAmpModeler::kInputLevel, 6.0f);
+    engine.SetParameter(NeuralAmpModeler::kOutputLevel, -12.0f);
+    engine.SetParameter(NeuralAmpModeler::kEQActive, 1.0f);
+    engine.Prepare(kSyntheticSampleRate, 256);
+    LoadModel(engine, MakeGainData(0.5f), 0);
+
+    const std::vector<float> input = MakeInput(1.0);
+    const std::vector<float> output = RunEngine(engine, input, 256);
+    Expect(engine.GetLatencySamples() == 0, "Latency without resampling");
+    ExpectMatch(output, Scaled(input, FromDB(6.0) * 0.5 * FromDB(-12.0)), 1e-6, "Gains through the chain");
+}
+
+NAM_TEST(ChainUnprepared)
+{
+    // Process() before the first Prepare() has nowhere to run the chain, so it leaves the audio alone
+    NamEngine engine;
+    LoadModel(engine, MakeGainData(0.5f), 0);
+
+    const std::vector<float> input = MakeInput(0.1);
+    ExpectMatch(RunEngine(engine, input, 256), input, 0.0, "Audio before Prepare()");
+}
+
+NAM_TEST(ChainModelBlend)
+{
+    // 0.75 of a unity model and 0.25 of a tripling one, once the blend has ramped from the first model alone
+    NamEngine engine;
+    SetNeutral(engine);
+    engine.SetParameter(NeuralAmpModeler::kModelBlend, 0.25f);
+    engine.Prepare(kSyntheticSampleRate, 256);
+    LoadModel(engine, MakeGainData(1.0f), 0);
+    LoadModel(engine, MakeGainData(3.0f), 1);
+
+    const std::vector<float> input = MakeInput(1.0);
+    ExpectMatch(RunEngine(engine, input, 256), Scaled(input, 0.75 + 0.25 * 3.0), 1e-6, "Blend of two models",
+                (size_t)(0.05 * kSyntheticSampleRate));
+}
+
+NAM_TEST(ChainAlignsResampledModels)
+{
+    // A 44.1 kHz model is resampled and so comes out late; the 48 kHz one it's blended with has to be delayed to
+    // match, or their sum comb-filters. Both pass their input through, so the blend should too, only delayed.
+    NamEngine engine;
+    SetNeutral(engine);
+    engine.SetParameter(NeuralAmpModeler::kModelBlend, 0.5f);
+    engine.Prepare(kSyntheticSampleRate, 256);
+    LoadModel(engine, MakeGainData(1.0f, 48000.0), 0);
+    LoadModel(engine, MakeGainData(1.0f, 44100.0), 1);
+
+    const size_t length = (size_t)kSyntheticSampleRate;
+    std::vector<float> input(length, 0.0f);
+    const double frequencies[] = {300.0, 2500.0, 5000.0};
+    for (const double frequency : frequencies)
+    {
+        const std::vector<float> tone = MakeTone(frequency, 0.2, length, kSyntheticSampleRate);
+        for (size_t i = 0; i < length; i++)
+            input[i] += tone[i];
+    }
+    const std::vector<float> output = RunEngine(engine, input, 256);
+    const int latency = engine.GetLatencySamples();
+    Expect(latency > 0, "A resampled model should add latency");
+
+    const size_t start = length / 2, window = length / 2;
+    for (const double frequency : frequencies)
+    {
+        const std::complex<double> in = MeasureComponent(input, start, window, frequency, kSyntheticSampleRate);
+        const std::complex<double> out = MeasureComponent(output, start, window, frequency, kSyntheticSampleRate);
+        const std::string what = "At " + std::to_string((int)frequency) + " Hz";
+        ExpectNear(ToDB(std::abs(out) / std::abs(in)), 0.0, 0.3, what + ", gain in dB");
+        const double delay = std::remainder(std::arg(in) - std::arg(out), 2.0 * kPi) / (2.0 * kPi * frequency) * kSyntheticSampleRate;
+        ExpectNear(std::remainder(delay - latency, kSyntheticSampleRate / frequency), 0.0, 1.0, what + ", delay vs the latency");
+    }
+}
+
+NAM_TEST(ChainToneStackAndCab)
+{
+    // A unity model, then the tone stack and the cab: the cascade tone stack and direct convolution with the
+    // normalised IR, and the cab's makeup gain
+    NamEngine engine;
+    SetNeutral(engine);
+    engine.SetParameter(NeuralAmpModeler::kEQActive, 1.0f);
+    engine.SetParameter(NeuralAmpModeler::kToneBass, 7.0f);
+    engine.SetParameter(NeuralAmpModeler::kToneMid, 3.5f);
+    engine.SetParameter(NeuralAmpModeler::kToneTreble, 6.0f);
+    engine.SetParameter(NamEngine::kCabActive, 1.0f);
+    engine.Prepare(kSyntheticSampleRate, 256);
+    LoadModel(engine, MakeGainData(1.0f), 0);
+    const std::vector<float> ir = MakeIR(3000, 2);
+    engine.SetIRs(MakeIRSpectra(ir.data(), ir.size(), kSyntheticSampleRate, kSyntheticSampleRate, engine.GetPartitionSize()), nullptr);
+
+    const std::vector<float> input = MakeInput(1.0);
+    const double knobs[3] = {7.0, 3.5, 6.0};
+    dsp::tone_stack::BasicNamToneStack toneStack;
+    const std::vector<float> expected =
+        Scaled(Convolve(RunToneStack(toneStack, knobs, input, 64, kSyntheticSampleRate), NormaliseIR(ir)), kCabGain);
+
+    // The fused tone stack glides to the knobs from noon at the start
+    ExpectMatch(RunEngine(engine, input, 256), expected, 1e-4, "Tone stack and cab", (size_t)(0.25 * kSyntheticSampleRate));
+}
+
+NAM_TEST(ChainMatchesModel)
+{
+    // With everything else off, the chain's output is the model's, run on the same internal blocks
+    NamEngine engine;
+    SetNeutral(engine);
+    engine.Prepare(kSyntheticSampleRate, 512);
+    LoadModel(engine, MakeWaveNetData(), 0);
+
+    nam::dspData data = MakeWaveNetData();
+    std::unique_ptr<nam::DSP> model = BuildNamDSP(data);
+    const int blockSize = engine.GetAmp().getInternalBlockSize();
+    model->Reset(kSyntheticSampleRate, blockSize);
+
+    const std::vector<float> input = MakeInput(1.0);
+    std::vector<float> expected(input.size());
+    for (size_t offset = 0; offset < input.size(); offset += blockSize)
+        model->process(const_cast<float*>(input.data()) + offset, expected.data() + offset,
+                       (int)std::min<size_t>(blockSize, input.size() - offset));
+
+    ExpectMatch(RunEngine(engine, input, 512, false), expected, 1e-6, "Chain vs the model alone");
+}
+
+NAM_TEST(ChainGolden)
+{
+    ExpectMatchesGolden("chain-wavenet", RunFullChain(MakeInput(2.0)), 1e-4);
+}
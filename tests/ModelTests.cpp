@@ -0,0 +1,273 @@
+// Our execution paths against the core's (BlockLSTM, RingWaveNet with its packed weights, pruning), and against
+// their stored outputs; and our .nam reader against the core's.
+
+#include "BlockLSTM.h"
+#include "ModelFactory.h"
+#include "NamModelFile.h"
+#include "NamTest.h"
+#include "PackedMatrix.h"
+#include "RingWaveNet.h"
+#include "SyntheticModels.h"
+
+#include <get_dsp.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+namespace
+{
+// Float rounding (summation order, the vectorized activations) over a few seconds of audio
+const double kParityTolerance = 1e-4;
+
+// Output on the input, in blocks of blockSize
+std::vector<float> Run(nam::DSP& model, const std::vector<float>& input, const int blockSize)
+{
+    std::vector<float> output(input.size());
+    model.Reset(kSyntheticSampleRate, blockSize);
+    for (size_t offset = 0; offset < input.size(); offset += blockSize)
+    {
+        const int numFrames = (int)std::min<size_t>(blockSize, input.size() - offset);
+        model.process(const_cast<float*>(input.data()) + offset, output.data() + offset, numFrames);
+    }
+    return output;
+}
+
+// In blocks of every size up to maxBlockSize, in a random order, the way some hosts send them
+std::vector<float> RunRagged(nam::DSP& model, const std::vector<float>& input, const int maxBlockSize)
+{
+    std::vector<float> output(input.size());
+    model.Reset(kSyntheticSampleRate, maxBlockSize);
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> blockSizes(1, maxBlockSize);
+    for (size_t offset = 0; offset < input.size();)
+    {
+        const int numFrames = (int)std::min<size_t>(blockSizes(generator), input.size() - offset);
+        model.process(const_cast<float*>(input.data()) + offset, output.data() + offset, numFrames);
+        offset += numFrames;
+    }
+    return output;
+}
+
+// Builds the model both ways and compares them on the same input, at a fixed and at ragged block sizes
+void ExpectMatchesCore(const nam::dspData& data, const NamBuildOptions& options, const std::string& what)
+{
+    nam::dspData coreData = data;
+    std::unique_ptr<nam::DSP> core = nam::get_dsp(coreData);
+    nam::dspData oursData = data;
+    std::unique_ptr<nam::DSP> ours = BuildNamDSP(oursData, options);
+
+    const std::vector<float> input = MakeInput(2.0);
+    ExpectMatch(Run(*ours, input, 64), Run(*core, input, 64), kParityTolerance, what + ", blocks of 64");
+    ExpectMatch(RunRagged(*ours, input, 512), RunRagged(*core, input, 512), kParityTolerance, what + ", ragged blocks");
+}
+
+// The synthetic WaveNet with some channels made dead: residual channel 5 of the first array is written by
+// nothing, and layer 0's z channel 3 is read by neither the head nor the residual
+nam::dspData MakePrunableWaveNetData()
+{
+    nam::dspData data = MakeWaveNetData();
+    const int channels = 16;
+    const int numLayers = 10;
+    // The first array's weights: rechannel (channels x 1), then per layer the conv (channels x channels x 3, then
+    // the bias), the input mixin (channels x 1) and the 1x1 (channels x channels, then the bias); then the head
+    const size_t layerSize = 3 * channels * channels + channels + channels + channels * channels + channels;
+    const auto layerStart = [&](const int layer) { return channels + layer * layerSize; };
+    const size_t oneByOne = 3 * channels * channels + channels + channels;
+    const size_t head = layerStart(numLayers);
+
+    const int residual = 5;
+    data.weights[residual] = 0.0f;
+    for (int layer = 0; layer < numLayers; layer++)
+    {
+        for (int i = 0; i < channels; i++)
+            data.weights[layerStart(layer) + oneByOne + residual * channels + i] = 0.0f;
+        data.weights[layerStart(layer) + oneByOne + channels * channels + residual] = 0.0f;
+    }
+
+    const int z = 3;
+    for (int c = 0; c < channels; c++)
+        data.weights[layerStart(0) + oneByOne + c * channels + z] = 0.0f;
+    for (int h = 0; h < 8; h++)
+        data.weights[head + h * channels + z] = 0.0f;
+    return data;
+}
+
+std::vector<float> RunOurs(const nam::dspData& data)
+{
+    nam::dspData oursData = data;
+    std::unique_ptr<nam::DSP> ours = BuildNamDSP(oursData);
+    return Run(*ours, MakeInput(2.0), 64);
+}
+
+// A .nam file of the model, written to trip up a reader: the sample rate and the metadata after the weights,
+// escapes in the strings, and the weights in every form a float32 can be written in (shortest, 17 digits,
+// exponents either case, integers, negative zero, denormals), with uneven whitespace
+std::string MakeNamText(nam::dspData data)
+{
+    data.weights[1] = -0.0f;
+    data.weights[2] = 3.0f;
+    data.weights[3] = 1e-40f;
+    data.weights[4] = -2.5e-30f;
+
+    std::ostringstream text;
+    text << "{\"version\": " << nlohmann::json(data.version).dump() << ",\n  \"architecture\":" << nlohmann::json(data.architecture).dump()
+         << ", \"config\": " << data.config.dump(2) << ",\n\"weights\": [";
+    char number[40];
+    for (size_t i = 0; i < data.weights.size(); i++)
+    {
+        const float weight = data.weights[i];
+        if (i == 1)
+            std::snprintf(number, sizeof(number), "-0.0");
+        else if (i == 2)
+            std::snprintf(number, sizeof(number), "3");
+        else if (i % 4 == 0)
+            std::snprintf(number, sizeof(number), "%.9g", weight);
+        else if (i % 4 == 1)
+            std::snprintf(number, sizeof(number), "%.17g", (double)weight);
+        else if (i % 4 == 2)
+            std::snprintf(number, sizeof(number), "%.8e", weight);
+        else
+            std::snprintf(number, sizeof(number), "%.8E", weight);
+        text << (i == 0 ? "" : i % 7 == 0 ? ",\n\t" : ", ") << number;
+    }
+    text << " ],\n\"sample_rate\": 48000.0,\n\"metadata\": {\"name\": \"T\\u00e9st \\\"amp\\\" [1]\", \"loudness\": -12.5, "
+            "\"training\": {\"validation_esr\": 0.01, \"settings\": [1, 2, {\"x\": null}]}}}\n";
+    return text.str();
+}
+
+void ExpectSameData(const nam::dspData& actual, const nam::dspData& expected, const std::string& what)
+{
+    Expect(actual.version == expected.version, what + ": version");
+    Expect(actual.architecture == expected.architecture, what + ": architecture");
+    Expect(actual.config == expected.config, what + ": config");
+    Expect(actual.metadata == expected.metadata, what + ": metadata");
+    Expect(actual.expected_sample_rate == expected.expected_sample_rate, what + ": sample rate");
+    Expect(actual.weights.size() == expected.weights.size(), what + ": number of weights");
+    for (size_t i = 0; i < expected.weights.size(); i++)
+        Expect(std::memcmp(&actual.weights[i], &expected.weights[i], sizeof(float)) == 0, what + ": weight " + std::to_string(i));
+}
+
+// Reads the model's .nam file with ParseNamModel() and ReadNamModel() and with the core's reader, which parses it
+// through nlohmann's DOM; everything has to come out bit for bit the same, and so does the core's model
+void ExpectReadsLikeCore(const nam::dspData& data, const std::string& what)
+{
+    const std::string text = MakeNamText(data);
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / ("nam-tests-" + data.architecture + ".nam");
+    {
+        std::ofstream file(path, std::ios::binary);
+        Expect(bool(file << text), "Couldn't write " + path.u8string());
+    }
+
+    nam::dspData coreData;
+    std::unique_ptr<nam::DSP> core = nam::get_dsp(path, coreData);
+    const nam::dspData parsed = ParseNamModel(text.data(), text.size());
+    const nam::dspData streamed = ReadNamModel(path);
+    std::filesystem::remove(path);
+
+    ExpectSameData(parsed, coreData, what + ", ParseNamModel()");
+    ExpectSameData(streamed, coreData, what + ", ReadNamModel()");
+
+    nam::dspData streamedCopy = streamed;
+    std::unique_ptr<nam::DSP> fromStreamed = nam::get_dsp(streamedCopy);
+    const std::vector<float> input = MakeInput(0.5);
+    ExpectMatch(Run(*fromStreamed, input, 64), Run(*core, input, 64), 0.0, what + ", the core's model from either");
+}
+}; // namespace
+
+NAM_TEST(NamFileMatchesCoreReader)
+{
+    ExpectReadsLikeCore(MakeLSTMData(2, 8), "LSTM");
+    ExpectReadsLikeCore(MakeWaveNetData(), "WaveNet");
+}
+
+NAM_TEST(PackedMatrixMatchesEigen)
+{
+    // Every shape that the panels and the four-column kernel have a tail for
+    std::mt19937 generator(7);
+    std::normal_distribution<float> distribution(0.0f, 1.0f);
+    for (const int rows : {1, 7, 8, 9, 16, 20})
+    {
+        for (const int numFrames : {1, 3, 4, 5, 64})
+        {
+            const int firstRows = 5, secondRows = 3;
+            Eigen::MatrixXf weights(rows, firstRows + secondRows);
+            Eigen::VectorXf bias(rows);
+            Eigen::MatrixXf first(firstRows, numFrames), second(secondRows, numFrames), addend(rows, numFrames);
+            for (Eigen::MatrixXf* m : {&weights, &first, &second, &addend})
+                for (int i = 0; i < m->size(); i++)
+                    m->data()[i] = distribution(generator);
+            for (int i = 0; i < rows; i++)
+                bias(i) = distribution(generator);
+
+            DSPArena arena;
+            PackedMatrix packed;
+            arena.Build([&](DSPArena& a) { packed = PackedMatrix::Pack(a, weights, bias.data()); });
+
+            Eigen::MatrixXf stacked(firstRows + secondRows, numFrames);
+            stacked << first, second;
+            const Eigen::MatrixXf expected = (weights * stacked).colwise() + bias;
+            const PackedMatrix::Input inputs[] = {{first.data(), firstRows}, {second.data(), secondRows}};
+
+            Eigen::MatrixXf output(rows, numFrames);
+            packed.Multiply(inputs, 2, output.data(), numFrames);
+            const std::string shape = std::to_string(rows) + " rows, " + std::to_string(numFrames) + " frames";
+            Expect((output - expected).cwiseAbs().maxCoeff() < 1e-5f, "Product differs, " + shape);
+
+            // In place, on top of what's there
+            Eigen::MatrixXf accumulated = addend;
+            packed.Multiply(inputs, 2, accumulated.data(), numFrames, accumulated.data());
+            Expect((accumulated - (expected + addend)).cwiseAbs().maxCoeff() < 1e-5f, "Product plus addend differs, " + shape);
+        }
+    }
+}
+
+NAM_TEST(LSTMMatchesCore)
+{
+    for (const auto& shape : {std::pair<int, int>{1, 16}, {2, 8}, {1, 24}})
+    {
+        const nam::dspData data = MakeLSTMData(shape.first, shape.second);
+        nam::dspData oursData = data;
+        Expect(dynamic_cast<BlockLSTM*>(BuildNamDSP(oursData).get()) != nullptr, "LSTM wasn't built as a BlockLSTM");
+        ExpectMatchesCore(data, NamBuildOptions(),
+                          "LSTM " + std::to_string(shape.first) + "x" + std::to_string(shape.second));
+    }
+}
+
+NAM_TEST(WaveNetMatchesCore)
+{
+    const nam::dspData data = MakeWaveNetData();
+    nam::dspData oursData = data;
+    Expect(dynamic_cast<RingWaveNet*>(BuildNamDSP(oursData).get()) != nullptr, "WaveNet wasn't built as a RingWaveNet");
+    ExpectMatchesCore(data, NamBuildOptions(), "WaveNet");
+}
+
+NAM_TEST(PrunedWaveNetMatchesCore)
+{
+    const nam::dspData data = MakePrunableWaveNetData();
+    NamBuildOptions options;
+    options.pruneThreshold = 0.0f;
+
+    nam::dspData oursData = data;
+    NamPruneReport report;
+    BuildNamDSP(oursData, options, &report);
+    Expect(report.pruned && report.residualChannelsRemoved > 0 && report.layerChannelsRemoved > 0,
+           "The dead channels weren't pruned: " + report.ToString());
+    Expect(report.flopsAfter < report.flopsBefore, "Pruning saved nothing: " + report.ToString());
+
+    ExpectMatchesCore(data, options, "Pruned WaveNet");
+}
+
+NAM_TEST(LSTMGolden)
+{
+    ExpectMatchesGolden("lstm-1x16", RunOurs(MakeLSTMData(1, 16)), kParityTolerance);
+}
+
+NAM_TEST(WaveNetGolden)
+{
+    ExpectMatchesGolden("wavenet-standard", RunOurs(MakeWaveNetData()), kParityTolerance);
+}
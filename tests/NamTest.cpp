@@ -0,0 +1,256 @@
+// nam-tests: golden-output, parity and performance tests of the DSP chain (see NamTest.h).
+//
+//   nam-tests [--list] [--record] [NAME ...]
+//
+// Runs the tests named, or all of them. --record writes the golden files of the tests that are run instead of
+// checking against them. Exits with 0 if everything passed, 77 (CTest's SKIP_RETURN_CODE) if everything was
+// skipped, and 1 otherwise.
+
+#include "NamTest.h"
+#include "VectorActivations.h"
+
+#include <activations.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+#ifndef NAM_TESTS_DIR
+    #define NAM_TESTS_DIR "tests"
+#endif
+
+namespace
+{
+std::vector<std::pair<std::string, TestFunction>>& GetTests()
+{
+    static std::vector<std::pair<std::string, TestFunction>> tests;
+    return tests;
+}
+
+bool recording = false;
+
+std::string Format(const double value)
+{
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.3g", value);
+    return text;
+}
+
+std::map<std::string, PerfBudget> ReadPerfBaseline()
+{
+    const std::string path = std::string(NAM_TESTS_DIR) + "/perf-baseline.txt";
+    std::ifstream file(path);
+    if (!file.is_open())
+        throw TestFailure("Couldn't open " + path);
+
+    std::map<std::string, PerfBudget> budgets;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream fields(line);
+        std::string stage;
+        PerfBudget budget;
+        if (fields >> stage >> budget.maxNanosecondsPerSample >> budget.minSpeedup)
+            budgets[stage] = budget;
+    }
+    return budgets;
+}
+}; // namespace
+
+TestRegistration::TestRegistration(const char* name, TestFunction function)
+{
+    GetTests().emplace_back(name, function);
+}
+
+void Expect(const bool condition, const std::string& what)
+{
+    if (!condition)
+        throw TestFailure(what);
+}
+
+void ExpectNear(const double actual, const double expected, const double tolerance, const std::string& what)
+{
+    if (!(std::fabs(actual - expected) <= tolerance))
+        throw TestFailure(what + ": " + Format(actual) + ", expected " + Format(expected) + " +/- " + Format(tolerance));
+}
+
+double MaxDifference(const std::vector<float>& a, const std::vector<float>& b, const size_t start)
+{
+    Expect(a.size() == b.size(), "Outputs of different lengths");
+    double maxDifference = 0.0;
+    for (size_t i = start; i < a.size(); i++)
+    {
+        const double difference = std::fabs((double)a[i] - b[i]);
+        // NaN compares false, so it has to be caught here or it'd pass
+        if (std::isnan(difference))
+            return INFINITY;
+        maxDifference = std::max(maxDifference, difference);
+    }
+    return maxDifference;
+}
+
+void ExpectMatch(const std::vector<float>& actual, const std::vector<float>& expected, const double tolerance, const std::string& what,
+                 const size_t start)
+{
+    const double maxDifference = MaxDifference(actual, expected, start);
+    if (!(maxDifference <= tolerance))
+        throw TestFailure(what + ": max |diff| " + Format(maxDifference) + " > " + Format(tolerance));
+    std::cout << what << ": max |diff| " << Format(maxDifference) << std::endl;
+}
+
+void ExpectMatchesGolden(const std::string& name, const std::vector<float>& output, const double tolerance, const size_t stride)
+{
+    const std::string path = std::string(NAM_TESTS_DIR) + "/golden/" + name + ".txt";
+    if (recording)
+    {
+        std::ofstream file(path);
+        if (!file.is_open())
+            throw TestFailure("Couldn't write " + path);
+        file << "# nam-tests golden output: every " << stride << "th sample of " << output.size() << std::endl;
+        file << stride << " " << output.size() << std::endl;
+        char text[32];
+        for (size_t i = 0; i < output.size(); i += stride)
+        {
+            std::snprintf(text, sizeof(text), "%.9g", output[i]);
+            file << text << std::endl;
+        }
+        std::cout << "Recorded " << path << std::endl;
+        return;
+    }
+
+    std::ifstream file(path);
+    if (!file.is_open())
+        throw TestFailure("No " + path + "; `nam-tests --record` with this test makes it");
+    std::string comment;
+    std::getline(file, comment);
+    size_t goldenStride = 0, goldenSize = 0;
+    file >> goldenStride >> goldenSize;
+    Expect(goldenStride == stride && goldenSize == output.size(), path + " was recorded for a different output");
+
+    double maxDifference = 0.0;
+    size_t worst = 0;
+    for (size_t i = 0; i < output.size(); i += stride)
+    {
+        float expected;
+        Expect(bool(file >> expected), path + " is short");
+        const double difference = std::fabs((double)output[i] - expected);
+        if (std::isnan(difference) || difference > maxDifference)
+        {
+            maxDifference = std::isnan(difference) ? INFINITY : difference;
+            worst = i;
+        }
+    }
+    if (!(maxDifference <= tolerance))
+        throw TestFailure(name + " differs from its golden output by " + Format(maxDifference) + " at sample " + std::to_string(worst)
+                          + " (tolerance " + Format(tolerance) + ")");
+    std::cout << name << ": max |diff| from golden " << Format(maxDifference) << std::endl;
+}
+
+PerfBudget GetPerfBudget(const std::string& stage)
+{
+#ifndef NDEBUG
+    throw TestSkipped("Performance budgets are only checked in optimised (NDEBUG) builds");
+#endif
+    static const std::map<std::string, PerfBudget> budgets = ReadPerfBaseline();
+    const auto budget = budgets.find(stage);
+    if (budget == budgets.end())
+        throw TestFailure("No budget for " + stage + " in perf-baseline.txt");
+    return budget->second;
+}
+
+double TimePerSample(const std::function<void()>& run, const size_t numSamples)
+{
+    // Once to warm up, then the best of a few, which is the least disturbed by whatever else is running
+    run();
+    const int numRuns = 5;
+    double best = 1e300;
+    for (int i = 0; i < numRuns; i++)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        run();
+        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count() / numSamples);
+    }
+    return best;
+}
+
+void ExpectWithinBudget(const std::string& stage, const double nanosecondsPerSample, const double referenceNanosecondsPerSample)
+{
+    const PerfBudget budget = GetPerfBudget(stage);
+    std::cout << stage << ": " << Format(nanosecondsPerSample) << " ns/sample (budget " << Format(budget.maxNanosecondsPerSample) << ")";
+    if (referenceNanosecondsPerSample > 0.0)
+        std::cout << ", " << Format(referenceNanosecondsPerSample / nanosecondsPerSample) << "x the reference (at least "
+                  << Format(budget.minSpeedup) << "x)";
+    std::cout << std::endl;
+
+    Expect(nanosecondsPerSample <= budget.maxNanosecondsPerSample, stage + " is over its budget");
+    if (referenceNanosecondsPerSample > 0.0 && budget.minSpeedup > 0.0)
+        Expect(referenceNanosecondsPerSample / nanosecondsPerSample >= budget.minSpeedup, stage + " fell below its speedup");
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> names;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--record")
+            recording = true;
+        else if (arg == "--list")
+        {
+            for (const auto& test : GetTests())
+                std::cout << test.first << std::endl;
+            return 0;
+        }
+        else
+            names.push_back(arg);
+    }
+    if (names.empty())
+        for (const auto& test : GetTests())
+            names.push_back(test.first);
+
+    // Same activations as the plugin
+    VectorActivations::Install();
+    nam::activations::Activation::enable_fast_tanh();
+
+    int numPassed = 0, numSkipped = 0, numFailed = 0;
+    for (const std::string& name : names)
+    {
+        const auto test =
+            std::find_if(GetTests().begin(), GetTests().end(), [&name](const auto& t) { return t.first == name; });
+        if (test == GetTests().end())
+        {
+            std::cerr << "No test called " << name << std::endl;
+            numFailed++;
+            continue;
+        }
+
+        try
+        {
+            test->second();
+            std::cout << "PASSED " << name << std::endl;
+            numPassed++;
+        }
+        catch (TestSkipped& e)
+        {
+            std::cout << "SKIPPED " << name << ": " << e.what() << std::endl;
+            numSkipped++;
+        }
+        catch (std::exception& e)
+        {
+            std::cout << "FAILED " << name << ": " << e.what() << std::endl;
+            numFailed++;
+        }
+    }
+
+    if (numFailed > 0)
+        return 1;
+    return numPassed == 0 && numSkipped > 0 ? 77 : 0;
+}
@@ -0,0 +1,71 @@
+#ifndef __NAM_TEST_H__
+#define __NAM_TEST_H__
+
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// The little that nam-tests needs to be a test runner. A test is a function defined with NAM_TEST(Name), which
+// passes by returning and fails by throwing; CTest runs each one on its own, as `nam-tests Name` (see
+// CMakeLists.txt, where every test has to be listed as well).
+//
+// Two kinds of reference are checked against:
+//   - Stored outputs (golden files in tests/golden/): the output of a stage on a fixed input, sampled at fixed
+//     points. `nam-tests --record Name` writes them again, for when a change of output is intended.
+//   - Performance budgets (tests/perf-baseline.txt): for each stage, the most nanoseconds per sample it may take,
+//     and the least speedup over the implementation it replaced. Perf tests only run in optimised builds.
+
+struct TestFailure : std::runtime_error
+{
+    using std::runtime_error::runtime_error;
+};
+
+// Thrown to skip a test that can't run here; CTest counts it as skipped rather than passed
+struct TestSkipped : std::runtime_error
+{
+    using std::runtime_error::runtime_error;
+};
+
+using TestFunction = void (*)();
+
+struct TestRegistration
+{
+    TestRegistration (const char* name, TestFunction function);
+};
+
+#define NAM_TEST(name)                                                                                                 \
+    static void name();                                                                                                \
+    static const TestRegistration name##Registration(#name, name);                                                     \
+    static void name()
+
+// Throw TestFailure with what, if the condition doesn't hold
+void Expect (const bool condition, const std::string& what);
+void ExpectNear (const double actual, const double expected, const double tolerance, const std::string& what);
+
+// Largest |a[i] - b[i]| from start on; the vectors must be the same size
+double MaxDifference (const std::vector<float>& a, const std::vector<float>& b, const size_t start = 0);
+void ExpectMatch (const std::vector<float>& actual, const std::vector<float>& expected, const double tolerance,
+                  const std::string& what, const size_t start = 0);
+
+// Compares every stride-th sample of output with tests/golden/<name>.txt (a missing file fails), or writes that
+// file if recording
+void ExpectMatchesGolden (const std::string& name, const std::vector<float>& output, const double tolerance, const size_t stride = 97);
+
+struct PerfBudget
+{
+    double maxNanosecondsPerSample = 0.0;
+    // 0 if the stage has nothing to be compared with
+    double minSpeedup = 0.0;
+};
+
+// The stage's line in tests/perf-baseline.txt; fails the test if there isn't one. Skips the test in unoptimised
+// builds, where the numbers mean nothing.
+PerfBudget GetPerfBudget (const std::string& stage);
+// Best of a few calls of run, which processes numSamples samples, in nanoseconds per sample
+double TimePerSample (const std::function<void()>& run, const size_t numSamples);
+// Prints the measurement, and fails if it's over budget
+void ExpectWithinBudget (const std::string& stage, const double nanosecondsPerSample, const double referenceNanosecondsPerSample = 0.0);
+
+#endif
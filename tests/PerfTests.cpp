@@ -0,0 +1,237 @@
+// Per-stage performance budgets, from tests/perf-baseline.txt. Where a stage replaced something (the core's
+// models, the cascade tone stack, a convolver per cab IR), it's also timed against that, which doesn't depend on
+// how fast the machine is.
+// Only run in optimised builds; `ctest -L perf` runs these alone, `ctest -LE perf` everything else.
+
+#include "IRStore.h"
+#include "ModelFactory.h"
+#include "NamEngine.h"
+#include "NamTest.h"
+#include "PartitionedConvolver.h"
+#include "SyntheticModels.h"
+#include "TestSupport.h"
+
+#include <get_dsp.h>
+#include <juce_dsp/juce_dsp.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace
+{
+const int kBlockSize = 64;
+
+double TimeModel(nam::DSP& model, std::vector<float>& input, std::vector<float>& output)
+{
+    model.Reset(kSyntheticSampleRate, kBlockSize);
+    return TimePerSample(
+        [&]()
+        {
+            for (size_t offset = 0; offset < input.size(); offset += kBlockSize)
+                model.process(input.data() + offset, output.data() + offset, (int)std::min<size_t>(kBlockSize, input.size() - offset));
+        },
+        input.size());
+}
+
+// Ours against the core's
+void CheckModel(const std::string& stage, const nam::dspData& data)
+{
+    nam::dspData coreData = data;
+    std::unique_ptr<nam::DSP> core = nam::get_dsp(coreData);
+    nam::dspData oursData = data;
+    std::unique_ptr<nam::DSP> ours = BuildNamDSP(oursData);
+
+    std::vector<float> input = MakeInput(2.0);
+    std::vector<float> output(input.size());
+    const double coreTime = TimeModel(*core, input, output);
+    const double oursTime = TimeModel(*ours, input, output);
+    ExpectWithinBudget(stage, oursTime, coreTime);
+}
+
+double TimeToneStack(dsp::tone_stack::AbstractToneStack& toneStack, const std::vector<float>& input)
+{
+    const double knobs[3] = {7.0, 3.5, 6.0};
+    return TimePerSample([&]() { RunToneStack(toneStack, knobs, input, kBlockSize, kSyntheticSampleRate); }, input.size());
+}
+
+// The cab blend: two half-second IRs, half and half, in blocks of kConvolverBlockSize
+const int kConvolverBlockSize = 128;
+const float kCabBlend = 0.5f;
+
+std::vector<float> MakeCabIR(const unsigned int seed)
+{
+    return MakeIR((size_t)(0.5 * kSyntheticSampleRate), seed);
+}
+
+// Both IRs in one convolver
+double TimeBlendedConvolver(const std::vector<float>& input)
+{
+    const std::vector<float> first = MakeCabIR(1), second = MakeCabIR(2);
+    PartitionedConvolver convolver(MakeIRSpectra(first.data(), first.size(), kSyntheticSampleRate, kSyntheticSampleRate, kConvolverBlockSize),
+                                   MakeIRSpectra(second.data(), second.size(), kSyntheticSampleRate, kSyntheticSampleRate, kConvolverBlockSize));
+    convolver.SetBlend(kCabBlend);
+    convolver.Reset();
+
+    std::vector<float> data(input.size());
+    return TimePerSample(
+        [&]()
+        {
+            std::copy(input.begin(), input.end(), data.begin());
+            for (size_t offset = 0; offset < data.size(); offset += kConvolverBlockSize)
+                convolver.Process(data.data() + offset, (int)std::min<size_t>(kConvolverBlockSize, data.size() - offset));
+        },
+        data.size());
+}
+
+// A convolver per IR, each on its own copy of the input, and their outputs mixed: what the blend replaced.
+// process(index, data, numFrames) runs the index-th IR's convolver.
+double TimeTwoConvolvers(const std::vector<float>& input, const std::function<void(int, float*, int)>& process)
+{
+    std::vector<float> first(input.size()), second(input.size());
+    return TimePerSample(
+        [&]()
+        {
+            std::copy(input.begin(), input.end(), first.begin());
+            std::copy(input.begin(), input.end(), second.begin());
+            for (size_t offset = 0; offset < input.size(); offset += kConvolverBlockSize)
+            {
+                const int numFrames = (int)std::min<size_t>(kConvolverBlockSize, input.size() - offset);
+                process(0, first.data() + offset, numFrames);
+                process(1, second.data() + offset, numFrames);
+                for (int i = 0; i < numFrames; i++)
+                    first[offset + i] = (1.0f - kCabBlend) * first[offset + i] + kCabBlend * second[offset + i];
+            }
+        },
+        input.size());
+}
+
+void ProcessJuce(juce::dsp::Convolution& convolution, float* data, const int numFrames)
+{
+    float* channels[] = {data};
+    juce::dsp::AudioBlock<float> block(channels, 1, (size_t)numFrames);
+    convolution.process(juce::dsp::ProcessContextReplacing<float>(block));
+}
+
+// juce::dsp::Convolution prepares an IR on a thread of its own, and swaps it in on a later process() call
+void LoadJuceIR(juce::dsp::Convolution& convolution, const std::vector<float>& ir)
+{
+    convolution.prepare({kSyntheticSampleRate, (juce::uint32)kConvolverBlockSize, 1});
+    juce::AudioBuffer<float> buffer(1, (int)ir.size());
+    buffer.copyFrom(0, 0, ir.data(), (int)ir.size());
+    convolution.loadImpulseResponse(std::move(buffer), kSyntheticSampleRate, juce::dsp::Convolution::Stereo::no,
+                                    juce::dsp::Convolution::Trim::no, juce::dsp::Convolution::Normalise::yes);
+
+    std::vector<float> silence(kConvolverBlockSize);
+    for (int attempt = 0; attempt < 500 && convolution.getCurrentIRSize() != (int)ir.size(); attempt++)
+    {
+        std::fill(silence.begin(), silence.end(), 0.0f);
+        ProcessJuce(convolution, silence.data(), kConvolverBlockSize);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    Expect(convolution.getCurrentIRSize() == (int)ir.size(), "juce::dsp::Convolution didn't load the IR");
+    convolution.reset();
+}
+}; // namespace
+
+NAM_TEST(PerfLSTM)
+{
+    GetPerfBudget("lstm-1x16");
+    CheckModel("lstm-1x16", MakeLSTMData(1, 16));
+}
+
+NAM_TEST(PerfWaveNet)
+{
+    GetPerfBudget("wavenet-standard");
+    CheckModel("wavenet-standard", MakeWaveNetData());
+}
+
+NAM_TEST(PerfToneStack)
+{
+    GetPerfBudget("tonestack-fused");
+    const std::vector<float> input = MakeInput(5.0);
+    dsp::tone_stack::BasicNamToneStack basic;
+    dsp::tone_stack::FusedToneStack fused;
+    const double basicTime = TimeToneStack(basic, input);
+    const double fusedTime = TimeToneStack(fused, input);
+    ExpectWithinBudget("tonestack-fused", fusedTime, basicTime);
+}
+
+NAM_TEST(PerfConvolver)
+{
+    // Half a second of IR, in partitions the size of the blocks
+    GetPerfBudget("convolver-0.5s");
+    const std::vector<float> ir = MakeIR((size_t)(0.5 * kSyntheticSampleRate), 1);
+    PartitionedConvolver convolver(MakeIRSpectra(ir.data(), ir.size(), kSyntheticSampleRate, kSyntheticSampleRate, 128));
+    convolver.Reset();
+
+    std::vector<float> data = MakeInput(2.0);
+    const double time = TimePerSample(
+        [&]()
+        {
+            for (size_t offset = 0; offset < data.size(); offset += 128)
+                convolver.Process(data.data() + offset, (int)std::min<size_t>(128, data.size() - offset));
+        },
+        data.size());
+    ExpectWithinBudget("convolver-0.5s", time);
+}
+
+NAM_TEST(PerfConvolverBlend)
+{
+    // The blend costs about what one IR does, against a convolver per IR
+    GetPerfBudget("convolver-blend-0.5s");
+    const std::vector<float> input = MakeInput(2.0);
+    const std::vector<float> irs[2] = {MakeCabIR(1), MakeCabIR(2)};
+    std::unique_ptr<PartitionedConvolver> convolvers[2];
+    for (int i = 0; i < 2; i++)
+    {
+        convolvers[i] = std::make_unique<PartitionedConvolver>(
+            MakeIRSpectra(irs[i].data(), irs[i].size(), kSyntheticSampleRate, kSyntheticSampleRate, kConvolverBlockSize));
+        convolvers[i]->Reset();
+    }
+
+    const double twoTime = TimeTwoConvolvers(input, [&](const int index, float* data, const int numFrames)
+                                             { convolvers[index]->Process(data, numFrames); });
+    const double blendedTime = TimeBlendedConvolver(input);
+    ExpectWithinBudget("convolver-blend-0.5s", blendedTime, twoTime);
+}
+
+NAM_TEST(PerfConvolverBlendJuce)
+{
+    // The same, against what the plugin would otherwise do: a juce::dsp::Convolution per IR (zero latency,
+    // uniformly partitioned in blocks of the same size)
+    GetPerfBudget("convolver-blend-juce");
+    const std::vector<float> input = MakeInput(2.0);
+    juce::dsp::Convolution convolutions[2];
+    LoadJuceIR(convolutions[0], MakeCabIR(1));
+    LoadJuceIR(convolutions[1], MakeCabIR(2));
+
+    const double juceTime = TimeTwoConvolvers(input, [&](const int index, float* data, const int numFrames)
+                                              { ProcessJuce(convolutions[index], data, numFrames); });
+    const double blendedTime = TimeBlendedConvolver(input);
+    ExpectWithinBudget("convolver-blend-juce", blendedTime, juceTime);
+}
+
+NAM_TEST(PerfChain)
+{
+    // Gate, the standard WaveNet, tone stack and a cab, in host blocks of 256
+    GetPerfBudget("chain-wavenet");
+    NamEngine engine;
+    engine.SetParameter(NeuralAmpModeler::kToneBass, 7.0f);
+    engine.Prepare(kSyntheticSampleRate, 256);
+    Expect(engine.LoadModel(MakeWaveNetData(), 0), "Couldn't load the model");
+    const std::vector<float> ir = MakeIR(4096, 1);
+    engine.SetIRs(MakeIRSpectra(ir.data(), ir.size(), kSyntheticSampleRate, kSyntheticSampleRate, engine.GetPartitionSize()), nullptr);
+
+    const std::vector<float> input = MakeInput(2.0);
+    std::vector<float> data(input.size());
+    const double time = TimePerSample(
+        [&]()
+        {
+            std::copy(input.begin(), input.end(), data.begin());
+            for (size_t offset = 0; offset < data.size(); offset += 256)
+                engine.Process(data.data() + offset, (int)std::min<size_t>(256, data.size() - offset));
+        },
+        data.size());
+    ExpectWithinBudget("chain-wavenet", time);
+}
@@ -0,0 +1,344 @@
+// The chain's stages on their own: the noise gate trigger, the tone stacks, resampling around a model, and the
+// cab's convolver. Their references are worked out from first principles (the trigger's time constants, the
+// filters' transfer functions, direct convolution), so they hold on any machine.
+
+#include "IRStore.h"
+#include "ModelFactory.h"
+#include "NamTest.h"
+#include "PartitionedConvolver.h"
+#include "ResamplingNAM.h"
+#include "StatusedTrigger.h"
+#include "SyntheticModels.h"
+#include "TestSupport.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace
+{
+const double kPi = 3.14159265358979323846;
+
+enum class Shape
+{
+    LowShelf,
+    Peaking,
+    HighShelf
+};
+
+// |H| of an Audio EQ Cookbook shelf or peak at frequency, in dB
+double BiquadResponseDB(const Shape shape, const double centre, const double quality, const double gainDB, const double frequency,
+                        const double sampleRate)
+{
+    const double a = std::pow(10.0, gainDB / 40.0);
+    const double w0 = 2.0 * kPi * centre / sampleRate;
+    const double alpha = std::sin(w0) / (2.0 * quality);
+    const double c = std::cos(w0);
+    const double s = 2.0 * std::sqrt(a) * alpha;
+
+    double b[3], d[3];
+    if (shape == Shape::LowShelf)
+    {
+        b[0] = a * ((a + 1) - (a - 1) * c + s), b[1] = 2 * a * ((a - 1) - (a + 1) * c), b[2] = a * ((a + 1) - (a - 1) * c - s);
+        d[0] = (a + 1) + (a - 1) * c + s, d[1] = -2 * ((a - 1) + (a + 1) * c), d[2] = (a + 1) + (a - 1) * c - s;
+    }
+    else if (shape == Shape::Peaking)
+    {
+        b[0] = 1 + alpha * a, b[1] = -2 * c, b[2] = 1 - alpha * a;
+        d[0] = 1 + alpha / a, d[1] = -2 * c, d[2] = 1 - alpha / a;
+    }
+    else
+    {
+        b[0] = a * ((a + 1) + (a - 1) * c + s), b[1] = -2 * a * ((a - 1) + (a + 1) * c), b[2] = a * ((a + 1) + (a - 1) * c - s);
+        d[0] = (a + 1) - (a - 1) * c + s, d[1] = 2 * ((a - 1) - (a + 1) * c), d[2] = (a + 1) - (a - 1) * c - s;
+    }
+
+    const std::complex<double> z1 = std::polar(1.0, -2.0 * kPi * frequency / sampleRate);
+    const std::complex<double> z2 = z1 * z1;
+    return ToDB(std::abs((b[0] + b[1] * z1 + b[2] * z2) / (d[0] + d[1] * z1 + d[2] * z2)));
+}
+
+// BasicNamToneStack's knobs, as the three bands it sets (see ToneStack.cpp)
+double ToneStackResponseDB(const double bass, const double middle, const double treble, const double frequency, const double sampleRate)
+{
+    const double midGainDB = 3.0 * (middle - 5.0);
+    return BiquadResponseDB(Shape::LowShelf, 150.0, 0.707, 4.0 * (bass - 5.0), frequency, sampleRate)
+           + BiquadResponseDB(Shape::Peaking, 425.0, midGainDB < 0.0 ? 1.5 : 0.7, midGainDB, frequency, sampleRate)
+           + BiquadResponseDB(Shape::HighShelf, 1800.0, 0.707, 2.0 * (treble - 5.0), frequency, sampleRate);
+}
+
+// The cascade keeps its filters' state in float, and the bass shelf's poles are close to 1, so its rounding builds
+// up to near 1e-4 with the bass up
+const double kToneStackTolerance = 2e-4;
+
+const double kKnobSettings[][3] = {{5.0, 5.0, 5.0}, {10.0, 5.0, 5.0}, {5.0, 0.0, 5.0}, {5.0, 8.0, 5.0}, {5.0, 5.0, 0.0}, {7.0, 3.5, 6.0},
+                                   {0.0, 10.0, 10.0}};
+
+std::vector<float> RunConvolver(PartitionedConvolver& convolver, const std::vector<float>& input, const unsigned int seed,
+                                const int maxBlockSize)
+{
+    std::vector<float> output = input;
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<int> blockSizes(1, maxBlockSize);
+    for (size_t offset = 0; offset < output.size();)
+    {
+        const int numFrames = (int)std::min<size_t>(blockSizes(generator), output.size() - offset);
+        convolver.Process(output.data() + offset, numFrames);
+        offset += numFrames;
+    }
+    return output;
+}
+}; // namespace
+
+NAM_TEST(StatusedTriggerGating)
+{
+    const double sampleRate = 48000.0;
+    const double time = 0.05, threshold = -60.0, ratio = 1.5, openTime = 0.002, holdTime = 0.05, closeTime = 0.05;
+    StatusedTrigger trigger;
+    trigger.SetSampleRate(sampleRate);
+    trigger.SetParams(dsp::noise_gate::TriggerParams(time, threshold, ratio, openTime, holdTime, closeTime));
+
+    // Silence; a tone; silence long enough for the level to reach the floor; the tone again
+    const double amplitude = 0.5;
+    const size_t onset = (size_t)(0.2 * sampleRate), release = (size_t)(0.7 * sampleRate), reonset = (size_t)(3.2 * sampleRate),
+                 end = (size_t)(3.5 * sampleRate);
+    std::vector<float> input = MakeTone(440.0, amplitude, end, sampleRate);
+    std::fill(input.begin(), input.begin() + onset, 0.0f);
+    std::fill(input.begin() + release, input.begin() + reonset, 0.0f);
+
+    // Gain reduction per sample, and the gating status at the end of each sample's block
+    const int blockSize = 64;
+    std::vector<double> gainReduction(end);
+    std::vector<bool> gating(end);
+    for (size_t offset = 0; offset < end; offset += blockSize)
+    {
+        const int numFrames = (int)std::min<size_t>(blockSize, end - offset);
+        float* block = input.data() + offset;
+        trigger.Process(&block, 1, numFrames);
+        const std::vector<float>& blockReduction = trigger.GetGainReductionDB()[0];
+        for (int i = 0; i < numFrames; i++)
+        {
+            gainReduction[offset + i] = blockReduction[i];
+            gating[offset + i] = trigger.isGating();
+        }
+    }
+
+    const double floorDB = dsp::noise_gate::MINIMUM_LOUDNESS_DB;
+    const double maxReduction = -ratio * (floorDB - threshold) * (floorDB - threshold);
+    const auto at = [sampleRate](const size_t start, const double seconds) { return start + (size_t)(seconds * sampleRate); };
+
+    // Closed all the way on silence
+    for (size_t i = 0; i < onset; i++)
+        ExpectNear(gainReduction[i], maxReduction, 1e-9, "Gain reduction before the tone");
+
+    // Opens at its open rate: still mostly closed a quarter of the way through, open a few ms after
+    Expect(gainReduction[at(onset, 0.25 * openTime)] < 0.5 * maxReduction, "The gate opened faster than its open time");
+    for (size_t i = at(onset, 0.005); i < release; i++)
+    {
+        Expect(gainReduction[i] > -0.01 && gainReduction[i] <= 0.0, "The gate isn't open " + std::to_string(i) + " samples in");
+        Expect(!gating[i], "Gating while the tone plays");
+    }
+
+    // The level follower halves the power every `time`: the level falls below the threshold this long after the
+    // tone stops, and the gate starts to close no later than a hold time after that
+    const double toneDB = ToDB(amplitude / std::sqrt(2.0));
+    const double belowSeconds = time * (toneDB - threshold) / ToDB(std::sqrt(2.0));
+    size_t close = release;
+    while (close < reonset && gainReduction[close] == 0.0)
+        close++;
+    ExpectNear((double)(close - release) / sampleRate, belowSeconds + 0.5 * holdTime, 0.5 * holdTime + 0.005,
+               "Seconds after the tone until the gate closes");
+
+    for (size_t i = close + blockSize; i < reonset; i++)
+    {
+        Expect(gating[i], "Not gating in silence, " + std::to_string(i) + " samples in");
+        Expect(gainReduction[i] <= gainReduction[i - 1], "The gate opened up again in silence");
+    }
+    // Once the level has fallen to the floor
+    ExpectNear(gainReduction[reonset - 1], maxReduction, 1e-3, "Gain reduction after the level reached the floor");
+
+    // And opens again
+    for (size_t i = at(reonset, 0.005); i < end; i++)
+        Expect(gainReduction[i] > -0.01, "The gate didn't open again");
+    Expect(!gating[end - 1], "Still gating after the tone came back");
+}
+
+NAM_TEST(ToneStackResponse)
+{
+    // Steady-state gain of BasicNamToneStack, at frequencies that go into the measuring window a whole number of times
+    const double sampleRate = 48000.0;
+    const size_t length = (size_t)(0.5 * sampleRate), settle = (size_t)(0.25 * sampleRate), window = length - settle;
+    for (const auto& knobs : kKnobSettings)
+    {
+        for (const double frequency : {52.0, 152.0, 424.0, 1000.0, 1800.0, 6000.0, 16000.0})
+        {
+            const std::vector<float> input = MakeTone(frequency, 0.25, length, sampleRate);
+            dsp::tone_stack::BasicNamToneStack toneStack;
+            const std::vector<float> output = RunToneStack(toneStack, knobs, input, 64, sampleRate);
+
+            const double measuredDB = ToDB(std::abs(MeasureComponent(output, settle, window, frequency, sampleRate)) / 0.25);
+            const double expectedDB = ToneStackResponseDB(knobs[0], knobs[1], knobs[2], frequency, sampleRate);
+            char what[128];
+            std::snprintf(what, sizeof(what), "Gain in dB at %.0f Hz, bass %.1f middle %.1f treble %.1f", frequency, knobs[0], knobs[1],
+                          knobs[2]);
+            ExpectNear(measuredDB, expectedDB, 0.01, what);
+        }
+    }
+}
+
+NAM_TEST(FusedToneStackMatchesBasic)
+{
+    const std::vector<float> input = MakeInput(2.0);
+    for (const auto& knobs : kKnobSettings)
+    {
+        for (const int blockSize : {1, 64, 500})
+        {
+            dsp::tone_stack::BasicNamToneStack basic;
+            dsp::tone_stack::FusedToneStack fused;
+            char what[128];
+            std::snprintf(what, sizeof(what), "Fused vs cascade, bass %.1f middle %.1f treble %.1f, blocks of %d", knobs[0], knobs[1],
+                          knobs[2], blockSize);
+            ExpectMatch(RunToneStack(fused, knobs, input, blockSize, kSyntheticSampleRate),
+                        RunToneStack(basic, knobs, input, blockSize, kSyntheticSampleRate), kToneStackTolerance, what);
+        }
+    }
+
+    // When a knob moves, the fused stack glides where the cascade jumps; once the glide and what it left in the
+    // filters' state have died away, they're the same again
+    const size_t changeAt = 64 * 750;
+    for (size_t s = 0; s + 1 < std::size(kKnobSettings); s++)
+    {
+        dsp::tone_stack::BasicNamToneStack basic;
+        dsp::tone_stack::FusedToneStack fused;
+        const std::vector<float> basicOutput =
+            RunToneStack(basic, kKnobSettings[s], input, 64, kSyntheticSampleRate, changeAt, kKnobSettings[s + 1]);
+        const std::vector<float> fusedOutput =
+            RunToneStack(fused, kKnobSettings[s], input, 64, kSyntheticSampleRate, changeAt, kKnobSettings[s + 1]);
+        ExpectMatch(fusedOutput, basicOutput, kToneStackTolerance, "Fused vs cascade after a knob move", changeAt + (size_t)(0.25 * kSyntheticSampleRate));
+    }
+}
+
+NAM_TEST(ResamplingNAMMismatchedRates)
+{
+    // A model that passes its input straight through, at a rate other than the host's: the output should be the
+    // input, delayed by the latency that's reported, with nothing added
+    const struct
+    {
+        double modelRate, hostRate;
+    } rates[] = {{48000.0, 48000.0}, {48000.0, 44100.0}, {44100.0, 48000.0}, {48000.0, 96000.0}, {44100.0, 88200.0}};
+
+    for (const auto& rate : rates)
+    {
+        nam::dspData data = MakeGainData(1.0f, rate.modelRate);
+        ResamplingNAM model(BuildNamDSP(data), rate.hostRate);
+        const int blockSize = 64;
+        model.Reset(rate.hostRate, blockSize);
+
+        const double low = 300.0, high = 2500.0;
+        const size_t length = (size_t)rate.hostRate;
+        std::vector<float> input = MakeTone(low, 0.3, length, rate.hostRate);
+        const std::vector<float> highTone = MakeTone(high, 0.2, length, rate.hostRate);
+        for (size_t i = 0; i < length; i++)
+            input[i] += highTone[i];
+
+        std::vector<float> output(length);
+        for (size_t offset = 0; offset < length; offset += blockSize)
+            model.process(input.data() + offset, output.data() + offset, (int)std::min<size_t>(blockSize, length - offset));
+
+        const int latency = model.GetLatency();
+        const std::string what = std::to_string((int)rate.modelRate) + " Hz model at " + std::to_string((int)rate.hostRate) + " Hz";
+        if (rate.modelRate == rate.hostRate)
+        {
+            Expect(latency == 0, "Latency without resampling");
+            ExpectMatch(output, input, 0.0, what);
+            continue;
+        }
+
+        // Over the second half second, which each tone goes into a whole number of times
+        const size_t start = length / 2, window = length / 2;
+        const std::complex<double> inLow = MeasureComponent(input, start, window, low, rate.hostRate);
+        const std::complex<double> outLow = MeasureComponent(output, start, window, low, rate.hostRate);
+        const std::complex<double> inHigh = MeasureComponent(input, start, window, high, rate.hostRate);
+        const std::complex<double> outHigh = MeasureComponent(output, start, window, high, rate.hostRate);
+        ExpectNear(ToDB(std::abs(outLow) / std::abs(inLow)), 0.0, 0.1, what + ", gain at 300 Hz in dB");
+        ExpectNear(ToDB(std::abs(outHigh) / std::abs(inHigh)), 0.0, 0.1, what + ", gain at 2.5 kHz in dB");
+
+        // The phase lag of the low tone is the delay
+        const double lag = std::remainder(std::arg(inLow) - std::arg(outLow), 2.0 * kPi);
+        ExpectNear(lag / (2.0 * kPi * low) * rate.hostRate, latency, 1.0, what + ", delay in samples vs the reported latency");
+
+        // Whatever isn't the two tones is aliasing or imaging
+        double residual = 0.0, total = 0.0;
+        for (size_t i = start; i < start + window; i++)
+        {
+            const double expected = std::real(outLow * std::polar(1.0, 2.0 * kPi * low * i / rate.hostRate)
+                                              + outHigh * std::polar(1.0, 2.0 * kPi * high * i / rate.hostRate));
+            residual += (output[i] - expected) * (output[i] - expected);
+            total += (double)output[i] * output[i];
+        }
+        Expect(10.0 * std::log10(residual / total) < -40.0, what + ": more than -40 dB of aliasing");
+    }
+}
+
+NAM_TEST(PartitionedConvolverMatchesDirect)
+{
+    const double sampleRate = 48000.0;
+    const std::vector<float> input = MakeInput(1.0);
+    for (const int partitionSize : {64, 256})
+    {
+        for (const size_t length : {(size_t)1, (size_t)100, (size_t)4000})
+        {
+            const std::vector<float> ir = MakeIR(length, 1);
+            auto spectra = MakeIRSpectra(ir.data(), ir.size(), sampleRate, sampleRate, partitionSize);
+            PartitionedConvolver convolver(spectra);
+            convolver.Reset();
+
+            // Blocks both shorter and longer than a partition
+            const std::string what = "Partitions of " + std::to_string(partitionSize) + ", IR of " + std::to_string(length);
+            ExpectMatch(RunConvolver(convolver, input, 3, 3 * partitionSize), Convolve(input, NormaliseIR(ir)), 1e-5, what);
+        }
+    }
+}
+
+NAM_TEST(PartitionedConvolverBlend)
+{
+    // Two IRs of different lengths, blended: the convolution with the blend of the two. When the blend moves, the
+    // output crossfades from the old blend's convolution to the new one's over kBlendRampSeconds.
+    const double sampleRate = 48000.0;
+    const int partitionSize = 128;
+    const std::vector<float> first = MakeIR(3000, 1), second = MakeIR(700, 2);
+    const std::vector<double> firstNormalised = NormaliseIR(first), secondNormalised = NormaliseIR(second);
+    const auto blendOf = [&](const double blend)
+    {
+        std::vector<double> h(std::max(first.size(), second.size()), 0.0);
+        for (size_t i = 0; i < h.size(); i++)
+            h[i] = (1.0 - blend) * (i < first.size() ? firstNormalised[i] : 0.0) + blend * (i < second.size() ? secondNormalised[i] : 0.0);
+        return h;
+    };
+
+    PartitionedConvolver convolver(MakeIRSpectra(first.data(), first.size(), sampleRate, sampleRate, partitionSize),
+                                   MakeIRSpectra(second.data(), second.size(), sampleRate, sampleRate, partitionSize));
+    convolver.SetBlend(0.3f);
+    convolver.Reset();
+
+    const std::vector<float> input = MakeInput(1.0);
+    const size_t changeAt = 20000;
+    std::vector<float> output = input;
+    const int blockSize = 100;
+    for (size_t offset = 0; offset < output.size(); offset += blockSize)
+    {
+        if (offset == changeAt)
+            convolver.SetBlend(0.8f);
+        convolver.Process(output.data() + offset, (int)std::min<size_t>(blockSize, output.size() - offset));
+    }
+
+    const std::vector<float> before = Convolve(input, blendOf(0.3)), after = Convolve(input, blendOf(0.8));
+    std::vector<float> expected(input.size());
+    const int fadeLength = (int)(PartitionedConvolver::kBlendRampSeconds * sampleRate);
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        const float g = i < changeAt ? 0.0f : std::min(1.0f, static_cast<float>(i - changeAt) / fadeLength);
+        expected[i] = before[i] + g * (after[i] - before[i]);
+    }
+    ExpectMatch(output, expected, 1e-5, "Blend of two IRs, through a change of blend");
+}
@@ -0,0 +1,94 @@
+#include "TestSupport.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace
+{
+const double kPi = 3.14159265358979323846;
+}; // namespace
+
+std::vector<float> MakeTone(const double frequency, const double amplitude, const size_t numSamples, const double sampleRate)
+{
+    std::vector<float> tone(numSamples);
+    for (size_t i = 0; i < numSamples; i++)
+        tone[i] = (float)(amplitude * std::sin(2.0 * kPi * frequency * i / sampleRate));
+    return tone;
+}
+
+std::complex<double> MeasureComponent(const std::vector<float>& signal, const size_t start, const size_t length, const double frequency,
+                                      const double sampleRate)
+{
+    std::complex<double> sum = 0.0;
+    for (size_t i = start; i < start + length; i++)
+        sum += (double)signal[i] * std::polar(1.0, -2.0 * kPi * frequency * i / sampleRate);
+    return 2.0 * sum / (double)length;
+}
+
+double ToDB(const double gain)
+{
+    return 20.0 * std::log10(gain);
+}
+
+std::vector<float> MakeIR(const size_t length, const unsigned int seed)
+{
+    std::mt19937 generator(seed);
+    std::normal_distribution<float> noise(0.0f, 1.0f);
+    std::vector<float> ir(length);
+    for (size_t i = 0; i < length; i++)
+        ir[i] = noise(generator) * std::exp(-6.0f * i / length);
+    ir[0] += 2.0f;
+    return ir;
+}
+
+std::vector<double> NormaliseIR(const std::vector<float>& ir)
+{
+    double energy = 0.0;
+    for (const float sample : ir)
+        energy += (double)sample * sample;
+    const float gain = static_cast<float>(0.125 / std::sqrt(energy));
+    std::vector<double> normalised(ir.size());
+    for (size_t i = 0; i < ir.size(); i++)
+        normalised[i] = ir[i] * gain;
+    return normalised;
+}
+
+std::vector<float> Convolve(const std::vector<float>& x, const std::vector<double>& h)
+{
+    std::vector<float> y(x.size());
+    for (size_t n = 0; n < x.size(); n++)
+    {
+        double sum = 0.0;
+        for (size_t k = 0; k < h.size() && k <= n; k++)
+            sum += h[k] * x[n - k];
+        y[n] = (float)sum;
+    }
+    return y;
+}
+
+std::vector<float> RunToneStack(dsp::tone_stack::AbstractToneStack& toneStack, const double knobs[3], const std::vector<float>& input,
+                                const int blockSize, const double sampleRate, const size_t changeAt, const double* newKnobs)
+{
+    toneStack.SetParam("bass", knobs[0]);
+    toneStack.SetParam("middle", knobs[1]);
+    toneStack.SetParam("treble", knobs[2]);
+    toneStack.Reset(sampleRate, blockSize);
+
+    std::vector<float> output(input.size());
+    for (size_t offset = 0; offset < input.size(); offset += blockSize)
+    {
+        if (newKnobs != nullptr && offset == changeAt)
+        {
+            toneStack.SetParam("bass", newKnobs[0]);
+            toneStack.SetParam("middle", newKnobs[1]);
+            toneStack.SetParam("treble", newKnobs[2]);
+        }
+        const int numFrames = (int)std::min<size_t>(blockSize, input.size() - offset);
+        std::copy_n(input.data() + offset, numFrames, output.data() + offset);
+        DSP_SAMPLE* block = output.data() + offset;
+        DSP_SAMPLE** processed = toneStack.Process(&block, 1, numFrames);
+        std::copy_n(processed[0], numFrames, output.data() + offset);
+    }
+    return output;
+}
@@ -0,0 +1,33 @@
+#ifndef __TEST_SUPPORT_H__
+#define __TEST_SUPPORT_H__
+
+#include "ToneStack.h"
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+// Signals, and the references they're checked against, shared by the tests
+
+std::vector<float> MakeTone (const double frequency, const double amplitude, const size_t numSamples, const double sampleRate);
+
+// Amplitude and phase of the component of signal[start, start + length) at frequency, which must go into length a
+// whole number of times
+std::complex<double> MeasureComponent (const std::vector<float>& signal, const size_t start, const size_t length, const double frequency,
+                                       const double sampleRate);
+
+double ToDB (const double gain);
+
+// A cab-like IR: a strong first tap and a decaying noise tail
+std::vector<float> MakeIR (const size_t length, const unsigned int seed);
+// What MakeIRSpectra() convolves with: the IR normalised the way JUCE's convolution does
+std::vector<double> NormaliseIR (const std::vector<float>& ir);
+// y = x * h, directly, in double
+std::vector<float> Convolve (const std::vector<float>& x, const std::vector<double>& h);
+
+// Output of a tone stack on the input, in blocks of blockSize, with the knobs (bass, middle, treble) set before
+// the reset so that nothing ramps. If newKnobs is given, they're set before the block at changeAt.
+std::vector<float> RunToneStack (dsp::tone_stack::AbstractToneStack& toneStack, const double knobs[3], const std::vector<float>& input,
+                                 const int blockSize, const double sampleRate, const size_t changeAt = 0, const double* newKnobs = nullptr);
+
+#endif
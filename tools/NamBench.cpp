@@ -0,0 +1,318 @@
+// nam-bench: compares our own execution paths against the core's, for speed and for output.
+//
+//   nam-bench --lstm [--model MODEL.nam | --layers N --hidden N] [--seconds S]
+//   nam-bench --wavenet [--model MODEL.nam] [--prune THRESHOLD] [--seconds S]
+//   nam-bench --tonestack [--seconds S]
+//   nam-bench --parse --model MODEL.nam [--seconds S]
+//
+// For block sizes from 16 to 1024 it prints the time per sample of the core and of our path, the speedup, and
+// the largest difference between their outputs. --prune takes dead channels out of our WaveNet first (see
+// NamBuildOptions::pruneThreshold) and prints what that saved. --tonestack does the same for FusedToneStack against
+// BasicNamToneStack (the three-filter cascade), at a few knob settings. --parse times ReadNamModel() against
+// parsing the whole file with nlohmann, checks that they read the same fields and bit-identical weights, and that
+// nam::get_dsp() builds models from them that give the same output.
+
+#include "ModelFactory.h"
+#include "NamModelFile.h"
+#include "RingWaveNet.h"
+#include "SyntheticModels.h"
+#include "ToneStack.h"
+#include "VectorActivations.h"
+
+#include <activations.h>
+#include <get_dsp.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+const double kSampleRate = kSyntheticSampleRate;
+
+// Best of a few runs, in nanoseconds per sample
+double TimeModel(nam::DSP& model, const std::vector<NAM_SAMPLE>& input, std::vector<NAM_SAMPLE>& output, const int blockSize)
+{
+    const int numRuns = 3;
+    double best = 1e300;
+    output.resize(input.size());
+    for (int run = 0; run < numRuns; run++)
+    {
+        // Both models settle on the same silence before every run
+        model.Reset(kSampleRate, blockSize);
+
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t offset = 0; offset < input.size(); offset += blockSize)
+        {
+            const int numFrames = (int)std::min<size_t>(blockSize, input.size() - offset);
+            model.process(const_cast<NAM_SAMPLE*>(input.data()) + offset, output.data() + offset, numFrames);
+        }
+        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count() / input.size());
+    }
+    return best;
+}
+
+std::string Describe(const nam::dspData& data)
+{
+    const nlohmann::json& config = data.config;
+    if (data.architecture == "LSTM")
+        return "LSTM: " + std::to_string(config["num_layers"].get<int>()) + " layer(s), hidden size "
+               + std::to_string(config["hidden_size"].get<int>());
+    std::string description = data.architecture + ":";
+    for (const auto& layerConfig : config["layers"])
+        description += " [" + std::to_string(layerConfig["channels"].get<int>()) + " channels, "
+                       + std::to_string(layerConfig["dilations"].size()) + " layers]";
+    return description;
+}
+
+int RunComparison(const nam::dspData& data, const double seconds, const float pruneThreshold)
+{
+    std::cout << Describe(data) << ", " << seconds << " s of audio" << std::endl;
+
+    nam::dspData coreData = data;
+    std::unique_ptr<nam::DSP> core = nam::get_dsp(coreData);
+    nam::dspData oursData = data;
+    NamBuildOptions options;
+    options.pruneThreshold = pruneThreshold;
+    NamPruneReport pruneReport;
+    std::unique_ptr<nam::DSP> ours = BuildNamDSP(oursData, options, &pruneReport);
+    if (pruneReport.pruned)
+        std::cout << pruneReport.ToString() << std::endl;
+
+    if (const RingWaveNet* ring = dynamic_cast<const RingWaveNet*>(ours.get()))
+        std::cout << "State: " << ring->GetStateBytes() / 1024 << " KiB, packed weights: " << ring->GetWeightBytes() / 1024 << " KiB"
+                  << std::endl;
+
+    const std::vector<NAM_SAMPLE> input = MakeInput(seconds);
+    std::vector<NAM_SAMPLE> coreOutput, oursOutput;
+
+    std::printf("%8s %14s %14s %9s %12s\n", "block", "core ns/smp", "ours ns/smp", "speedup", "max |diff|");
+    for (int blockSize = 16; blockSize <= 1024; blockSize *= 2)
+    {
+        const double coreTime = TimeModel(*core, input, coreOutput, blockSize);
+        const double oursTime = TimeModel(*ours, input, oursOutput, blockSize);
+
+        double maxDifference = 0.0;
+        for (size_t i = 0; i < input.size(); i++)
+            maxDifference = std::max(maxDifference, (double)std::fabs(coreOutput[i] - oursOutput[i]));
+
+        std::printf("%8d %14.1f %14.1f %8.2fx %12.2e\n", blockSize, coreTime, oursTime, coreTime / oursTime, maxDifference);
+    }
+    return 0;
+}
+
+// Best of a few runs, in nanoseconds per sample
+double TimeToneStack(dsp::tone_stack::AbstractToneStack& toneStack, const double knobs[3], const std::vector<NAM_SAMPLE>& input,
+                     std::vector<NAM_SAMPLE>& output, const int blockSize)
+{
+    const int numRuns = 3;
+    double best = 1e300;
+    output.resize(input.size());
+    for (int run = 0; run < numRuns; run++)
+    {
+        // Knobs set before the reset, so that nothing is ramping
+        toneStack.SetParam("bass", knobs[0]);
+        toneStack.SetParam("middle", knobs[1]);
+        toneStack.SetParam("treble", knobs[2]);
+        toneStack.Reset(kSampleRate, blockSize);
+
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t offset = 0; offset < input.size(); offset += blockSize)
+        {
+            const int numFrames = (int)std::min<size_t>(blockSize, input.size() - offset);
+            DSP_SAMPLE* blockInput = const_cast<NAM_SAMPLE*>(input.data()) + offset;
+            DSP_SAMPLE** blockOutput = toneStack.Process(&blockInput, 1, numFrames);
+            std::copy(blockOutput[0], blockOutput[0] + numFrames, output.data() + offset);
+        }
+        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count() / input.size());
+    }
+    return best;
+}
+
+int RunToneStackComparison(const double seconds)
+{
+    std::cout << "Tone stack, " << seconds << " s of audio" << std::endl;
+
+    const std::vector<NAM_SAMPLE> input = MakeInput(seconds);
+    std::vector<NAM_SAMPLE> cascadeOutput, fusedOutput;
+
+    // Noon (all flat), one band moved, and all three moved
+    const double settings[][3] = {{5.0, 5.0, 5.0}, {5.0, 7.0, 5.0}, {7.0, 3.5, 6.0}};
+    for (const auto& knobs : settings)
+    {
+        std::printf("bass %.1f, middle %.1f, treble %.1f\n", knobs[0], knobs[1], knobs[2]);
+        std::printf("%8s %14s %14s %9s %12s\n", "block", "cascade ns/smp", "fused ns/smp", "speedup", "max |diff|");
+        for (int blockSize = 16; blockSize <= 1024; blockSize *= 2)
+        {
+            dsp::tone_stack::BasicNamToneStack cascade;
+            dsp::tone_stack::FusedToneStack fused;
+            const double cascadeTime = TimeToneStack(cascade, knobs, input, cascadeOutput, blockSize);
+            const double fusedTime = TimeToneStack(fused, knobs, input, fusedOutput, blockSize);
+
+            double maxDifference = 0.0;
+            for (size_t i = 0; i < input.size(); i++)
+                maxDifference = std::max(maxDifference, (double)std::fabs(cascadeOutput[i] - fusedOutput[i]));
+
+            std::printf("%8d %14.1f %14.1f %8.2fx %12.2e\n", blockSize, cascadeTime, fusedTime, cascadeTime / fusedTime, maxDifference);
+        }
+    }
+    return 0;
+}
+// How .nam files were read before ReadNamModel() streamed them: the whole file through nlohmann's DOM
+nam::dspData ReadNamModelDOM(const std::string& modelPath)
+{
+    std::ifstream file(std::filesystem::u8path(modelPath), std::ios::binary);
+    if (!file.is_open())
+        throw std::runtime_error("Couldn't open " + modelPath);
+    const std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    const nlohmann::json j = nlohmann::json::parse(contents);
+
+    nam::dspData modelData;
+    modelData.version = j["version"].get<std::string>();
+    modelData.architecture = j["architecture"].get<std::string>();
+    modelData.config = j["config"];
+    modelData.metadata = j.find("metadata") != j.end() ? j["metadata"] : nlohmann::json();
+    modelData.weights = j["weights"].get<std::vector<float>>();
+    modelData.expected_sample_rate = j.find("sample_rate") != j.end() ? j["sample_rate"].get<double>() : -1.0;
+    return modelData;
+}
+
+int RunParseComparison(const std::string& modelPath, const double seconds)
+{
+    const auto timeRead = [&modelPath](nam::dspData (*read)(const std::string&), nam::dspData& data)
+    {
+        const int numRuns = 3;
+        double best = 1e300;
+        for (int run = 0; run < numRuns; run++)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            data = read(modelPath);
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::min(best, elapsed.count());
+        }
+        return best;
+    };
+
+    nam::dspData streamed, dom;
+    const double streamedTime = timeRead([](const std::string& path) { return ReadNamModel(std::filesystem::u8path(path)); }, streamed);
+    const double domTime = timeRead(ReadNamModelDOM, dom);
+
+    std::cout << dom.architecture << ", " << dom.weights.size() << " weights (" << dom.weights.size() * sizeof(float) / 1024 << " KiB)"
+              << std::endl;
+    std::printf("%10s %14s\n", "", "ms to read");
+    std::printf("%10s %14.1f\n", "nlohmann", domTime);
+    std::printf("%10s %14.1f %8.2fx\n", "streamed", streamedTime, domTime / streamedTime);
+
+    bool same = streamed.version == dom.version && streamed.architecture == dom.architecture && streamed.config == dom.config
+                && streamed.metadata == dom.metadata && streamed.expected_sample_rate == dom.expected_sample_rate
+                && streamed.weights.size() == dom.weights.size();
+    size_t numDifferent = 0;
+    if (same)
+        for (size_t i = 0; i < dom.weights.size(); i++)
+            numDifferent += std::memcmp(&streamed.weights[i], &dom.weights[i], sizeof(float)) != 0;
+    std::cout << "Fields: " << (same ? "same" : "DIFFERENT") << ", weights that differ: " << numDifferent << std::endl;
+
+    // Built the way the core builds them, to show that nothing about the model changes
+    std::unique_ptr<nam::DSP> fromStreamed = nam::get_dsp(streamed);
+    std::unique_ptr<nam::DSP> fromDom = nam::get_dsp(dom);
+    const std::vector<NAM_SAMPLE> input = MakeInput(seconds);
+    std::vector<NAM_SAMPLE> streamedOutput, domOutput;
+    TimeModel(*fromStreamed, input, streamedOutput, 512);
+    TimeModel(*fromDom, input, domOutput, 512);
+
+    double maxDifference = 0.0;
+    for (size_t i = 0; i < input.size(); i++)
+        maxDifference = std::max(maxDifference, (double)std::fabs(streamedOutput[i] - domOutput[i]));
+    std::printf("get_dsp() output, max |diff|: %.2e\n", maxDifference);
+
+    return same && numDifferent == 0 && maxDifference == 0.0 ? 0 : 1;
+}
+}; // namespace
+
+int main(int argc, char* argv[])
+{
+    std::string mode, modelPath;
+    int numLayers = 1, hiddenSize = 16;
+    double seconds = 10.0;
+    float pruneThreshold = -1.0f;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--lstm")
+            mode = "lstm";
+        else if (arg == "--wavenet")
+            mode = "wavenet";
+        else if (arg == "--tonestack")
+            mode = "tonestack";
+        else if (arg == "--parse")
+            mode = "parse";
+        else if (arg == "--model" && hasValue)
+            modelPath = argv[++i];
+        else if (arg == "--layers" && hasValue)
+            numLayers = std::stoi(argv[++i]);
+        else if (arg == "--hidden" && hasValue)
+            hiddenSize = std::stoi(argv[++i]);
+        else if (arg == "--seconds" && hasValue)
+            seconds = std::stod(argv[++i]);
+        else if (arg == "--prune" && hasValue)
+            pruneThreshold = std::stof(argv[++i]);
+        else
+        {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    // Same activations as the plugin
+    VectorActivations::Install();
+    nam::activations::Activation::enable_fast_tanh();
+    std::cout << "Activation kernels: " << GetActivationKernels().isa << std::endl;
+
+    try
+    {
+        if (mode == "lstm" || mode == "wavenet")
+        {
+            nam::dspData data;
+            if (!modelPath.empty())
+                data = ReadNamModel(std::filesystem::u8path(modelPath));
+            else
+                data = mode == "lstm" ? MakeLSTMData(numLayers, hiddenSize) : MakeWaveNetData();
+
+            const std::string expected = mode == "lstm" ? "LSTM" : "WaveNet";
+            if (data.architecture != expected)
+            {
+                std::cerr << modelPath << " isn't a " << expected << std::endl;
+                return 1;
+            }
+            return RunComparison(data, seconds, pruneThreshold);
+        }
+        if (mode == "tonestack")
+            return RunToneStackComparison(seconds);
+        if (mode == "parse" && !modelPath.empty())
+            return RunParseComparison(modelPath, seconds);
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    std::cerr << "Usage: nam-bench --lstm [--model MODEL.nam | --layers N --hidden N] [--seconds S]" << std::endl;
+    std::cerr << "       nam-bench --wavenet [--model MODEL.nam] [--prune THRESHOLD] [--seconds S]" << std::endl;
+    std::cerr << "       nam-bench --tonestack [--seconds S]" << std::endl;
+    std::cerr << "       nam-bench --parse --model MODEL.nam [--seconds S]" << std::endl;
+    return 1;
+}
@@ -0,0 +1,506 @@
+// nam-stress: runs a whole plugin instance the way a busy session would, and reports how long its worst blocks
+// took and what was going on around them. Average CPU doesn't matter on stage; the worst block does.
+//
+//   nam-stress [--model MODEL.nam ...] [--ir IR.wav ...] [--seconds S] [--events-per-second N] [--seed N]
+//              [--outliers N] [--flat-out] [--prepare-on-audio-thread]
+//
+// The audio thread processes blocks of random sizes, up to the prepared maximum, and automates every parameter
+// on every block (the switches only flip now and then). Meanwhile the main thread stands in for the message
+// thread: it runs the message loop, so the hibernation timer fires, and at random times it loads and clears
+// models and IRs (picked from the ones given) in random slots, or changes the sample rate and maximum block size
+// through prepareToPlay(). The shared loader's threads parse the files in the background. Hosts differ on where
+// prepareToPlay() runs; --prepare-on-audio-thread does it between blocks on the audio thread, as JUCE's own
+// AudioProcessorPlayer does, instead of on the message thread under the callback lock.
+//
+// The audio thread keeps to real time unless --flat-out. A block's time runs from when the audio thread asks for
+// the callback lock, as a host does, to when processBlock() returns, so stalls from suspendProcessing() count.
+// At the end it prints a histogram of block times, percentiles, overruns (blocks that took longer than the audio
+// they hold), and the worst blocks, each with what the audio thread saw change just before it and the events the
+// message thread fired since the block before.
+//
+// Configure with -DNAM_TSAN=ON to build it with ThreadSanitizer.
+
+#include "PluginProcessor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+const double kSampleRates[] = {44100.0, 48000.0, 88200.0, 96000.0};
+const int kMaxBlockSizes[] = {32, 64, 128, 256, 512, 1024, 2048};
+constexpr int kLargestBlock = 2048;
+
+// Automated on every block
+const char* const kContinuousParameters[] = {"INPUT_ID", "GATE_ID",   "BASS_ID", "MIDDLE_ID",
+                                             "TREBLE_ID", "OUTPUT_ID", "BLEND_ID", "CAB_BLEND_ID"};
+// Flipped now and then, as a user would
+const char* const kSwitchParameters[] = {"TONE_STACK_ON_ID", "NORMALIZE_ID", "CAB_ON_ID", "SLEEP_ON_ID"};
+constexpr double kSwitchProbability = 0.002;
+
+// What the audio thread saw change right before a block
+enum BlockFlags : uint32_t
+{
+    kPrepared = 1 << 0,
+    kSwitchFlipped = 1 << 1,
+    kModel0Changed = 1 << 2,
+    kModel1Changed = 1 << 3,
+    kIrChanged = 1 << 4,
+};
+
+const char* const kFlagNames[] = {"first block after prepareToPlay()", "a switch flipped", "model slot 0 came or went",
+                                  "model slot 1 came or went", "the cab came or went"};
+
+double Micros(const Clock::duration duration)
+{
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+// Block times, 8 bins to the octave from 1 us up
+class LatencyHistogram
+{
+public:
+    static constexpr int kBinsPerOctave = 8;
+    static constexpr int kNumBins = 24 * kBinsPerOctave;
+
+    void Add(const double micros)
+    {
+        const int bin = micros <= 1.0 ? 0 : std::min(kNumBins - 1, static_cast<int>(std::log2(micros) * kBinsPerOctave));
+        mCounts[bin]++;
+        mTotal++;
+    }
+
+    int64_t GetTotal() const { return mTotal; };
+
+    // Upper edge of the bin that the fraction p of blocks falls within
+    double Percentile(const double p) const
+    {
+        int64_t cumulative = 0;
+        for (int bin = 0; bin < kNumBins; bin++)
+        {
+            cumulative += mCounts[bin];
+            if (cumulative >= p * mTotal)
+                return BinEdge(bin + 1);
+        }
+        return BinEdge(kNumBins);
+    }
+
+    void Print() const
+    {
+        const int64_t largest = *std::max_element(mCounts, mCounts + kNumBins);
+        int64_t cumulative = 0;
+        for (int bin = 0; bin < kNumBins; bin++)
+        {
+            if (mCounts[bin] == 0)
+                continue;
+            cumulative += mCounts[bin];
+            std::printf("  %9.1f - %9.1f us %10lld %8.4f%%  %s\n", BinEdge(bin), BinEdge(bin + 1), (long long)mCounts[bin],
+                        100.0 * cumulative / mTotal, std::string(1 + 49 * mCounts[bin] / largest, '#').c_str());
+        }
+    }
+
+private:
+    static double BinEdge(const int bin) { return bin == 0 ? 0.0 : std::exp2(static_cast<double>(bin) / kBinsPerOctave); };
+
+    int64_t mCounts[kNumBins] = {};
+    int64_t mTotal = 0;
+};
+
+struct BlockRecord
+{
+    int64_t index = 0;
+    int numFrames = 0;
+    double sampleRate = 0.0;
+    Clock::time_point previousStart;
+    Clock::time_point start;
+    // When the callback lock was got, and when processBlock() returned
+    Clock::time_point locked;
+    Clock::time_point end;
+    uint32_t flags = 0;
+    int switchFlipped = -1;
+
+    double GetMicros() const { return Micros(this->end - this->start); };
+};
+
+struct Event
+{
+    Clock::time_point time;
+    std::string what;
+};
+
+struct Options
+{
+    std::vector<juce::File> models;
+    std::vector<juce::File> irs;
+    double seconds = 60.0;
+    double eventsPerSecond = 20.0;
+    unsigned seed = 1;
+    int numOutliers = 20;
+    bool flatOut = false;
+    bool prepareOnAudioThread = false;
+};
+
+class StressRun
+{
+public:
+    explicit StressRun(const Options& options)
+        : mOptions(options), mRng(options.seed)
+    {
+        mOutliers.reserve(options.numOutliers);
+    }
+
+    void Run()
+    {
+        this->Prepare(48000.0, 512);
+        mStart = Clock::now();
+        std::thread audioThread([this] { this->AudioLoop(); });
+
+        const Clock::time_point end = mStart + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(mOptions.seconds));
+        std::exponential_distribution<double> interval(mOptions.eventsPerSecond);
+        Clock::time_point nextEvent = mStart;
+        while (Clock::now() < end)
+        {
+            nextEvent += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(interval(mRng)));
+            const Clock::time_point until = std::min(nextEvent, end);
+            const int millis = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(until - Clock::now()).count());
+            juce::MessageManager::getInstance()->runDispatchLoopUntil(std::max(1, millis));
+            if (Clock::now() < end)
+                this->FireEvent();
+        }
+
+        mStopping = true;
+        audioThread.join();
+    }
+
+    void PrintReport() const
+    {
+        const double elapsed = std::chrono::duration<double>(mEnd - mStart).count();
+        std::printf("%lld blocks, %.1f s of audio in %.1f s; %d event(s) from the message thread\n", (long long)mHistogram.GetTotal(),
+                    mAudioSeconds, elapsed, (int)mEvents.size());
+        std::printf("Block times: p50 %.1f us, p99 %.1f us, p99.9 %.1f us (bin upper edges); max %.1f us\n", mHistogram.Percentile(0.5),
+                    mHistogram.Percentile(0.99), mHistogram.Percentile(0.999), mWorstMicros);
+        std::printf("Overruns (slower than real time): %lld; worst load %.1f%% of a block's duration\n\n", (long long)mOverruns,
+                    100.0 * mWorstLoad);
+        mHistogram.Print();
+
+        std::vector<BlockRecord> outliers = mOutliers;
+        std::sort(outliers.begin(), outliers.end(), [](const BlockRecord& a, const BlockRecord& b) { return a.GetMicros() > b.GetMicros(); });
+        std::printf("\nWorst %d block(s):\n", (int)outliers.size());
+        for (const BlockRecord& record : outliers)
+        {
+            const double budget = 1e6 * record.numFrames / record.sampleRate;
+            std::printf("  block %lld at %.3f s: %.1f us (%.1f us waiting for the callback lock), %d frames at %.0f Hz, %.0f%% of its duration\n",
+                        (long long)record.index, std::chrono::duration<double>(record.start - mStart).count(), record.GetMicros(),
+                        Micros(record.locked - record.start), record.numFrames, record.sampleRate, 100.0 * record.GetMicros() / budget);
+
+            bool attributed = false;
+            for (size_t bit = 0; bit < std::size(kFlagNames); bit++)
+            {
+                if ((record.flags & (1u << bit)) == 0)
+                    continue;
+                std::printf("    - %s", kFlagNames[bit]);
+                if ((1u << bit) == kSwitchFlipped)
+                    std::printf(" (%s)", kSwitchParameters[record.switchFlipped]);
+                std::printf("\n");
+                attributed = true;
+            }
+            for (const Event& event : mEvents)
+            {
+                if (event.time < record.previousStart || event.time > record.end)
+                    continue;
+                std::printf("    - %.1f us before it ended: %s\n", Micros(record.end - event.time), event.what.c_str());
+                attributed = true;
+            }
+            if (!attributed)
+                std::printf("    - nothing the harness did (the model itself, or the OS)\n");
+        }
+    }
+
+private:
+    // Under the callback lock, so that the audio thread is between blocks
+    void Prepare(const double sampleRate, const int maxBlock)
+    {
+        mProcessor.setRateAndBufferSizeDetails(sampleRate, maxBlock);
+        mProcessor.prepareToPlay(sampleRate, maxBlock);
+        mSampleRate = sampleRate;
+        mMaxBlock = maxBlock;
+        mJustPrepared = true;
+    }
+
+    template <typename T>
+    const T& Pick(const std::vector<T>& items)
+    {
+        return items[std::uniform_int_distribution<size_t>(0, items.size() - 1)(mRng)];
+    }
+
+    void FireEvent()
+    {
+        const int slot = std::uniform_int_distribution<int>(0, 1)(mRng);
+        const double choice = std::uniform_real_distribution<double>(0.0, 1.0)(mRng);
+        std::string what;
+        if (choice < 0.3 && !mOptions.models.empty())
+        {
+            const juce::File& file = Pick(mOptions.models);
+            what = "load model " + file.getFileName().toStdString() + " into slot " + std::to_string(slot);
+            this->Log(what);
+            mProcessor.loadNamModel(file, {}, slot);
+        }
+        else if (choice < 0.45 && !mOptions.models.empty())
+        {
+            this->Log("clear model slot " + std::to_string(slot));
+            mProcessor.clearNAM(slot);
+        }
+        else if (choice < 0.7 && !mOptions.irs.empty())
+        {
+            const juce::File& file = Pick(mOptions.irs);
+            this->Log("load IR " + file.getFileName().toStdString() + " into slot " + std::to_string(slot));
+            mProcessor.loadImpulseResponse(file, {}, slot);
+        }
+        else if (choice < 0.85 && !mOptions.irs.empty())
+        {
+            this->Log("clear IR slot " + std::to_string(slot));
+            mProcessor.clearIR(slot);
+        }
+        else if (choice >= 0.85)
+        {
+            const double sampleRate = kSampleRates[std::uniform_int_distribution<size_t>(0, std::size(kSampleRates) - 1)(mRng)];
+            const int maxBlock = kMaxBlockSizes[std::uniform_int_distribution<size_t>(0, std::size(kMaxBlockSizes) - 1)(mRng)];
+            const std::string spec = std::to_string((int)sampleRate) + " Hz, blocks up to " + std::to_string(maxBlock);
+            if (mOptions.prepareOnAudioThread)
+            {
+                this->Log("ask the audio thread to prepare at " + spec);
+                mPendingSampleRate = sampleRate;
+                mPendingMaxBlock = maxBlock;
+            }
+            else
+            {
+                this->Log("prepare at " + spec);
+                const juce::ScopedLock lock(mProcessor.getCallbackLock());
+                this->Prepare(sampleRate, maxBlock);
+            }
+        }
+    }
+
+    void Log(const std::string& what) { mEvents.push_back({Clock::now(), what}); };
+
+    void AudioLoop()
+    {
+        juce::AudioBuffer<float> buffer(2, kLargestBlock);
+        juce::MidiBuffer midi;
+        std::mt19937 rng(mOptions.seed + 1);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::normal_distribution<float> noise(0.0f, 0.1f);
+
+        std::vector<juce::AudioProcessorParameter*> continuous, switches;
+        for (const char* id : kContinuousParameters)
+            continuous.push_back(mProcessor.apvts.getParameter(id));
+        for (const char* id : kSwitchParameters)
+            switches.push_back(mProcessor.apvts.getParameter(id));
+
+        // Notes with silence between them, so that the gate and sleep mode get a workout too
+        std::vector<float> input(kLargestBlock);
+        double phase = 0.0, frequency = 110.0;
+        int64_t samplesLeftInNote = 0;
+        bool silent = false;
+
+        bool modelLoaded[2] = {false, false};
+        bool irLoaded = false;
+        Clock::time_point previousStart = Clock::now();
+        Clock::time_point deadline = previousStart;
+        int64_t index = 0;
+
+        while (!mStopping)
+        {
+            BlockRecord record;
+            record.index = index++;
+            record.previousStart = previousStart;
+
+            if (const int pendingMaxBlock = mPendingMaxBlock.exchange(0); pendingMaxBlock > 0)
+            {
+                const juce::ScopedLock lock(mProcessor.getCallbackLock());
+                this->Prepare(mPendingSampleRate, pendingMaxBlock);
+            }
+
+            for (juce::AudioProcessorParameter* parameter : continuous)
+                parameter->setValue(unit(rng));
+            if (unit(rng) < kSwitchProbability * std::size(kSwitchParameters))
+            {
+                record.switchFlipped = std::uniform_int_distribution<int>(0, (int)switches.size() - 1)(rng);
+                juce::AudioProcessorParameter* parameter = switches[record.switchFlipped];
+                parameter->setValue(parameter->getValue() < 0.5f ? 1.0f : 0.0f);
+                record.flags |= kSwitchFlipped;
+            }
+
+            for (int slot = 0; slot < 2; slot++)
+            {
+                const bool loaded = mProcessor.getNamModelStatus(slot);
+                if (loaded != modelLoaded[slot])
+                    record.flags |= slot == 0 ? kModel0Changed : kModel1Changed;
+                modelLoaded[slot] = loaded;
+            }
+            if (mProcessor.getIrStatus() != irLoaded)
+                record.flags |= kIrChanged;
+            irLoaded = mProcessor.getIrStatus();
+
+            record.start = Clock::now();
+            {
+                const juce::ScopedLock lock(mProcessor.getCallbackLock());
+                record.locked = Clock::now();
+                record.sampleRate = mSampleRate;
+                const int maxBlock = mMaxBlock;
+                record.numFrames = unit(rng) < 0.5f ? maxBlock : std::uniform_int_distribution<int>(1, maxBlock)(rng);
+                if (mJustPrepared)
+                    record.flags |= kPrepared;
+                mJustPrepared = false;
+
+                for (int i = 0; i < record.numFrames; i++)
+                {
+                    if (samplesLeftInNote-- <= 0)
+                    {
+                        silent = !silent;
+                        samplesLeftInNote = static_cast<int64_t>(record.sampleRate * (silent ? 0.2 + unit(rng) : 0.5 + 2.0 * unit(rng)));
+                        frequency = 82.4 * std::exp2(std::floor(unit(rng) * 36.0f) / 12.0);
+                    }
+                    phase += frequency / record.sampleRate;
+                    input[i] = silent ? 0.0f : 0.5f * std::sin(6.283185307179586 * phase) + noise(rng);
+                }
+
+                juce::AudioBuffer<float> block(buffer.getArrayOfWritePointers(), 2, record.numFrames);
+                block.copyFrom(0, 0, input.data(), record.numFrames);
+                block.clear(1, 0, record.numFrames);
+                if (mProcessor.isSuspended())
+                    block.clear();
+                else
+                    mProcessor.processBlock(block, midi);
+            }
+            record.end = Clock::now();
+            previousStart = record.start;
+
+            this->Record(record);
+
+            // Flat out, the callback lock would hardly ever be free for the message thread
+            if (mOptions.flatOut)
+                std::this_thread::yield();
+            else
+            {
+                deadline += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(record.numFrames / record.sampleRate));
+                // Fell too far behind (a debugger, a sanitizer): start again from now rather than catching up
+                if (Clock::now() - deadline > std::chrono::seconds(1))
+                    deadline = Clock::now();
+                std::this_thread::sleep_until(deadline);
+            }
+        }
+        mEnd = Clock::now();
+    }
+
+    // On the audio thread; nothing here allocates (the outliers are reserved up front)
+    void Record(const BlockRecord& record)
+    {
+        const double micros = record.GetMicros();
+        const double load = micros / (1e6 * record.numFrames / record.sampleRate);
+        mHistogram.Add(micros);
+        mAudioSeconds += record.numFrames / record.sampleRate;
+        mWorstMicros = std::max(mWorstMicros, micros);
+        mWorstLoad = std::max(mWorstLoad, load);
+        if (load > 1.0)
+            mOverruns++;
+
+        // Shortest on top, to be pushed out next
+        const auto shorter = [](const BlockRecord& a, const BlockRecord& b) { return a.GetMicros() > b.GetMicros(); };
+        if ((int)mOutliers.size() < mOptions.numOutliers)
+        {
+            mOutliers.push_back(record);
+            std::push_heap(mOutliers.begin(), mOutliers.end(), shorter);
+        }
+        else if (!mOutliers.empty() && micros > mOutliers.front().GetMicros())
+        {
+            std::pop_heap(mOutliers.begin(), mOutliers.end(), shorter);
+            mOutliers.back() = record;
+            std::push_heap(mOutliers.begin(), mOutliers.end(), shorter);
+        }
+    }
+
+    const Options mOptions;
+    NAMAudioProcessor mProcessor;
+    std::mt19937 mRng;
+
+    // Set under the callback lock
+    double mSampleRate = 0.0;
+    int mMaxBlock = 0;
+    bool mJustPrepared = false;
+
+    // For --prepare-on-audio-thread
+    std::atomic<double> mPendingSampleRate{0.0};
+    std::atomic<int> mPendingMaxBlock{0};
+
+    std::atomic<bool> mStopping{false};
+    Clock::time_point mStart;
+    Clock::time_point mEnd;
+
+    // The message thread's, read once the audio thread has stopped
+    std::vector<Event> mEvents;
+
+    // The audio thread's, read once it has stopped
+    LatencyHistogram mHistogram;
+    std::vector<BlockRecord> mOutliers;
+    double mAudioSeconds = 0.0;
+    double mWorstMicros = 0.0;
+    double mWorstLoad = 0.0;
+    int64_t mOverruns = 0;
+};
+}; // namespace
+
+int main(int argc, char* argv[])
+{
+    // The processor's timer wants a message manager
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    Options options;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--model" && hasValue)
+            options.models.push_back(juce::File::getCurrentWorkingDirectory().getChildFile(argv[++i]));
+        else if (arg == "--ir" && hasValue)
+            options.irs.push_back(juce::File::getCurrentWorkingDirectory().getChildFile(argv[++i]));
+        else if (arg == "--seconds" && hasValue)
+            options.seconds = std::stod(argv[++i]);
+        else if (arg == "--events-per-second" && hasValue)
+            options.eventsPerSecond = std::stod(argv[++i]);
+        else if (arg == "--seed" && hasValue)
+            options.seed = static_cast<unsigned>(std::stoul(argv[++i]));
+        else if (arg == "--outliers" && hasValue)
+            options.numOutliers = std::max(0, std::stoi(argv[++i]));
+        else if (arg == "--flat-out")
+            options.flatOut = true;
+        else if (arg == "--prepare-on-audio-thread")
+            options.prepareOnAudioThread = true;
+        else
+        {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (options.eventsPerSecond <= 0.0)
+    {
+        std::cerr << "--events-per-second must be more than 0" << std::endl;
+        return 1;
+    }
+
+    auto run = std::make_unique<StressRun>(options);
+    run->Run();
+    run->PrintReport();
+    return 0;
+}
@@ -0,0 +1,154 @@
+// nam-render: renders a file through the NAM chain offline, on all cores (see OfflineRenderer.h).
+//
+//   nam-render --model MODEL.nam [--threads N] [--chunk-seconds S] [--overlap S] [--crossfade S] [--block N]
+//              [--param key=value ...] [--null-test] IN.wav OUT.wav
+//
+// --null-test also does the serial render, and prints how long each took and how far apart they are.
+
+#include "NamModelFile.h"
+#include "OfflineRenderer.h"
+
+#include <chrono>
+#include <iostream>
+#include <juce_audio_formats/juce_audio_formats.h>
+
+namespace
+{
+struct ParameterKey
+{
+    const char* name;
+    NeuralAmpModeler::Parameters parameter;
+};
+
+// Same names as the reamp server's
+const ParameterKey kParameterKeys[] = {
+    {"input", NeuralAmpModeler::kInputLevel}, {"gate", NeuralAmpModeler::kNoiseGateThreshold}, {"bass", NeuralAmpModeler::kToneBass},
+    {"middle", NeuralAmpModeler::kToneMid},   {"treble", NeuralAmpModeler::kToneTreble},       {"output", NeuralAmpModeler::kOutputLevel},
+    {"tone_stack", NeuralAmpModeler::kEQActive}, {"normalize", NeuralAmpModeler::kOutNorm},
+};
+
+bool SetParameter(OfflineRenderer::Options& options, const std::string& keyValue)
+{
+    const auto equals = keyValue.find('=');
+    if (equals == std::string::npos)
+        return false;
+    for (const auto& key : kParameterKeys)
+    {
+        if (keyValue.compare(0, equals, key.name) == 0 && std::string(key.name).size() == equals)
+        {
+            options.parameters[key.parameter] = std::stof(keyValue.substr(equals + 1));
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename Function>
+double TimeSeconds(Function&& function)
+{
+    const auto start = std::chrono::steady_clock::now();
+    function();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+}; // namespace
+
+int main(int argc, char* argv[])
+{
+    OfflineRenderer::Options options;
+    std::string modelPath;
+    bool nullTest = false;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--model" && hasValue)
+            modelPath = argv[++i];
+        else if (arg == "--threads" && hasValue)
+            options.numThreads = std::stoi(argv[++i]);
+        else if (arg == "--chunk-seconds" && hasValue)
+            options.chunkSeconds = std::stod(argv[++i]);
+        else if (arg == "--overlap" && hasValue)
+            options.overlapSeconds = std::stod(argv[++i]);
+        else if (arg == "--crossfade" && hasValue)
+            options.crossfadeSeconds = std::stod(argv[++i]);
+        else if (arg == "--block" && hasValue)
+            options.blockSize = std::stoi(argv[++i]);
+        else if (arg == "--param" && hasValue)
+        {
+            if (!SetParameter(options, argv[++i]))
+            {
+                std::cerr << "Unknown parameter: " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--null-test")
+            nullTest = true;
+        else
+            files.push_back(arg);
+    }
+
+    if (modelPath.empty() || files.size() != 2)
+    {
+        std::cerr << "Usage: nam-render --model MODEL.nam [--threads N] [--chunk-seconds S] [--overlap S] [--crossfade S] [--block N]"
+                  << std::endl
+                  << "                  [--param key=value ...] [--null-test] IN.wav OUT.wav" << std::endl;
+        return 1;
+    }
+
+    const auto cwd = juce::File::getCurrentWorkingDirectory();
+    const juce::File inputFile = cwd.getChildFile(files[0]);
+    const juce::File outputFile = cwd.getChildFile(files[1]);
+
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(inputFile));
+    if (reader == nullptr)
+    {
+        std::cerr << "Couldn't read " << inputFile.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    juce::AudioBuffer<float> audio(1, (int)reader->lengthInSamples);
+    reader->read(&audio, 0, audio.getNumSamples(), 0, true, false);
+    const std::vector<float> input(audio.getReadPointer(0), audio.getReadPointer(0) + audio.getNumSamples());
+    options.sampleRate = reader->sampleRate;
+
+    try
+    {
+        auto model = std::make_shared<const nam::dspData>(ReadNamModel(std::filesystem::u8path(cwd.getChildFile(modelPath).getFullPathName().toStdString())));
+        OfflineRenderer renderer(model, options);
+
+        std::vector<float> output;
+        const double parallelSeconds = TimeSeconds([&] { output = renderer.render(input); });
+        std::cout << "Rendered " << input.size() / options.sampleRate << " s in " << parallelSeconds << " s (overlap "
+                  << renderer.getOverlapSeconds() << " s)" << std::endl;
+
+        if (nullTest)
+        {
+            std::vector<float> reference;
+            const double serialSeconds = TimeSeconds([&] { reference = renderer.renderSerial(input); });
+            const OfflineRenderer::NullTestResult result = OfflineRenderer::nullTest(reference, output);
+            std::cout << "Serial render: " << serialSeconds << " s (" << serialSeconds / parallelSeconds << "x slower)" << std::endl;
+            std::cout << "Null test: max |difference| " << result.maxDifference << ", residual " << result.residualDB << " dB" << std::endl;
+        }
+
+        audio.copyFrom(0, 0, output.data(), (int)output.size());
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    outputFile.deleteFile();
+    juce::WavAudioFormat wav;
+    std::unique_ptr<juce::AudioFormatWriter> writer(wav.createWriterFor(new juce::FileOutputStream(outputFile), reader->sampleRate, 1, 24, {}, 0));
+    if (writer == nullptr || !writer->writeFromAudioSampleBuffer(audio, 0, audio.getNumSamples()))
+    {
+        std::cerr << "Couldn't write " << outputFile.getFullPathName() << std::endl;
+        return 1;
+    }
+    return 0;
+}
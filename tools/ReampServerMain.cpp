@@ -0,0 +1,181 @@
+// nam-reamp-server: runs the NAM chain as a local service, and doubles as a stand-in client to drive it.
+//
+//   nam-reamp-server [--socket PATH]
+//   nam-reamp-server --client --model MODEL.nam [--ir IR.wav] [--socket PATH] [--block N] [--param key=value ...] IN.wav OUT.wav
+//   nam-reamp-server --stats [--socket PATH]
+
+#include "ReampServer.h"
+#include "ReampProtocol.h"
+
+#include <algorithm>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <juce_audio_formats/juce_audio_formats.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace
+{
+ReampServer* gServer = nullptr;
+
+void HandleSignal(int)
+{
+    if (gServer != nullptr)
+        gServer->stop();
+}
+
+int Connect(const std::string& socketPath)
+{
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        std::cerr << "Couldn't connect to " << socketPath << std::endl;
+        if (fd >= 0)
+            ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool Expect(const int fd, const reamp::MessageType expected, std::vector<char>& payload)
+{
+    reamp::MessageType type;
+    if (!reamp::ReceiveMessage(fd, type, payload))
+    {
+        std::cerr << "Server hung up" << std::endl;
+        return false;
+    }
+    if (type != expected)
+    {
+        std::cerr << "Server error: " << std::string(payload.begin(), payload.end()) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int RunStats(const std::string& socketPath)
+{
+    const int fd = Connect(socketPath);
+    if (fd < 0)
+        return 1;
+
+    std::vector<char> payload;
+    const bool ok = reamp::SendMessage(fd, reamp::MessageType::kStats, std::string()) && Expect(fd, reamp::MessageType::kStats, payload);
+    if (ok)
+        std::cout << std::string(payload.begin(), payload.end()) << std::endl;
+    ::close(fd);
+    return ok ? 0 : 1;
+}
+
+int RunClient(const std::string& socketPath, const std::string& configuration, const int blockSize, const juce::File& inputFile,
+              const juce::File& outputFile)
+{
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(inputFile));
+    if (reader == nullptr)
+    {
+        std::cerr << "Couldn't read " << inputFile.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    juce::AudioBuffer<float> audio(1, (int)reader->lengthInSamples);
+    reader->read(&audio, 0, audio.getNumSamples(), 0, true, false);
+
+    const int fd = Connect(socketPath);
+    if (fd < 0)
+        return 1;
+
+    std::vector<char> payload;
+    const std::string request = configuration + "sample_rate=" + std::to_string(reader->sampleRate) + "\nmax_block_size=" + std::to_string(blockSize) + "\n";
+    if (!reamp::SendMessage(fd, reamp::MessageType::kConfigure, request) || !Expect(fd, reamp::MessageType::kAck, payload))
+        return 1;
+
+    float* samples = audio.getWritePointer(0);
+    for (int offset = 0; offset < audio.getNumSamples(); offset += blockSize)
+    {
+        const int numFrames = std::min(blockSize, audio.getNumSamples() - offset);
+        if (!reamp::SendMessage(fd, reamp::MessageType::kAudio, samples + offset, numFrames * sizeof(float))
+            || !Expect(fd, reamp::MessageType::kAudio, payload))
+            return 1;
+        std::memcpy(samples + offset, payload.data(), numFrames * sizeof(float));
+    }
+
+    if (reamp::SendMessage(fd, reamp::MessageType::kStats, std::string()) && Expect(fd, reamp::MessageType::kStats, payload))
+        std::cout << std::string(payload.begin(), payload.end()) << std::endl;
+    ::close(fd);
+
+    outputFile.deleteFile();
+    juce::WavAudioFormat wav;
+    std::unique_ptr<juce::AudioFormatWriter> writer(wav.createWriterFor(new juce::FileOutputStream(outputFile), reader->sampleRate, 1, 24, {}, 0));
+    if (writer == nullptr || !writer->writeFromAudioSampleBuffer(audio, 0, audio.getNumSamples()))
+    {
+        std::cerr << "Couldn't write " << outputFile.getFullPathName() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+}; // namespace
+
+int main(int argc, char* argv[])
+{
+    ReampServer::Options options;
+    bool clientMode = false, statsMode = false;
+    int blockSize = 256;
+    std::string configuration;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--socket" && hasValue)
+            options.socketPath = argv[++i];
+        else if (arg == "--client")
+            clientMode = true;
+        else if (arg == "--stats")
+            statsMode = true;
+        else if (arg == "--block" && hasValue)
+            blockSize = std::stoi(argv[++i]);
+        else if (arg == "--model" && hasValue)
+            configuration += "model=" + juce::File::getCurrentWorkingDirectory().getChildFile(argv[++i]).getFullPathName().toStdString() + "\n";
+        else if (arg == "--ir" && hasValue)
+            configuration += "ir=" + juce::File::getCurrentWorkingDirectory().getChildFile(argv[++i]).getFullPathName().toStdString() + "\n";
+        else if (arg == "--param" && hasValue)
+            configuration += std::string(argv[++i]) + "\n";
+        else
+            files.push_back(arg);
+    }
+
+    if (statsMode)
+        return RunStats(options.socketPath);
+
+    if (clientMode)
+    {
+        if (files.size() != 2)
+        {
+            std::cerr << "Usage: nam-reamp-server --client --model MODEL.nam [--ir IR.wav] IN.wav OUT.wav" << std::endl;
+            return 1;
+        }
+        const auto cwd = juce::File::getCurrentWorkingDirectory();
+        return RunClient(options.socketPath, configuration, blockSize, cwd.getChildFile(files[0]), cwd.getChildFile(files[1]));
+    }
+
+    ReampServer server(options);
+    gServer = &server;
+    std::signal(SIGINT, HandleSignal);
+    std::signal(SIGTERM, HandleSignal);
+
+    std::cout << "Listening on " << options.socketPath << std::endl;
+    if (!server.run())
+    {
+        std::cerr << "Couldn't listen on " << options.socketPath << std::endl;
+        return 1;
+    }
+    return 0;
+}
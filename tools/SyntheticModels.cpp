@@ -0,0 +1,98 @@
+#include "SyntheticModels.h"
+
+#include <cmath>
+#include <random>
+
+nam::dspData MakeLSTMData(const int numLayers, const int hiddenSize)
+{
+    nam::dspData data;
+    data.version = "0.5.4";
+    data.architecture = "LSTM";
+    data.config = {{"num_layers", numLayers}, {"input_size", 1}, {"hidden_size", hiddenSize}};
+    data.expected_sample_rate = kSyntheticSampleRate;
+
+    size_t numWeights = hiddenSize + 1;
+    for (int l = 0; l < numLayers; l++)
+    {
+        const int inputSize = l == 0 ? 1 : hiddenSize;
+        numWeights += 4 * hiddenSize * (inputSize + hiddenSize) + 4 * hiddenSize + 2 * hiddenSize;
+    }
+
+    std::mt19937 generator(1234);
+    std::normal_distribution<float> distribution(0.0f, 1.0f / std::sqrt((float)hiddenSize));
+    data.weights.resize(numWeights);
+    for (float& weight : data.weights)
+        weight = distribution(generator);
+    return data;
+}
+
+nam::dspData MakeWaveNetData()
+{
+    nam::dspData data;
+    data.version = "0.5.4";
+    data.architecture = "WaveNet";
+    data.expected_sample_rate = kSyntheticSampleRate;
+
+    std::vector<int> dilations;
+    for (int dilation = 1; dilation <= 512; dilation *= 2)
+        dilations.push_back(dilation);
+
+    struct ArrayShape
+    {
+        int inputSize, headSize, channels;
+        bool headBias;
+    };
+    const ArrayShape shapes[] = {{1, 8, 16, false}, {16, 1, 8, true}};
+
+    size_t numWeights = 1; // Head scale
+    data.config = {{"head", nullptr}, {"head_scale", 0.02}, {"layers", nlohmann::json::array()}};
+    for (const ArrayShape& shape : shapes)
+    {
+        data.config["layers"].push_back({{"input_size", shape.inputSize},
+                                         {"condition_size", 1},
+                                         {"head_size", shape.headSize},
+                                         {"channels", shape.channels},
+                                         {"kernel_size", 3},
+                                         {"dilations", dilations},
+                                         {"activation", "Tanh"},
+                                         {"gated", false},
+                                         {"head_bias", shape.headBias}});
+        const int c = shape.channels;
+        numWeights += c * shape.inputSize;
+        numWeights += dilations.size() * (3 * c * c + c + c + c * c + c);
+        numWeights += shape.headSize * c + (shape.headBias ? shape.headSize : 0);
+    }
+
+    std::mt19937 generator(1234);
+    std::normal_distribution<float> distribution(0.0f, 0.25f);
+    data.weights.resize(numWeights);
+    for (float& weight : data.weights)
+        weight = distribution(generator);
+    return data;
+}
+
+nam::dspData MakeGainData(const float gain, const double sampleRate)
+{
+    nam::dspData data;
+    data.version = "0.5.4";
+    data.architecture = "Linear";
+    data.config = {{"receptive_field", 1}, {"bias", false}};
+    data.expected_sample_rate = sampleRate;
+    data.weights = {gain};
+    return data;
+}
+
+std::vector<NAM_SAMPLE> MakeInput(const double seconds, const double sampleRate)
+{
+    std::vector<NAM_SAMPLE> input(static_cast<size_t>(seconds * sampleRate));
+    std::mt19937 generator(5678);
+    std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+    const double pi = 3.14159265358979;
+    for (size_t i = 0; i < input.size(); i++)
+    {
+        const double t = std::fmod(i / sampleRate, 0.5);
+        const double frequency = 82.41 * (1.0 + (i / (int)(0.5 * sampleRate)) % 12);
+        input[i] = (NAM_SAMPLE)(0.5 * std::exp(-4.0 * t) * std::sin(2.0 * pi * frequency * t) + 0.001 * noise(generator));
+    }
+    return input;
+}
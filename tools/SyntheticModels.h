@@ -0,0 +1,24 @@
+#ifndef __SYNTHETIC_MODELS_H__
+#define __SYNTHETIC_MODELS_H__
+
+#include <get_dsp.h>
+
+#include <vector>
+
+// Models and input made up from fixed seeds, for nam-bench and nam-tests: the same on every run and every
+// machine, and no .nam files needed. They all run at kSyntheticSampleRate unless asked otherwise.
+
+const double kSyntheticSampleRate = 48000.0;
+
+// An LSTM with random weights, shaped like the ones the trainer makes
+nam::dspData MakeLSTMData (const int numLayers, const int hiddenSize);
+// The trainer's "standard" WaveNet, with random weights
+nam::dspData MakeWaveNetData ();
+// The core's Linear model with a receptive field of one sample: output = gain * input, so what comes out of
+// anything built around it is known exactly
+nam::dspData MakeGainData (const float gain, const double sampleRate = kSyntheticSampleRate);
+
+// Something with the dynamics of a guitar: decaying plucks over a bit of noise
+std::vector<NAM_SAMPLE> MakeInput (const double seconds, const double sampleRate = kSyntheticSampleRate);
+
+#endif